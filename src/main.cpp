@@ -1,3 +1,12 @@
+#include <algorithm>
+#include <exception>
+#include <fstream>
+#include <optional>
+
+#include <files_helper.h>
+#include <json_query.h>
+#include <query_server.h>
+#include <regex_cache.h>
 #include <regex_helper.h>
 #include <stream_insert_overloads.h>
 
@@ -6,6 +15,11 @@ void print_help_and_exit(int exit_code)
   std::string const help_string =
 R"(
   Usage: $ cppregex text regex [options...]
+         $ cppregex --text-file=PATH regex [options...]
+         $ cppregex --stdin regex [options...]
+         $ cppregex --files=PATH [--files=PATH...] regex [options...]
+         $ cppregex --batch=FILE [--regex-cache-size=N]
+         $ cppregex --serve=SOCKET [--regex-cache-size=N] [--max-frame-size=N] [--max-connections=N]
 
   cppregex is a tool for running std::regex in C++. Give the tool the text and regex, and any desired
   options, and get back JSON detailing the query and results. The default behavior, if no options are
@@ -13,11 +27,102 @@ R"(
   All other options are disabled unless requested. The options to the program reflect the options of the
   std::regex API, and can be broadly categorized into algorithm, grammar, match, and syntax options.
 
+  Input options:
+  ==============
+    --text-file=PATH     In place of the text argument: search the contents of the file at PATH. The file is
+                           mapped into memory and searched in place, so it may be larger than the argument limit.
+                           A pipe, FIFO or other file that is not a regular file is read into memory to its end.
+    --stdin              In place of the text argument: read the text from standard input. A search reads and
+                           searches the input a chunk at a time, so memory use does not grow with the input size,
+                           and the text is not echoed in the output. Matches are exact as long as no match is
+                           longer than the overlap. $` and $' in the format string only see the buffered window,
+                           and a group that took no part in a match is reported at the end of that window rather
+                           than of the text, which is not known yet when the match is reported.
+    --chunk-size=N       With --stdin, the number of bytes read at a time. [Default: 1048576]
+    --overlap-size=N     With --stdin, the number of bytes at the end of each chunk that are searched again
+                           with the next one, so that matches spanning chunks are found. [Default: 65536]
+    --files=PATH         In place of the text argument: run the regex over every file PATH names. PATH may be a
+                           file, a directory (searched recursively), or a glob pattern, and --files=PATH may
+                           be given more than once. Files are searched in parallel with one compiled regex.
+                           Files holding a NUL byte in their first 64 KiB are skipped as binary. The output lists
+                           the results of each file in which the regex matched, in path order.
+
+  Batch mode:
+  ===========
+    --batch=FILE         Run many queries in one process. Each line of FILE ("-" for standard input) is a JSON
+                           query in the shape of the output: {"text": ..., "regex": ..., "regex_options": {...}},
+                           where any of the regex options may be left out to take its default. Each query's result
+                           is written as one line of JSON, in query order, or {"error": ...} if it failed. Queries
+                           run in parallel, and queries with the same regex and syntax options share one compile.
+    --serve=SOCKET       Run as a server on a Unix domain socket at the path SOCKET. Each request is a JSON query,
+                           as in --batch, framed by a 4-byte length in network byte order; each response is the
+                           result, framed the same way. A connection may carry many requests, answered in order.
+                           Compiled regexes are kept between requests. Instead of inlining a large text, a client
+                           may send a file descriptor (e.g. a memfd) as SCM_RIGHTS data with the first bytes of a
+                           request; the server searches the descriptor's contents and does not echo them. Only a
+                           memfd sealed with F_SEAL_SHRINK and F_SEAL_WRITE is searched in place; any other regular
+                           file is read into memory first, and any other descriptor is answered with an error.
+                           The query {"command": "statistics"} returns the regex cache's hit and miss counters.
+    --regex-cache-size=N With --batch or --serve, the number of compiled regexes kept for reuse, least recently
+                           used first out. Each regex is keyed on its text and syntax options. [Default: 256]
+    --max-frame-size=N   With --serve, the largest request accepted, in bytes. A larger request is answered with
+                           {"error": ...}, and its connection closed. [Default: 67108864]
+    --max-connections=N  With --serve, the most connections served at once. Further clients wait until one of
+                           them closes. [Default: 64]
+
   Algorithm options:
   ==================
     --search             Search the entire text (std::regex_search) and return all matches. [Default]
     --match              Attempt to match the entire text (std::regex_match) and return a match if it exists.
     --replace            Replace occurrences of regex matches in the text with std::regex_replace.
+    --lines              Match or search each newline-delimited line of the text on its own, and report the lines
+                           in which the regex matched, with their line numbers and positions. Lines are processed
+                           in parallel, and reported in text order. Has no effect on --replace.
+    --engine=ENGINE      The engine that runs --match and --search: std (std::regex) or dfa, a lazy DFA that runs
+                           in time linear in the text, with a Pike VM that finds the groups of the matches of an
+                           ECMAScript regex over each match alone, unless only the matches are counted (--count
+                           without --count-groups, or --exists). std::regex still finds the groups of POSIX
+                           regexes, and where a POSIX regex's match ends if going round a repetition in it may
+                           find a shorter match than leaving it, as in (a*)(ab)*b, which may take exponential
+                           time. Regexes with back-references or lookaheads, and multiline ones, use std. The
+                           matches are the same with either. [Default: std]
+
+  Result options:
+  ===============
+    --count              Only count the matches of --match or --search (line by line with --lines), without
+                           building or formatting them. The results hold the match count, and the text is not
+                           echoed. Has no effect on --replace.
+    --count-groups       As --count, and also count, for each group, the matches in which it took part. The
+                           first group count is that of the whole match.
+    --max-matches=N      Stop searching once N matches have been found (with --lines, N matches over all the
+                           lines). Also limits --count. [Default: 0, no limit]
+    --first              Stop searching at the first match. The same as --max-matches=1.
+    --exists             Only find out whether the regex matches at all, stopping at the first match. The results
+                           hold "exists": true or false, and the exit status is 0 if the regex matched, 1 if not.
+
+  Output options:
+  ===============
+    --ndjson             Write newline-delimited JSON instead of one document: each match of --match or --search
+                           on a line of its own, in the form of a match in the default output, as soon as it is
+                           found. Positions are in the whole text, also with --lines. No results are gathered,
+                           so memory use does not grow with the match count. The output is flushed with the
+                           first match, and with any match that comes 50 ms or more after the last flush. With
+                           --replace, --count or --exists, the results are written on one line. Has no effect on
+                           --files.
+    --output=FORMAT      Write the results in FORMAT: json (the default), ndjson (as --ndjson), cbor (RFC 8949),
+                           msgpack (MessagePack) or arrow. The cbor and msgpack formats hold the same document as
+                           the JSON, with each integer and length in the fewest bytes that hold it. Text that is
+                           valid UTF-8 is written as a text string, and any other as a byte string, exactly as it
+                           is. The arrow format is an Apache Arrow IPC stream of a table with a row for every
+                           group of every match: match_index, group_index, line_number (with --lines), position
+                           and length, after the path of the file with --files. It holds only matches, so it
+                           cannot be used with --replace, --count or --exists.
+    --arrow-text         With --output=arrow, add a text column holding the text of each group, dictionary-
+                           encoded so that each distinct text is written once. Without it, position and length
+                           give each group's place in the source.
+    --delta-positions    With --output=cbor or --output=msgpack, write each position as its difference from
+                           the position written before it, in document order, so that positions in long texts
+                           stay small. The first is relative to 0.
 
   Grammar options:
   ================
@@ -83,13 +188,157 @@ R"(
   exit(exit_code);
 }
 
+// Run the JSON queries in the file at the path contained in the --batch=FILE argument,
+// or in standard input if the path is "-".
+int run_batch(std::string const& path)
+{
+  std::ios::sync_with_stdio(false);
+  if (path == "-")
+  {
+    run_json_query_batch(std::cin, std::cout);
+    return 0;
+  }
+
+  std::ifstream queries(path);
+  if (!queries)
+  {
+    std::cerr << "cannot open " << path << std::endl;
+    return -1;
+  }
+  run_json_query_batch(queries, std::cout);
+  return 0;
+}
+
+// Serve JSON queries on a Unix domain socket at the path contained in the --serve=PATH
+// argument, until the process is killed.
+int run_server(std::string const& socket_path, Server_options const& server_options)
+{
+  try
+  {
+    Query_server server(socket_path, server_options);
+    server.serve();
+  }
+  catch (std::exception const& error)
+  {
+    std::cerr << error.what() << std::endl;
+    return -1;
+  }
+  return 0;
+}
+
+// Parse a whole number given to an option. Return std::nullopt if it is not one, or is too
+// large to hold.
+std::optional<size_t> parse_number(std::string const& value)
+{
+  if (value.empty() || !std::all_of(value.begin(), value.end(), [](char c) { return c >= '0' && c <= '9'; }))
+    return std::nullopt;
+  try
+  {
+    return std::stoul(value);
+  }
+  catch (std::out_of_range const&)
+  {
+    return std::nullopt;
+  }
+}
+
+// Parse a count given to an option, which must be a whole number greater than zero. Return
+// 0 if it is not.
+size_t parse_count(std::string const& value)
+{
+  return parse_number(value).value_or(0);
+}
+
+// Apply the options that may follow --batch=FILE or --serve=SOCKET, setting those that only
+// --serve takes in the Server_options. Return false if one is not recognized, or its value
+// is not a number greater than zero, or for --regex-cache-size, which may be 0 to keep no
+// regexes, not a number.
+bool apply_service_options(int argc, char* const argv[], Server_options& server_options)
+{
+  const std::string regex_cache_size_arg_id_text = "--regex-cache-size=";
+  const std::string max_frame_size_arg_id_text   = "--max-frame-size=";
+  const std::string max_connections_arg_id_text  = "--max-connections=";
+  for (int i = 2; i < argc; ++i)
+  {
+    std::string const arg = argv[i];
+    if (arg.find(regex_cache_size_arg_id_text) == 0)
+    {
+      auto const capacity = parse_number(arg.substr(regex_cache_size_arg_id_text.length()));
+      if (!capacity)
+        return false;
+      Regex_cache::instance().set_capacity(*capacity);
+    }
+    else if (arg.find(max_frame_size_arg_id_text) == 0)
+      server_options.max_frame_size  = parse_count(arg.substr(max_frame_size_arg_id_text.length()));
+    else if (arg.find(max_connections_arg_id_text) == 0)
+      server_options.max_connections = parse_count(arg.substr(max_connections_arg_id_text.length()));
+    else
+      return false;
+  }
+  return server_options.max_frame_size > 0 && server_options.max_connections > 0;
+}
+
 int main (int argc, char* const argv[])
 {
+  const std::string batch_arg_id_text = "--batch=";
+  const std::string serve_arg_id_text = "--serve=";
+  if (argc >= 2 && (std::string(argv[1]).find(batch_arg_id_text) == 0 ||
+                    std::string(argv[1]).find(serve_arg_id_text) == 0))
+  {
+    Server_options server_options;
+    if (!apply_service_options(argc, argv, server_options))
+      print_help_and_exit(-1);
+
+    std::string const arg = argv[1];
+    if (arg.find(batch_arg_id_text) == 0)
+      return run_batch(arg.substr(batch_arg_id_text.length()));
+    return run_server(arg.substr(serve_arg_id_text.length()), server_options);
+  }
+
   if (argc < 3)
     print_help_and_exit(-1);
 
-  Regex_helper regex_helper = create_helper_from_args(argc, argv);
-  regex_helper.pretty_print();
+  try
+  {
+    // With --exists, the exit status also tells whether the regex matched: 0 if so, 1 if not.
+    if (std::string_view(argv[1]).substr(0, 8) == "--files=")
+    {
+      std::vector<std::string> arguments(argv + 1, argv + argc);
+      Output_options const     output_options = extract_output_options_from_option_arguments(arguments);
+
+      Files_helper files_helper = create_files_helper_from_args(argc, argv);
+      files_helper.print(output_options);
+
+      if (files_helper.regex_options().result_options().exists())
+      {
+        bool const matched = std::any_of(files_helper.file_results().begin(),
+                                         files_helper.file_results().end(),
+                                         [](File_result const& file_result)
+                                         {
+                                           return file_result.results && results_have_match(*file_result.results);
+                                         });
+        return matched ? 0 : 1;
+      }
+    }
+    else
+    {
+      std::vector<std::string> option_arguments(argv + 3, argv + argc);
+      Output_options const     output_options = extract_output_options_from_option_arguments(option_arguments);
+      if (output_options.format == Output_format::ndjson)
+        return print_ndjson_from_args(argc, argv);
+
+      Regex_helper regex_helper = create_helper_from_args(argc, argv);
+      regex_helper.print(output_options);
+
+      if (regex_helper.regex_options().result_options().exists())
+        return results_have_match(*regex_helper.results()) ? 0 : 1;
+    }
+  }
+  catch (std::exception const& error)
+  {
+    std::cerr << error.what() << std::endl;
+    return -1;
+  }
 
   return 0;
 }
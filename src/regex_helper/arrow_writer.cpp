@@ -0,0 +1,482 @@
+#include <arrow_writer.h>
+
+#include <flatbuffer_builder.h>
+
+#include <cstdint>
+#include <limits>
+#include <stdexcept>
+#include <unordered_map>
+#include <utility>
+
+namespace
+{
+  using Reference = Flatbuffer_builder::Reference;
+
+  // The values that Arrow's Message.fbs and Schema.fbs give the metadata version and the
+  // members of the MessageHeader and Type unions used here.
+  constexpr std::int16_t metadata_version_v5     = 4;
+  constexpr std::uint8_t header_schema           = 1;
+  constexpr std::uint8_t header_dictionary_batch = 2;
+  constexpr std::uint8_t header_record_batch     = 3;
+  constexpr std::uint8_t type_int                = 2;
+  constexpr std::uint8_t type_binary             = 4;
+  constexpr std::uint8_t type_utf8               = 5;
+
+  // The most rows a record batch of matches holds, so that a reader can start on the first
+  // batch before the last is written.
+  constexpr size_t batch_row_count = 1 << 16;
+
+  // Arrow's Endianness: Little is 0 and Big is 1.
+  std::int16_t host_endianness()
+  {
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    return 1;
+#else
+    return 0;
+#endif
+  }
+
+  size_t byte_width(Arrow_type type)
+  {
+    switch (type)
+    {
+      case Arrow_type::int32:
+      case Arrow_type::uint32:
+        return 4;
+      case Arrow_type::uint64:
+        return 8;
+      default:
+        throw std::logic_error("arrow: utf8 and binary columns have no fixed width");
+    }
+  }
+
+  Reference create_int_type(Flatbuffer_builder& builder, std::int32_t bit_width, bool is_signed)
+  {
+    builder.start_table();
+    builder.add_scalar<std::int32_t>(0, bit_width);
+    builder.add_scalar<std::uint8_t>(1, is_signed);
+    return builder.end_table();
+  }
+
+  // Create the table of the type, and return it with its member of the Type union.
+  std::pair<std::uint8_t, Reference> create_type(Flatbuffer_builder& builder, Arrow_type type)
+  {
+    switch (type)
+    {
+      case Arrow_type::int32:
+        return {type_int, create_int_type(builder, 32, true)};
+      case Arrow_type::uint32:
+        return {type_int, create_int_type(builder, 32, false)};
+      case Arrow_type::uint64:
+        return {type_int, create_int_type(builder, 64, false)};
+      case Arrow_type::utf8:
+        builder.start_table();
+        return {type_utf8, builder.end_table()};
+      case Arrow_type::binary:
+      default:
+        builder.start_table();
+        return {type_binary, builder.end_table()};
+    }
+  }
+
+  // Append the data to the body as a buffer, padded to 8 bytes, and record where it lies.
+  void append_buffer(std::string&                                       body,
+                     std::vector<std::pair<std::int64_t, std::int64_t>>& buffers,
+                     std::string_view                                   data)
+  {
+    buffers.emplace_back(body.size(), data.size());
+    body.append(data);
+    body.append((8 - body.size() % 8) % 8, '\0');
+  }
+
+  Reference create_record_batch(Flatbuffer_builder&                                      builder,
+                                size_t                                                   row_count,
+                                std::vector<std::pair<std::int64_t, std::int64_t>> const& nodes,
+                                std::vector<std::pair<std::int64_t, std::int64_t>> const& buffers)
+  {
+    auto const node_vector   = builder.create_pair_vector(nodes);
+    auto const buffer_vector = builder.create_pair_vector(buffers);
+    builder.start_table();
+    builder.add_scalar<std::int64_t>(0, static_cast<std::int64_t>(row_count));
+    builder.add_offset(1, node_vector);
+    builder.add_offset(2, buffer_vector);
+    return builder.end_table();
+  }
+
+  std::string finish_message(Flatbuffer_builder& builder, std::uint8_t header_type, Reference header, size_t body_length)
+  {
+    builder.start_table();
+    builder.add_scalar<std::int64_t>(3, static_cast<std::int64_t>(body_length));
+    builder.add_offset(2, header);
+    builder.add_scalar<std::int16_t>(0, metadata_version_v5);
+    builder.add_scalar<std::uint8_t>(1, header_type);
+    return builder.finish(builder.end_table());
+  }
+
+  template <typename T>
+  std::string_view column_data(std::vector<T> const& values)
+  {
+    return std::string_view(reinterpret_cast<char const*>(values.data()), values.size() * sizeof(T));
+  }
+
+  // Whether the Results are of a kind that holds matches, rather than a count, an existence
+  // check or a replaced text.
+  bool holds_matches(Results const& results)
+  {
+    return dynamic_cast<Line_results         const*>(&results)
+        || dynamic_cast<Search_table_results const*>(&results)
+        || dynamic_cast<Search_results       const*>(&results)
+        || dynamic_cast<Match_results        const*>(&results);
+  }
+
+  // Call visit(match_index, group_index, line_number, position, length, text) for every group
+  // of every match in the Results, in text order. The line number is 0 unless the Results are
+  // Line_results.
+  template <typename Visit>
+  void for_each_group(Results const& results, Visit&& visit)
+  {
+    auto const visit_match = [&](size_t match_index, size_t line_number, Match const& match)
+    {
+      for (size_t group = 0; group < match.submatches().size(); ++group)
+      {
+        Submatch const& submatch = match.submatches()[group];
+        visit(match_index, group, line_number, submatch.position(), submatch.length(), submatch.text());
+      }
+    };
+
+    if (auto line_results = dynamic_cast<Line_results const*>(&results))
+    {
+      size_t match_index = 0;
+      for (auto const& line : line_results->lines())
+        for (auto const& match : line.matches())
+          visit_match(match_index++, line.line_number(), match);
+      return;
+    }
+    if (auto search_table_results = dynamic_cast<Search_table_results const*>(&results))
+    {
+      Match_table const& table = search_table_results->match_table();
+      for (size_t row = 0; row < table.match_count(); ++row)
+        for (size_t group = 0; group < table.group_count(); ++group)
+          visit(row, group, size_t(0), table.position(row, group), table.length(row, group), table.text(row, group));
+      return;
+    }
+    if (auto search_results = dynamic_cast<Search_results const*>(&results))
+    {
+      for (size_t match_index = 0; match_index < search_results->matches().size(); ++match_index)
+        visit_match(match_index, 0, search_results->matches()[match_index]);
+      return;
+    }
+    if (auto match_results = dynamic_cast<Match_results const*>(&results))
+    {
+      if (match_results->match().match_successful())
+        visit_match(0, 0, match_results->match());
+    }
+  }
+
+  // A Text_dictionary holds each distinct text once, in the order first seen, and gives
+  // each its index.
+  class Text_dictionary
+  {
+    std::unordered_map<std::string_view, std::int32_t> _indices    {};
+    std::vector<std::string_view>                      _values     {};
+    bool                                               _valid_utf8 {true};
+
+  public:
+    std::int32_t index(std::string_view text)
+    {
+      auto const [entry, inserted] = _indices.try_emplace(text, static_cast<std::int32_t>(_values.size()));
+      if (inserted)
+      {
+        if (_values.size() == static_cast<size_t>(std::numeric_limits<std::int32_t>::max()))
+          throw std::length_error("arrow: too many distinct texts for a dictionary");
+        _values.push_back(text);
+        _valid_utf8 = _valid_utf8 && is_valid_utf8(text);
+      }
+      return entry->second;
+    }
+
+    std::vector<std::string_view> const& values() const { return _values; };
+    Arrow_type                           type()   const { return _valid_utf8 ? Arrow_type::utf8 : Arrow_type::binary; };
+  };
+
+  // The columns of a batch of match rows, in schema order. The path and text columns hold
+  // dictionary indices.
+  struct Match_rows
+  {
+    std::vector<std::int32_t>  path_indices  {};
+    std::vector<std::uint64_t> match_indices {};
+    std::vector<std::uint32_t> group_indices {};
+    std::vector<std::uint64_t> line_numbers  {};
+    std::vector<std::uint64_t> positions     {};
+    std::vector<std::uint64_t> lengths       {};
+    std::vector<std::int32_t>  text_indices  {};
+
+    size_t size() const { return match_indices.size(); };
+
+    void clear()
+    {
+      path_indices.clear();
+      match_indices.clear();
+      group_indices.clear();
+      line_numbers.clear();
+      positions.clear();
+      lengths.clear();
+      text_indices.clear();
+    }
+  };
+
+  // A source of match rows: the Results and, when writing files, the path index of their file.
+  struct Match_source
+  {
+    Results const* results    {nullptr};
+    std::int32_t   path_index {0};
+  };
+
+  // Write the matches of every source as one table. The path column is there if paths are
+  // given, the line_number column if the Results are Line_results, and the text column if
+  // the Output_options ask for it. The text dictionary is gathered in a first pass over the
+  // matches, since it must be written before any record batch that refers to it.
+  void write_match_table(std::ostream&                    os,
+                         std::vector<Match_source> const& sources,
+                         Text_dictionary const*           paths,
+                         bool                             lines,
+                         Output_options const&            output_options)
+  {
+    Text_dictionary           texts;
+    std::vector<std::int32_t> text_indices;
+    if (output_options.arrow_text)
+    {
+      for (auto const& source : sources)
+        for_each_group(*source.results, [&](size_t, size_t, size_t, size_t, size_t, std::string_view text)
+                                        {
+                                          text_indices.push_back(texts.index(text));
+                                        });
+    }
+
+    constexpr long long path_dictionary_id = 0;
+    constexpr long long text_dictionary_id = 1;
+
+    std::vector<Arrow_field> fields;
+    if (paths)
+      fields.push_back({"path", paths->type(), path_dictionary_id});
+    fields.push_back({"match_index", Arrow_type::uint64});
+    fields.push_back({"group_index", Arrow_type::uint32});
+    if (lines)
+      fields.push_back({"line_number", Arrow_type::uint64});
+    fields.push_back({"position", Arrow_type::uint64});
+    fields.push_back({"length", Arrow_type::uint64});
+    if (output_options.arrow_text)
+      fields.push_back({"text", texts.type(), text_dictionary_id});
+
+    Arrow_writer writer(os, std::move(fields));
+    writer.write_schema();
+    if (paths)
+      writer.write_dictionary(path_dictionary_id, paths->values(), paths->type());
+    if (output_options.arrow_text)
+      writer.write_dictionary(text_dictionary_id, texts.values(), texts.type());
+
+    Match_rows rows;
+    auto const write_rows = [&]()
+    {
+      std::vector<std::string_view> columns;
+      if (paths)
+        columns.push_back(column_data(rows.path_indices));
+      columns.push_back(column_data(rows.match_indices));
+      columns.push_back(column_data(rows.group_indices));
+      if (lines)
+        columns.push_back(column_data(rows.line_numbers));
+      columns.push_back(column_data(rows.positions));
+      columns.push_back(column_data(rows.lengths));
+      if (output_options.arrow_text)
+        columns.push_back(column_data(rows.text_indices));
+
+      writer.write_record_batch(rows.size(), columns);
+      rows.clear();
+    };
+
+    size_t row_index = 0;
+    for (auto const& source : sources)
+    {
+      for_each_group(*source.results, [&](size_t match_index, size_t group_index, size_t line_number,
+                                          size_t position, size_t length, std::string_view)
+                                      {
+                                        if (paths)
+                                          rows.path_indices.push_back(source.path_index);
+                                        rows.match_indices.push_back(match_index);
+                                        rows.group_indices.push_back(static_cast<std::uint32_t>(group_index));
+                                        if (lines)
+                                          rows.line_numbers.push_back(line_number);
+                                        rows.positions.push_back(position);
+                                        rows.lengths.push_back(length);
+                                        if (output_options.arrow_text)
+                                          rows.text_indices.push_back(text_indices[row_index]);
+                                        ++row_index;
+
+                                        if (rows.size() == batch_row_count)
+                                          write_rows();
+                                      });
+    }
+    if (rows.size() > 0)
+      write_rows();
+
+    writer.end();
+  }
+
+  void check_holds_matches(Results const& results)
+  {
+    if (!holds_matches(results))
+      throw std::invalid_argument("--output=arrow writes matches, and cannot write the results of --count, --exists or --replace");
+  }
+}
+
+Arrow_writer::Arrow_writer(std::ostream& os, std::vector<Arrow_field>&& fields)
+: _os     (&os),
+  _fields (std::move(fields))
+{}
+
+// Every field is written with an empty list of children, which readers expect to find even
+// for a type that has none.
+void Arrow_writer::write_schema()
+{
+  Flatbuffer_builder builder;
+  std::vector<Reference> field_references;
+  for (auto const& field : _fields)
+  {
+    auto const name = builder.create_string(field.name);
+    auto const [type_member, type] = create_type(builder, field.type);
+
+    Reference dictionary = 0;
+    if (field.dictionary_id >= 0)
+    {
+      auto const index_type = create_int_type(builder, 32, true);
+      builder.start_table();
+      builder.add_scalar<std::int64_t>(0, field.dictionary_id);
+      builder.add_offset(1, index_type);
+      dictionary = builder.end_table();
+    }
+
+    auto const children = builder.create_offset_vector({});
+    builder.start_table();
+    builder.add_offset(0, name);
+    builder.add_offset(3, type);
+    if (dictionary != 0)
+      builder.add_offset(4, dictionary);
+    builder.add_offset(5, children);
+    builder.add_scalar<std::uint8_t>(1, false);
+    builder.add_scalar<std::uint8_t>(2, type_member);
+    field_references.push_back(builder.end_table());
+  }
+
+  auto const fields = builder.create_offset_vector(field_references);
+  builder.start_table();
+  builder.add_offset(1, fields);
+  builder.add_scalar<std::int16_t>(0, host_endianness());
+  auto const schema = builder.end_table();
+
+  _write_message(finish_message(builder, header_schema, schema, 0), "");
+}
+
+// A dictionary is a record batch of one utf8 or binary column, whose buffers are the
+// validity bitmap (empty), the int32 offset of each value and of the end, and the values.
+void Arrow_writer::write_dictionary(long long id, std::vector<std::string_view> const& values, Arrow_type type)
+{
+  if (type != Arrow_type::utf8 && type != Arrow_type::binary)
+    throw std::logic_error("arrow: dictionary values must be utf8 or binary");
+
+  std::vector<std::int32_t> offsets {0};
+  std::string               data;
+  for (auto value : values)
+  {
+    if (data.size() + value.size() > static_cast<size_t>(std::numeric_limits<std::int32_t>::max()))
+      throw std::length_error("arrow: dictionary values of 2 GiB or more");
+    data.append(value);
+    offsets.push_back(static_cast<std::int32_t>(data.size()));
+  }
+
+  std::string                                        body;
+  std::vector<std::pair<std::int64_t, std::int64_t>> buffers;
+  append_buffer(body, buffers, {});
+  append_buffer(body, buffers, column_data(offsets));
+  append_buffer(body, buffers, data);
+
+  Flatbuffer_builder builder;
+  auto const record_batch = create_record_batch(builder, values.size(), {{static_cast<std::int64_t>(values.size()), 0}}, buffers);
+  builder.start_table();
+  builder.add_scalar<std::int64_t>(0, id);
+  builder.add_offset(1, record_batch);
+  auto const dictionary_batch = builder.end_table();
+
+  _write_message(finish_message(builder, header_dictionary_batch, dictionary_batch, body.size()), body);
+}
+
+void Arrow_writer::write_record_batch(size_t row_count, std::vector<std::string_view> const& columns)
+{
+  if (columns.size() != _fields.size())
+    throw std::logic_error("arrow: record batch does not have a column for every field");
+
+  std::string                                        body;
+  std::vector<std::pair<std::int64_t, std::int64_t>> nodes;
+  std::vector<std::pair<std::int64_t, std::int64_t>> buffers;
+  for (size_t i = 0; i < columns.size(); ++i)
+  {
+    Arrow_type const type = _fields[i].dictionary_id >= 0 ? Arrow_type::int32 : _fields[i].type;
+    if (columns[i].size() != row_count * byte_width(type))
+      throw std::logic_error("arrow: column " + _fields[i].name + " does not hold the row count");
+
+    nodes.emplace_back(row_count, 0);
+    append_buffer(body, buffers, {});
+    append_buffer(body, buffers, columns[i]);
+  }
+
+  Flatbuffer_builder builder;
+  auto const record_batch = create_record_batch(builder, row_count, nodes, buffers);
+  _write_message(finish_message(builder, header_record_batch, record_batch, body.size()), body);
+}
+
+// The end of the stream is a message with no metadata.
+void Arrow_writer::end()
+{
+  _os->write("\xff\xff\xff\xff\0\0\0\0", 8);
+  _os->flush();
+}
+
+// A message starts with the continuation marker and the size of its metadata, which is
+// padded to 8 bytes, as is the body after it.
+void Arrow_writer::_write_message(std::string const& metadata, std::string const& body)
+{
+  auto const size = static_cast<std::uint32_t>(metadata.size());
+  char const prefix[8] = {'\xff', '\xff', '\xff', '\xff',
+                          static_cast<char>(size & 0xff),         static_cast<char>((size >> 8) & 0xff),
+                          static_cast<char>((size >> 16) & 0xff), static_cast<char>((size >> 24) & 0xff)};
+  _os->write(prefix, sizeof(prefix));
+  _os->write(metadata.data(), static_cast<std::streamsize>(metadata.size()));
+  _os->write(body.data(),     static_cast<std::streamsize>(body.size()));
+}
+
+void write_arrow(std::ostream& os, Results const& results, Output_options const& output_options)
+{
+  check_holds_matches(results);
+  bool const lines = dynamic_cast<Line_results const*>(&results) != nullptr;
+  write_match_table(os, {{&results, 0}}, nullptr, lines, output_options);
+}
+
+// Skipped files have no Results, and so no rows. Only the paths of files with rows are put
+// in the path dictionary.
+void write_arrow(std::ostream& os, std::vector<File_result> const& file_results, Output_options const& output_options)
+{
+  Text_dictionary           paths;
+  std::vector<Match_source> sources;
+  bool                      lines = false;
+  for (auto const& file_result : file_results)
+  {
+    if (!file_result.results)
+      continue;
+
+    check_holds_matches(*file_result.results);
+    lines = lines || dynamic_cast<Line_results const*>(file_result.results.get()) != nullptr;
+    if (results_have_match(*file_result.results))
+      sources.push_back({file_result.results.get(), paths.index(file_result.path)});
+  }
+
+  write_match_table(os, sources, &paths, lines, output_options);
+}
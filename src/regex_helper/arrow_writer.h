@@ -0,0 +1,78 @@
+#ifndef ARROW_WRITER_H
+#define ARROW_WRITER_H
+
+#include <iostream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <document_writer.h>
+#include <files_helper.h>
+#include <results.h>
+
+// Arrow_types are the column types an Arrow_writer can write.
+enum class Arrow_type
+{
+  int32,
+  uint32,
+  uint64,
+  utf8,
+  binary
+};
+
+// An Arrow_field is a column of an Arrow schema. A field with a dictionary id holds int32
+// indices into the dictionary with that id, whose values are of the field's type.
+struct Arrow_field
+{
+  std::string name          {""};
+  Arrow_type  type          {Arrow_type::uint64};
+  long long   dictionary_id {-1};
+};
+
+// An Arrow_writer writes a table as an Apache Arrow IPC stream, with no Arrow library: the
+// schema, then the dictionaries, then the rows in record batches, then the end-of-stream
+// marker. Each message is its metadata, a FlatBuffer built with a Flatbuffer_builder,
+// followed by its body, the buffers of its columns, each padded to 8 bytes. No column has
+// nulls, and so none has a validity bitmap. Column data is written as it lies in memory, in
+// the byte order of the host, which the schema records.
+class Arrow_writer
+{
+  std::ostream*            _os     {nullptr};
+  std::vector<Arrow_field> _fields {};
+
+public:
+  Arrow_writer() = delete;
+  Arrow_writer(std::ostream& os, std::vector<Arrow_field>&& fields);
+
+  // Write the schema of the fields.
+  void write_schema();
+
+  // Write the values of the dictionary with the id, which must be utf8 or binary.
+  void write_dictionary(long long id, std::vector<std::string_view> const& values, Arrow_type type);
+
+  // Write a record batch of the row count, given the data of each field in schema order: the
+  // values of the row count, end to end. The fields of a record batch must be of a fixed
+  // width, as dictionary indices are.
+  void write_record_batch(size_t row_count, std::vector<std::string_view> const& columns);
+
+  // Write the end-of-stream marker, and flush the stream.
+  void end();
+
+private:
+  void _write_message(std::string const& metadata, std::string const& body);
+};
+
+// Write the matches in the Results as an Arrow IPC stream, with a row for every group of
+// every match: the columns are match_index, group_index, line_number (with --lines),
+// position and length, all unsigned integers, and, if the Output_options ask for it, text,
+// dictionary-encoded so that text that is matched again and again is held once. Without
+// text, position and length give the offset of each group in the source. The text is utf8,
+// or binary if any of it is not valid UTF-8. Throws std::invalid_argument for Results that
+// hold no matches, those of --count, --exists and --replace.
+void write_arrow(std::ostream& os, Results const& results, Output_options const& output_options);
+
+// Write the matches in the results of every file as write_arrow does for one, with the path
+// of each row's file first, in a dictionary-encoded path column.
+void write_arrow(std::ostream& os, std::vector<File_result> const& file_results, Output_options const& output_options);
+
+#endif /* ARROW_WRITER_H */
@@ -0,0 +1,272 @@
+#include <binary_writer.h>
+
+#include <stdexcept>
+
+Binary_writer::Binary_writer(std::ostream& os, Binary_format format, bool delta_positions)
+: Document_writer (os, default_buffer_size, delta_positions),
+  _format         (format)
+{}
+
+void Binary_writer::begin_object(size_t member_count)
+{
+  _begin_value();
+  if (_format == Binary_format::cbor)
+    _write_cbor_head(5, member_count);
+  else
+    _write_msgpack_head(member_count, 0x80, 16, 0, 0xde, 0xdf);
+  _scopes.push_back({true, member_count});
+}
+
+void Binary_writer::end_object()
+{
+  _end_scope(true);
+}
+
+void Binary_writer::begin_array(size_t element_count)
+{
+  _begin_value();
+  if (_format == Binary_format::cbor)
+    _write_cbor_head(4, element_count);
+  else
+    _write_msgpack_head(element_count, 0x90, 16, 0, 0xdc, 0xdd);
+  _scopes.push_back({false, element_count});
+}
+
+void Binary_writer::end_array()
+{
+  _end_scope(false);
+}
+
+void Binary_writer::key(std::string_view name)
+{
+  if (_scopes.empty() || !_scopes.back().object || _after_key || _scopes.back().remaining == 0)
+    throw std::logic_error("binary document: key \"" + std::string(name) + "\" does not fit the open object");
+
+  --_scopes.back().remaining;
+  _write_bytes(name, true);
+  _after_key = true;
+}
+
+void Binary_writer::string(std::string_view text)
+{
+  _begin_value();
+  _write_bytes(text, is_valid_utf8(text));
+  _write_buffer_if_full();
+}
+
+void Binary_writer::number(size_t number)
+{
+  _begin_value();
+  _write_unsigned(number);
+}
+
+// CBOR writes a negative integer n as -1 - n, under its own major type. MessagePack writes
+// it in two's complement, in the fewest bytes that hold it.
+void Binary_writer::signed_number(long long number)
+{
+  _begin_value();
+  if (number >= 0)
+  {
+    _write_unsigned(static_cast<std::uint64_t>(number));
+    return;
+  }
+
+  if (_format == Binary_format::cbor)
+  {
+    _write_cbor_head(1, static_cast<std::uint64_t>(-(number + 1)));
+    return;
+  }
+
+  auto const bits = static_cast<std::uint64_t>(number);
+  if (number >= -32)
+  {
+    _buffer += static_cast<char>(bits & 0xff);
+  }
+  else if (number >= INT8_MIN)
+  {
+    _buffer += '\xd0';
+    _write_big_endian(bits, 1);
+  }
+  else if (number >= INT16_MIN)
+  {
+    _buffer += '\xd1';
+    _write_big_endian(bits, 2);
+  }
+  else if (number >= INT32_MIN)
+  {
+    _buffer += '\xd2';
+    _write_big_endian(bits, 4);
+  }
+  else
+  {
+    _buffer += '\xd3';
+    _write_big_endian(bits, 8);
+  }
+}
+
+void Binary_writer::boolean(bool value)
+{
+  _begin_value();
+  if (_format == Binary_format::cbor)
+    _buffer += value ? '\xf5' : '\xf4';
+  else
+    _buffer += value ? '\xc3' : '\xc2';
+}
+
+void Binary_writer::null()
+{
+  _begin_value();
+  _buffer += _format == Binary_format::cbor ? '\xf6' : '\xc0';
+}
+
+// A value directly after its key was counted with the key. Any other value must be an element
+// of the open array, if there is one.
+void Binary_writer::_begin_value()
+{
+  if (_after_key)
+  {
+    _after_key = false;
+    return;
+  }
+  if (_scopes.empty())
+    return;
+
+  if (_scopes.back().object || _scopes.back().remaining == 0)
+    throw std::logic_error("binary document: value does not fit the open object or array");
+  --_scopes.back().remaining;
+}
+
+void Binary_writer::_end_scope(bool object)
+{
+  if (_scopes.empty() || _scopes.back().object != object || _scopes.back().remaining != 0 || _after_key)
+    throw std::logic_error(object ? "binary document: object closed before all of its members were written"
+                                  : "binary document: array closed before all of its elements were written");
+  _scopes.pop_back();
+  _write_buffer_if_full();
+}
+
+void Binary_writer::_write_big_endian(std::uint64_t value, size_t byte_count)
+{
+  for (size_t i = byte_count; i > 0; --i)
+    _buffer += static_cast<char>((value >> (8 * (i - 1))) & 0xff);
+}
+
+// The head of a CBOR data item: the major type in the top three bits, and the argument in the
+// low five if it is below 24, or else in the 1, 2, 4 or 8 bytes that follow.
+void Binary_writer::_write_cbor_head(unsigned char major_type, std::uint64_t argument)
+{
+  unsigned char const type_bits = static_cast<unsigned char>(major_type << 5);
+  if (argument < 24)
+  {
+    _buffer += static_cast<char>(type_bits | argument);
+  }
+  else if (argument <= UINT8_MAX)
+  {
+    _buffer += static_cast<char>(type_bits | 24);
+    _write_big_endian(argument, 1);
+  }
+  else if (argument <= UINT16_MAX)
+  {
+    _buffer += static_cast<char>(type_bits | 25);
+    _write_big_endian(argument, 2);
+  }
+  else if (argument <= UINT32_MAX)
+  {
+    _buffer += static_cast<char>(type_bits | 26);
+    _write_big_endian(argument, 4);
+  }
+  else
+  {
+    _buffer += static_cast<char>(type_bits | 27);
+    _write_big_endian(argument, 8);
+  }
+}
+
+// The head of a MessagePack string, byte string, map or array: the fix type with the length
+// in its low bits if the length is below the fix limit, or else the 8, 16 or 32-bit type and
+// the length after it. A type of 0 is one the format does not have.
+void Binary_writer::_write_msgpack_head(std::uint64_t length, unsigned char fix_type, size_t fix_limit,
+                                        unsigned char type_8, unsigned char type_16, unsigned char type_32)
+{
+  if (length < fix_limit)
+  {
+    _buffer += static_cast<char>(fix_type | length);
+  }
+  else if (type_8 != 0 && length <= UINT8_MAX)
+  {
+    _buffer += static_cast<char>(type_8);
+    _write_big_endian(length, 1);
+  }
+  else if (length <= UINT16_MAX)
+  {
+    _buffer += static_cast<char>(type_16);
+    _write_big_endian(length, 2);
+  }
+  else if (length <= UINT32_MAX)
+  {
+    _buffer += static_cast<char>(type_32);
+    _write_big_endian(length, 4);
+  }
+  else
+  {
+    throw std::length_error("MessagePack cannot hold a string or container of 2^32 or more");
+  }
+}
+
+void Binary_writer::_write_unsigned(std::uint64_t value)
+{
+  if (_format == Binary_format::cbor)
+  {
+    _write_cbor_head(0, value);
+    return;
+  }
+
+  if (value < 0x80)
+  {
+    _buffer += static_cast<char>(value);
+  }
+  else if (value <= UINT8_MAX)
+  {
+    _buffer += '\xcc';
+    _write_big_endian(value, 1);
+  }
+  else if (value <= UINT16_MAX)
+  {
+    _buffer += '\xcd';
+    _write_big_endian(value, 2);
+  }
+  else if (value <= UINT32_MAX)
+  {
+    _buffer += '\xce';
+    _write_big_endian(value, 4);
+  }
+  else
+  {
+    _buffer += '\xcf';
+    _write_big_endian(value, 8);
+  }
+}
+
+void Binary_writer::_write_bytes(std::string_view bytes, bool text)
+{
+  if (_format == Binary_format::cbor)
+    _write_cbor_head(text ? 3 : 2, bytes.size());
+  else if (text)
+    _write_msgpack_head(bytes.size(), 0xa0, 32, 0xd9, 0xda, 0xdb);
+  else
+    _write_msgpack_head(bytes.size(), 0, 0, 0xc4, 0xc5, 0xc6);
+  _buffer.append(bytes);
+}
+
+std::unique_ptr<Document_writer> create_binary_writer(std::ostream& os, Output_options const& output_options)
+{
+  switch (output_options.format)
+  {
+    case Output_format::cbor:
+      return std::make_unique<Binary_writer>(os, Binary_format::cbor, output_options.delta_positions);
+    case Output_format::msgpack:
+      return std::make_unique<Binary_writer>(os, Binary_format::msgpack, output_options.delta_positions);
+    default:
+      throw std::invalid_argument("not a binary output format");
+  }
+}
@@ -0,0 +1,70 @@
+#ifndef BINARY_WRITER_H
+#define BINARY_WRITER_H
+
+#include <cstdint>
+#include <iostream>
+#include <memory>
+#include <string_view>
+#include <vector>
+
+#include <document_writer.h>
+
+// Binary_formats are the binary encodings a Binary_writer can write.
+enum class Binary_format
+{
+  cbor,   // RFC 8949
+  msgpack // MessagePack
+};
+
+// A Binary_writer is a Document_writer that encodes the document in CBOR or MessagePack. Both
+// give every integer, and every string, object and array length, in the fewest bytes that
+// hold it, so that small positions and lengths take one or two bytes. Objects and arrays are
+// written with their counts up front, as both formats prefer and MessagePack requires; the
+// writer checks that each holds as many members or elements as it was opened with, and throws
+// std::logic_error if not. A string that is valid UTF-8 is written as a text string, and any
+// other as a byte string, so that the bytes of the text come through exactly.
+class Binary_writer : public Document_writer
+{
+  // An open object or array, and how many more members or elements it is to hold.
+  struct Scope
+  {
+    bool   object    {false};
+    size_t remaining {0};
+  };
+
+  Binary_format      _format    {Binary_format::cbor};
+  std::vector<Scope> _scopes    {};
+  bool               _after_key {false}; // Whether the next value belongs to the key just written.
+
+public:
+  Binary_writer(std::ostream& os, Binary_format format, bool delta_positions = false);
+
+  void begin_object(size_t member_count)  override;
+  void end_object()                       override;
+  void begin_array (size_t element_count) override;
+  void end_array()                        override;
+
+  void key          (std::string_view name) override;
+  void string       (std::string_view text) override;
+  void number       (size_t number)         override;
+  void signed_number(long long number)      override;
+  void boolean      (bool value)            override;
+  void null         ()                      override;
+
+private:
+  void _begin_value();
+  void _end_scope(bool object);
+
+  void _write_big_endian  (std::uint64_t value, size_t byte_count);
+  void _write_cbor_head   (unsigned char major_type, std::uint64_t argument);
+  void _write_msgpack_head(std::uint64_t length, unsigned char fix_type, size_t fix_limit,
+                           unsigned char type_8, unsigned char type_16, unsigned char type_32);
+  void _write_unsigned    (std::uint64_t value);
+  void _write_bytes       (std::string_view bytes, bool text);
+};
+
+// Return the Document_writer for the binary format the Output_options select, writing to the
+// stream.
+std::unique_ptr<Document_writer> create_binary_writer(std::ostream& os, Output_options const& output_options);
+
+#endif /* BINARY_WRITER_H */
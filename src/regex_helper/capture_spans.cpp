@@ -0,0 +1,32 @@
+#include <capture_spans.h>
+
+#include <algorithm>
+
+Capture_spans Capture_spans::of(std::cmatch const& match, std::vector<size_t>& captures, bool groups)
+{
+  char const* const first = match.empty() ? nullptr : match.prefix().first;
+  char const* const last  = match.empty() ? nullptr : match.suffix().second;
+  size_t const      size  = groups ? match.size() : std::min<size_t>(match.size(), 1);
+
+  captures.clear();
+  for (size_t group = 0; group < size; ++group)
+  {
+    if (match[group].matched)
+    {
+      captures.push_back(static_cast<size_t>(match[group].first  - first));
+      captures.push_back(static_cast<size_t>(match[group].second - first));
+    }
+    else
+    {
+      captures.push_back(unmatched);
+      captures.push_back(unmatched);
+    }
+  }
+  return Capture_spans(first, last, captures.data(), size);
+}
+
+size_t Capture_spans::max_size()
+{
+  static size_t const size = std::cmatch().max_size();
+  return size;
+}
@@ -0,0 +1,62 @@
+#ifndef CAPTURE_SPANS_H
+#define CAPTURE_SPANS_H
+
+#include <cstddef>
+#include <regex>
+#include <string_view>
+#include <vector>
+
+// Capture_spans tell where a match and each of its groups lie, as the start and end of each,
+// two to a group with the whole match first, measured from the start of the range searched,
+// which is where the match's prefix starts. They only view the captures and the text, which
+// must outlive them. A group that took no part in the match is at the end of the text, as
+// std::regex puts it, and has a length of 0.
+//
+// Matches are handed on as Capture_spans rather than as std::cmatch, which only std::regex
+// can fill in, so that a match found without std::regex needs neither a regex run nor an
+// allocation to be handed on. A std::cmatch is turned into Capture_spans with of().
+class Capture_spans
+{
+  char const*   _first    {nullptr}; // The start of the range searched, where the prefix starts.
+  char const*   _last     {nullptr}; // The end of the text, where the suffix ends.
+  size_t const* _captures {nullptr};
+  size_t        _size     {0};
+
+public:
+  // The start and end of a group that took no part in the match.
+  static constexpr size_t unmatched = static_cast<size_t>(-1);
+
+  // The captures hold 2 * size positions. A size of 0 is a failed match.
+  Capture_spans(char const* first, char const* last, size_t const* captures, size_t size)
+  : _first    (first),
+    _last     (last),
+    _captures (captures),
+    _size     (size)
+  {}
+
+  // Set the captures to those of the match, measured from the start of its prefix, and
+  // return Capture_spans viewing them. Only the whole match is kept unless groups are asked
+  // for. The text ends where the suffix of the match does.
+  static Capture_spans of(std::cmatch const& match, std::vector<size_t>& captures, bool groups = true);
+
+  // What std::cmatch::max_size returns.
+  static size_t max_size();
+
+  bool   empty() const { return _size == 0; };
+  size_t size()  const { return _size;      };
+
+  bool   matched (size_t group) const { return _captures[2 * group + 1] != unmatched; };
+  size_t position(size_t group) const { return matched(group) ? _captures[2 * group] : static_cast<size_t>(_last - _first); };
+  size_t length  (size_t group) const { return matched(group) ? _captures[2 * group + 1] - _captures[2 * group] : 0; };
+
+  std::string_view text(size_t group) const
+  {
+    return matched(group) ? std::string_view(_first + _captures[2 * group], length(group)) : std::string_view();
+  };
+
+  // The text between the start of the range searched and the match, and after the match.
+  std::string_view prefix() const { return std::string_view(_first, _captures[0]); };
+  std::string_view suffix() const { return std::string_view(_first + _captures[1], static_cast<size_t>(_last - _first) - _captures[1]); };
+};
+
+#endif /* CAPTURE_SPANS_H */
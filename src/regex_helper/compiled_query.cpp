@@ -0,0 +1,831 @@
+#include <compiled_query.h>
+#include <lines.h>
+#include <regex_automata.h>
+#include <regex_cache.h>
+#include <thread_pool.h>
+
+namespace
+{
+  // Submatches may view the text only when its owner is there to keep it alive.
+  Submatch_text submatch_text(std::shared_ptr<void const> const& text_owner)
+  {
+    return text_owner ? Submatch_text::viewed : Submatch_text::copied;
+  }
+}
+
+// Unless the regex is a literal, take the compiled regex, and its Regex_automata, from the
+// process-wide Regex_cache, so that a regex is only parsed, analysed and constructed once
+// however many queries use it, and its Lazy_dfa keeps the states earlier queries built.
+// Given a compiled regex, the query builds its Regex_automata itself.
+Compiled_query::Compiled_query(std::string                       regex,
+                               Regex_options                     regex_options,
+                               std::shared_ptr<std::regex const> compiled_regex)
+: _regex           (std::move(regex)),
+  _regex_options   (std::move(regex_options)),
+  _compiled_regex  (std::move(compiled_regex)),
+  _format_program  (_regex_options.format_string()),
+  _replace_program (_regex_options.format_string(), _regex_options.match_flag_mask())
+{
+  auto const syntax_option_mask = _regex_options.syntax_option_mask();
+  _copies_context               = _format_program.copies_prefix_or_suffix() || _replace_program.copies_prefix_or_suffix();
+  auto       literal            = literal_of_regex(_regex, syntax_option_mask);
+  if (literal && !_copies_context)
+    _literal_finder.emplace(std::move(*literal), (syntax_option_mask & std::regex_constants::icase) != 0);
+
+  if (!_literal_finder)
+  {
+    std::shared_ptr<Regex_automata const> automata;
+    if (_compiled_regex)
+      automata = std::make_shared<Regex_automata const>(_regex, syntax_option_mask);
+    else
+    {
+      auto compiled   = Regex_cache::instance().get(_regex, syntax_option_mask);
+      _compiled_regex = std::move(compiled.regex);
+      automata        = std::move(compiled.automata);
+    }
+
+    _match_bounds = automata->match_bounds();
+    if (_regex_options.engine() == Engine::dfa && !_copies_context)
+    {
+      Regex_automata::Dfa const& dfa = automata->dfa();
+      _lazy_dfa         = dfa.lazy_dfa;
+      _pike_vm          = dfa.pike_vm;
+      _dfa_ends_matches = dfa.ends_matches;
+      _dfa_finds_groups = dfa.finds_groups;
+    }
+    if (!_copies_context && automata->required_literal())
+      _required_literal_finder.emplace(*automata->required_literal(), automata->icase());
+  }
+}
+
+// A match found without std::regex is the whole text, with groups the Pike_vm finds, if any
+// are asked for. std::regex still finds a POSIX regex's groups.
+bool Compiled_query::_match(char const* first, char const* last, std::vector<size_t>& captures, std::regex_constants::match_flag_type flags, bool groups) const
+{
+  size_t const size = static_cast<size_t>(last - first);
+  captures.clear();
+  if (!_literal_finder)
+  {
+    if (_cannot_match(first, last, flags))
+      return false;
+    if (_lazy_dfa)
+    {
+      Dfa_outcome const outcome = _lazy_dfa->match(first, last, flags);
+      if (outcome == Dfa_outcome::not_matched)
+        return false;
+      captures.assign({0, size});
+      if (!groups || (_dfa_finds_groups && (!_pike_vm || _pike_vm->run(first, last, size, flags, true, captures) == Dfa_outcome::matched)))
+        return true;
+    }
+
+    std::cmatch match;
+    bool const  matched = std::regex_match(first, last, match, *_compiled_regex, flags);
+    Capture_spans::of(match, captures, groups);
+    return matched;
+  }
+
+  if (!_literal_finder->equals(std::string_view(first, size)))
+    return false;
+  captures.assign({0, size});
+  return true;
+}
+
+// Under match_prev_avail or match_not_bol, ^ does not hold at the start of the text, and
+// an anchored regex matches nowhere.
+bool Compiled_query::_cannot_match(char const* first, char const* last, std::regex_constants::match_flag_type flags) const
+{
+  using namespace std::regex_constants;
+
+  if (!_match_bounds)
+    return false;
+
+  size_t const length = static_cast<size_t>(last - first);
+  if (length < _match_bounds->min_length || length > _match_bounds->max_length)
+    return true;
+  if (length > 0 && !_match_bounds->first_bytes[static_cast<unsigned char>(*first)])
+    return true;
+  return _match_bounds->anchored && (flags & (match_prev_avail | match_not_bol));
+}
+
+// A literal is never empty, so its matches never overlap or touch an empty match, and the
+// search goes on from the end of each. Under match_continuous, each must start where the
+// last one ended, as for std::cregex_iterator, which keeps the flag for every search.
+template <typename Visit>
+void Compiled_query::_for_each_match(char const* first, char const* last, std::regex_constants::match_flag_type flags, bool groups, Visit&& visit) const
+{
+  if (!_literal_finder)
+  {
+    if (_required_literal_finder && _prefilter_applies(flags))
+    {
+      _for_each_required_literal_match(first, last, flags, groups, visit);
+      return;
+    }
+    if (_lazy_dfa || _skips_positions(first, last, flags))
+    {
+      _for_each_bounded_match(first, last, flags, groups, visit);
+      return;
+    }
+
+    std::vector<size_t> captures;
+    auto const          end = std::cregex_iterator();
+    for (auto it = std::cregex_iterator(first, last, *_compiled_regex, flags); it != end; ++it)
+    {
+      if (!visit(Capture_spans::of(*it, captures, groups), static_cast<size_t>(it->prefix().first - first)))
+        return;
+    }
+    return;
+  }
+
+  std::string_view const text(first, static_cast<size_t>(last - first));
+  bool const             continuous = (flags & std::regex_constants::match_continuous) != 0;
+  size_t const           length     = _literal_finder->size();
+
+  size_t captures[2];
+  for (size_t position = 0; ; )
+  {
+    if (continuous)
+    {
+      if (text.size() - position < length || !_literal_finder->equals(text.substr(position, length)))
+        return;
+    }
+    else
+    {
+      position = _literal_finder->find(text, position);
+      if (position == std::string_view::npos)
+        return;
+    }
+
+    captures[0] = position;
+    captures[1] = position + length;
+    if (!visit(Capture_spans(first, last, captures, 1), size_t(0)))
+      return;
+    position += length;
+  }
+}
+
+// Without match_prev_avail, std::regex_search applies match_not_bol and match_not_bow at
+// every position it tries, while with it, it ignores them; so the first search of the
+// iterator, which alone has neither, cannot be split into searches of lines. Under
+// match_continuous, every match must start where the last one ended, and there is nothing
+// to skip.
+bool Compiled_query::_prefilter_applies(std::regex_constants::match_flag_type flags) const
+{
+  using namespace std::regex_constants;
+
+  if (flags & match_continuous)
+    return false;
+  return (flags & match_prev_avail) || !(flags & (match_not_bol | match_not_bow));
+}
+
+// Every match lies within a line and holds the required literal, so only the lines that
+// hold it are searched, each from its start, or from where the search has got to if that is
+// later. No line that is skipped holds a match, so each search finds the match that the
+// iterator's search from the end of the last match would find. A search that does not start
+// at the start of the text has the previous character available, as the iterator's searches
+// after the first do. A line is searched with its newline, so that $ and \b see it
+// under match_not_eol and match_not_eow, and no match can reach past it. The matches are
+// handed on as if found in the whole text, so a group that took no part in one is at the
+// end of the text, not of the line. A required literal is never empty, and so neither is
+// any match.
+template <typename Visit>
+void Compiled_query::_for_each_required_literal_match(char const* first, char const* last, std::regex_constants::match_flag_type flags, bool groups, Visit&& visit) const
+{
+  using namespace std::regex_constants;
+
+  std::string_view const text(first, static_cast<size_t>(last - first));
+  size_t const           length = _required_literal_finder->size();
+
+  Search_scratch      scratch(_lazy_dfa.get());
+  std::vector<size_t> captures;
+  for (size_t position = 0; ; )
+  {
+    size_t const found = _required_literal_finder->find(text, position);
+    if (found == std::string_view::npos)
+      return;
+
+    size_t const newline_before = text.substr(position, found - position).rfind('\n');
+    size_t const search_from    = newline_before == std::string_view::npos ? position : position + newline_before + 1;
+    size_t const newline_after  = text.find('\n', found + length);
+    size_t const window_end     = newline_after == std::string_view::npos ? text.size() : newline_after + 1;
+
+    bool const skip_positions = _skips_positions(first + search_from, first + window_end, flags);
+    auto       window_flags   = flags;
+    if (window_end < text.size())
+      window_flags |= match_not_eol | match_not_eow;
+
+    for (size_t search_begin = search_from; ; )
+    {
+      auto search_flags = window_flags;
+      if (search_begin > 0)
+        search_flags |= match_prev_avail;
+
+      size_t const origin = _search(first + search_begin, first + window_end, scratch, captures, search_flags, skip_positions, groups);
+      if (origin == std::string_view::npos)
+        break;
+      size_t const base = search_begin + origin;
+      if (!visit(Capture_spans(first + base, last, captures.data(), captures.size() / 2), base))
+        return;
+      position = search_begin = base + captures[1];
+    }
+    position = window_end;
+  }
+}
+
+// A regex that may match the empty string may match anywhere. Trying a position on its own
+// costs more than std::regex_search trying one more, so the bytes a match can start with must
+// be at no more than half the positions, as far as a sample from the start of the text
+// shows. Only a format string that does not copy the prefix or suffix may be given a match
+// searched for from where it starts.
+bool Compiled_query::_skips_positions(char const* first, char const* last, std::regex_constants::match_flag_type flags) const
+{
+  if (!_match_bounds || _copies_context || !_prefilter_applies(flags))
+    return false;
+  if (_match_bounds->anchored)
+    return true;
+  if (_match_bounds->min_length == 0)
+    return false;
+
+  size_t const sample_size = std::min<size_t>(static_cast<size_t>(last - first), 4096);
+  size_t       candidates  = 0;
+  for (size_t i = 0; i < sample_size; ++i)
+    candidates += _match_bounds->first_bytes[static_cast<unsigned char>(first[i])];
+  return candidates * 2 <= sample_size;
+}
+
+// ^ holds at the start of the text alone, so an anchored regex only matches there, and
+// under match_prev_avail, nowhere. Otherwise a match is searched for under match_continuous
+// at each position it can start at, which tries only that position, as std::regex_search
+// does when it gets there; the positions skipped are those where it would fail. A search
+// under match_continuous costs more than std::regex_search trying one more position, so once
+// more than half the positions have been tried anyway, std::regex_search goes on from there.
+Compiled_query::Search_scratch::Search_scratch(Lazy_dfa const* lazy_dfa)
+{
+  if (lazy_dfa)
+    scanner.emplace(*lazy_dfa);
+}
+
+size_t Compiled_query::_search(char const* first, char const* last, Search_scratch& scratch, std::vector<size_t>& captures, std::regex_constants::match_flag_type flags, bool skip_positions, bool groups) const
+{
+  using namespace std::regex_constants;
+
+  if (_lazy_dfa)
+    return _dfa_search(first, last, scratch, captures, flags, groups);
+
+  auto search_from = [&](size_t position, match_flag_type search_flags)
+  {
+    if (!std::regex_search(first + position, last, scratch.match, *_compiled_regex, search_flags))
+      return std::string_view::npos;
+    Capture_spans::of(scratch.match, captures, groups);
+    return position;
+  };
+
+  if (!skip_positions)
+    return search_from(0, flags);
+
+  if (_match_bounds->anchored)
+  {
+    if (flags & match_prev_avail)
+      return std::string_view::npos;
+    return search_from(0, flags | match_continuous);
+  }
+
+  Character_set const& first_bytes  = _match_bounds->first_bytes;
+  size_t const         size         = static_cast<size_t>(last - first);
+  size_t const         min_length   = _match_bounds->min_length;
+  size_t const         min_attempts = 8;
+
+  for (size_t position = 0, attempts = 0; ; ++position, ++attempts)
+  {
+    while (position < size && !first_bytes[static_cast<unsigned char>(first[position])])
+      ++position;
+    if (size - position < min_length)
+      return std::string_view::npos;
+
+    auto search_flags = position > 0 ? flags | match_prev_avail : flags;
+    if (attempts >= min_attempts && attempts * 2 > position)
+      return search_from(position, search_flags);
+    if (search_from(position, search_flags | match_continuous) != std::string_view::npos)
+      return position;
+  }
+}
+
+// std::regex_search makes an attempt at each position after the first under
+// match_prev_avail, but still applies match_not_bow where the attempt starts if the flag was
+// not ignored from the start. Searching from where the Lazy_dfa's match starts, under
+// match_continuous, makes that attempt alone, as std::regex_search made it, and so does the
+// Pike_vm; where it would apply match_not_bow, match_not_bol in place of match_prev_avail
+// keeps both ^ and \b from holding there, as they do not in the attempt, while \b still sees
+// the character before every later position. Where the Lazy_dfa finds where the match
+// ends, neither is run unless its groups are asked for, and std::regex is only run for the
+// groups of a POSIX regex. Should the attempt not match after all, std::regex searches the
+// whole text itself.
+size_t Compiled_query::_dfa_search(char const* first, char const* last, Search_scratch& scratch, std::vector<size_t>& captures, std::regex_constants::match_flag_type flags, bool groups) const
+{
+  using namespace std::regex_constants;
+
+  std::cmatch&     match = scratch.match;
+  Dfa_search const found = scratch.scanner->search(first, last, flags);
+  if (found.outcome == Dfa_outcome::not_matched)
+    return std::string_view::npos;
+
+  auto attempt_flags = flags | match_continuous;
+  if (found.begin > 0)
+    attempt_flags |= (flags & match_not_bow) && !(flags & match_prev_avail) ? match_not_bol : match_prev_avail;
+
+  if (_dfa_ends_matches)
+  {
+    size_t const length = found.end - found.begin;
+    captures.assign({0, length});
+    if (!groups || (_dfa_finds_groups && (!_pike_vm || _pike_vm->run(first + found.begin, last, length, attempt_flags, false, captures) == Dfa_outcome::matched)))
+      return found.begin;
+  }
+  if (std::regex_search(first + found.begin, last, match, *_compiled_regex, attempt_flags))
+  {
+    Capture_spans::of(match, captures, groups);
+    return found.begin;
+  }
+
+  if (!std::regex_search(first, last, match, *_compiled_regex, flags))
+    return std::string_view::npos;
+  Capture_spans::of(match, captures, groups);
+  return 0;
+}
+
+// The searches follow std::cregex_iterator: after an empty match, the next is first sought
+// at the same position under match_not_null and match_continuous, and every search after the
+// first has the previous character available.
+template <typename Visit>
+void Compiled_query::_for_each_bounded_match(char const* first, char const* last, std::regex_constants::match_flag_type flags, bool groups, Visit&& visit) const
+{
+  using namespace std::regex_constants;
+
+  size_t const size = static_cast<size_t>(last - first);
+
+  Search_scratch      scratch(_lazy_dfa.get());
+  std::vector<size_t> captures;
+  auto visit_found = [&](size_t base)
+  {
+    return visit(Capture_spans(first + base, last, captures.data(), captures.size() / 2), base);
+  };
+
+  for (size_t position = 0; ; )
+  {
+    size_t const origin = _search(first + position, last, scratch, captures, flags, true, groups);
+    if (origin == std::string_view::npos || !visit_found(position + origin))
+      return;
+
+    size_t const match_end = position + origin + captures[1];
+    if (captures[0] == captures[1])
+    {
+      if (match_end == size)
+        return;
+      size_t const next_origin = _search(first + match_end, last, scratch, captures, flags | match_not_null | match_continuous, false, groups);
+      if (next_origin != std::string_view::npos)
+      {
+        if (!visit_found(match_end + next_origin))
+          return;
+        position = match_end + next_origin + captures[1];
+      }
+      else
+      {
+        position = match_end + 1;
+      }
+    }
+    else
+    {
+      position = match_end;
+    }
+    flags |= match_prev_avail;
+  }
+}
+
+std::shared_ptr<Results> Compiled_query::execute(std::string_view text, std::shared_ptr<void const> text_owner) const
+{
+  if (_regex_options.result_options().exists() && _regex_options.algorithm() != Algorithm::replace)
+    return std::make_shared<Exists_results>(exists(text));
+
+  if (_regex_options.result_options().count() && _regex_options.algorithm() != Algorithm::replace)
+    return std::make_shared<Count_results>(count(text));
+
+  if (_regex_options.lines() && _regex_options.algorithm() != Algorithm::replace)
+    return std::make_shared<Line_results>(lines(text, std::move(text_owner)));
+
+  switch (_regex_options.algorithm())
+  {
+    case Algorithm::match:
+      return std::make_shared<Match_results>(match(text, std::move(text_owner)));
+    case Algorithm::search:
+      if (text_owner)
+        return std::make_shared<Search_table_results>(search_table(text, std::move(text_owner)));
+      return std::make_shared<Search_results>(search(text));
+    case Algorithm::replace:
+      return std::make_shared<Replace_results>(replace(text));
+    default:
+      return nullptr;
+  }
+}
+
+// Call std::regex_match() on the target text sequence, which will produce the captures of
+// the match. Create a Match from them, giving it the format string for output. Return the
+// Match_results created with the match.
+Match_results Compiled_query::match(std::string_view text, std::shared_ptr<void const> text_owner) const
+{
+  char const* const   first = text.data();
+  char const* const   last  = text.data() + text.size();
+  std::vector<size_t> captures;
+  _match(first, last, captures, _regex_options.match_flag_mask(), true);
+
+  Match match = Match(Capture_spans(first, last, captures.data(), captures.size() / 2), _format_program, 0, submatch_text(text_owner));
+
+  Match_results match_results(std::move(match));
+  match_results.keep_text_alive(std::move(text_owner));
+  return match_results;
+}
+
+void Compiled_query::match(std::string_view text, Match_sink& sink, size_t position_offset) const
+{
+  char const* const   first = text.data();
+  char const* const   last  = text.data() + text.size();
+  std::vector<size_t> captures;
+  if (_match(first, last, captures, _regex_options.match_flag_mask(), sink.groups_needed()))
+    sink.add(Capture_spans(first, last, captures.data(), captures.size() / 2), position_offset);
+}
+
+// Call std::regex_search iteratively on the text with std::cregex_iterator, and hand each
+// match to the sink as it is found. A single std::regex_search only finds the first
+// potential match. This function searches the entire text, regardless of matches, in a
+// single pass, unless the sink asks to stop.
+void Compiled_query::search(std::string_view text, Match_sink& sink, size_t position_offset) const
+{
+  _for_each_match(text.data(), text.data() + text.size(), _regex_options.match_flag_mask(), sink.groups_needed(),
+                  [&](Capture_spans const& match, size_t origin)
+                  {
+                    return sink.add(match, position_offset + origin);
+                  });
+}
+
+// Search the text, placing the matches in a std::vector<Match>, which is std::moved into
+// the Search_results constructor.
+Search_results Compiled_query::search(std::string_view text, std::shared_ptr<void const> text_owner) const
+{
+  Match_vector_sink matches(_format_program, submatch_text(text_owner));
+  Match_limit_sink  sink(matches, _regex_options.result_options().max_matches());
+  search(text, sink);
+
+  Search_results search_results(std::move(matches.matches()));
+  search_results.keep_text_alive(std::move(text_owner));
+  return search_results;
+}
+
+// As above, but add each match to a Match_table instead of constructing a Match for it.
+Search_table_results Compiled_query::search_table(std::string_view text, std::shared_ptr<void const> text_owner) const
+{
+  Match_table_sink table(text, _format_program);
+  Match_limit_sink sink(table, _regex_options.result_options().max_matches());
+  search(text, sink);
+
+  Search_table_results search_table_results(std::move(table.match_table()));
+  search_table_results.keep_text_alive(std::move(text_owner));
+  return search_table_results;
+}
+
+// Search text read from a stream, keeping only a bounded window of it in memory.
+//
+// Each round appends a chunk to the buffer and runs a std::cregex_iterator from the first
+// position not yet searched. A match is settled, and kept, if it ends before the last
+// overlap_size bytes of the buffer, if it is at least overlap_size long, or if the stream
+// has ended. At the first unsettled match, or at the start of the overlap if there is none,
+// the round stops; the buffer is trimmed to that point (keeping one byte before it, so that
+// ^ and \b see the real previous character via match_prev_avail), and the next chunk is
+// appended. Searching again from exactly where the last round stopped finds each match
+// once. The one subtlety is an empty match right at that point: std::regex_iterator would
+// next try a non-empty match at the same position, which is what a fresh iterator does
+// after producing that empty match again, so the repeat is skipped.
+void Compiled_query::search(std::istream& text_stream, Match_sink& sink, Stream_options stream_options) const
+{
+  auto match_flag_mask = _regex_options.match_flag_mask();
+  auto chunk_size      = std::max<size_t>(stream_options.chunk_size, 1);
+  auto overlap_size    = stream_options.overlap_size;
+
+  std::string        buffer;
+  size_t             buffer_offset       {0};     // Position of buffer[0] in the whole text.
+  size_t             search_start        {0};     // Index in buffer where the next round begins.
+  bool               skip_empty_at_start {false};
+  bool               end_of_stream       {false};
+
+  while (!end_of_stream)
+  {
+    size_t const carried_size = buffer.size();
+    buffer.resize(carried_size + chunk_size);
+    text_stream.read(&buffer[carried_size], chunk_size);
+    buffer.resize(carried_size + static_cast<size_t>(text_stream.gcount()));
+    end_of_stream = !text_stream;
+
+    size_t const settle_limit = end_of_stream                ? buffer.size()
+                              : buffer.size() > overlap_size ? buffer.size() - overlap_size
+                              :                                0;
+
+    auto flags = match_flag_mask;
+    if (buffer_offset + search_start > 0)
+      flags |= std::regex_constants::match_prev_avail;
+    if (!end_of_stream)
+      flags |= std::regex_constants::match_not_eol | std::regex_constants::match_not_eow;
+
+    char const* const buffer_begin = buffer.data();
+    size_t            restart      = std::max(search_start, settle_limit);
+    bool              last_empty   = skip_empty_at_start;
+    size_t            last_end     = search_start;
+    bool              stopped      = false;
+
+    _for_each_match(buffer_begin + search_start, buffer_begin + buffer.size(), flags, sink.groups_needed(),
+                    [&](Capture_spans const& match, size_t origin)
+                    {
+                      size_t const match_start  = search_start + origin + match.position(0);
+                      size_t const match_length = match.length(0);
+                      size_t const match_end    = match_start + match_length;
+
+                      if (skip_empty_at_start && match_length == 0 && match_start == search_start)
+                        return true;
+
+                      bool const settled = end_of_stream                             ||
+                                           match_end + overlap_size <= buffer.size() ||
+                                           match_length >= overlap_size;
+                      if (!settled)
+                      {
+                        restart = match_start;
+                        return false;
+                      }
+
+                      if (!sink.add(match, buffer_offset + search_start + origin))
+                      {
+                        stopped = true;
+                        return false;
+                      }
+                      last_empty = match_length == 0;
+                      last_end   = match_end;
+                      restart    = std::max(restart, match_end);
+                      return true;
+                    });
+    if (stopped)
+      return;
+
+    skip_empty_at_start = last_empty && last_end == restart;
+
+    size_t const keep_from = restart > 0 ? restart - 1 : 0;
+    buffer.erase(0, keep_from);
+    buffer_offset += keep_from;
+    search_start   = restart - keep_from;
+  }
+}
+
+Search_results Compiled_query::search(std::istream& text_stream, Stream_options stream_options) const
+{
+  Match_vector_sink matches(_format_program);
+  Match_limit_sink  sink(matches, _regex_options.result_options().max_matches());
+  search(text_stream, sink, stream_options);
+  return Search_results(std::move(matches.matches()));
+}
+
+// Count the matches with a Match_count_sink, so that no Match is ever constructed.
+Count_results Compiled_query::count(std::string_view text) const
+{
+  Match_count_sink counter(_regex_options.result_options().count_groups());
+  Match_limit_sink sink(counter, _regex_options.result_options().max_matches());
+  _run_serially(text, sink);
+  return Count_results(_regex_options.algorithm(), counter.match_count(), std::move(counter.group_counts()));
+}
+
+Count_results Compiled_query::count(std::istream& text_stream, Stream_options stream_options) const
+{
+  Match_count_sink counter(_regex_options.result_options().count_groups());
+  Match_limit_sink sink(counter, _regex_options.result_options().max_matches());
+  search(text_stream, sink, stream_options);
+  return Count_results(Algorithm::search, counter.match_count(), std::move(counter.group_counts()));
+}
+
+// Stop at the first match, so that a text with an early match is hardly read at all.
+Exists_results Compiled_query::exists(std::string_view text) const
+{
+  Match_count_sink counter;
+  Match_limit_sink sink(counter, 1);
+  _run_serially(text, sink);
+  return Exists_results(_regex_options.algorithm(), counter.match_count() > 0);
+}
+
+Exists_results Compiled_query::exists(std::istream& text_stream, Stream_options stream_options) const
+{
+  Match_count_sink counter;
+  Match_limit_sink sink(counter, 1);
+  search(text_stream, sink, stream_options);
+  return Exists_results(Algorithm::search, counter.match_count() > 0);
+}
+
+void Compiled_query::execute(std::string_view text, Match_sink& sink) const
+{
+  Match_limit_sink limited_sink(sink, _regex_options.result_options().max_matches());
+  _run_serially(text, limited_sink);
+}
+
+void Compiled_query::execute(std::istream& text_stream, Match_sink& sink, Stream_options stream_options) const
+{
+  Match_limit_sink limited_sink(sink, _regex_options.result_options().max_matches());
+  search(text_stream, limited_sink, stream_options);
+}
+
+// Run the match or search algorithm over the text, or over each line of it in turn if the
+// Regex_options ask for that, until the sink reaches its limit or asks to stop.
+void Compiled_query::_run_serially(std::string_view text, Match_limit_sink& sink) const
+{
+  auto run_target = [this, &sink](std::string_view target, size_t position_offset)
+  {
+    if (_regex_options.algorithm() == Algorithm::match)
+      match(target, sink, position_offset);
+    else
+      search(target, sink, position_offset);
+  };
+
+  if (!_regex_options.lines())
+  {
+    run_target(text, 0);
+    return;
+  }
+
+  for (size_t line_begin = 0; line_begin < text.size() && !sink.stopped(); )
+  {
+    size_t const line_end = find_newline(text, line_begin);
+    run_target(text.substr(line_begin, line_end - line_begin), line_begin);
+    line_begin = line_end + 1;
+  }
+}
+
+// Run the match or search algorithm on each line of the text as a target sequence of its own.
+//
+// The text is cut into blocks of whole lines, and each block is searched by a task on a
+// Thread_pool. The blocks' results are gathered by waiting on their futures in order, which
+// keeps the Lines in text order. A block only knows how many lines it holds, so line numbers
+// are made absolute as the blocks are gathered. Under a limit on the number of matches, a
+// block stops matching once it alone has found that many, though it goes on counting lines,
+// and the gathering drops the matches beyond the limit.
+Line_results Compiled_query::lines(std::string_view text, std::shared_ptr<void const> text_owner) const
+{
+  // A Line found within a block, numbered from the start of the block.
+  struct Block_line
+  {
+    size_t             line_index;
+    size_t             position;
+    size_t             length;
+    std::vector<Match> matches;
+  };
+
+  struct Block_results
+  {
+    size_t                  line_count {0};
+    std::vector<Block_line> lines      {};
+  };
+
+  auto const       match_flag_mask    = _regex_options.match_flag_mask();
+  auto const       algorithm          = _regex_options.algorithm();
+  auto const       line_submatch_text = submatch_text(text_owner);
+  auto const       max_matches        = _regex_options.result_options().max_matches();
+
+  auto search_block = [&](size_t block_begin, size_t block_end)
+  {
+    Block_results block_results;
+    size_t        block_match_count {0};
+    for (size_t line_begin = block_begin; line_begin < block_end; )
+    {
+      size_t const line_end   = find_newline(text, line_begin);
+      char const*  line_first = text.data() + line_begin;
+      char const*  line_last  = text.data() + line_end;
+
+      std::vector<Match> matches;
+      if (max_matches > 0 && block_match_count >= max_matches)
+      {
+        // The limit is reached, so only count the line.
+      }
+      else if (algorithm == Algorithm::match)
+      {
+        std::vector<size_t> captures;
+        if (_match(line_first, line_last, captures, match_flag_mask, true))
+          matches.emplace_back(Match(Capture_spans(line_first, line_last, captures.data(), captures.size() / 2),
+                                     _format_program, line_begin, line_submatch_text));
+      }
+      else
+      {
+        Match_vector_sink line_matches(_format_program, line_submatch_text);
+        Match_limit_sink  sink(line_matches, max_matches > 0 ? max_matches - block_match_count : 0);
+        _for_each_match(line_first, line_last, match_flag_mask, true,
+                        [&](Capture_spans const& match, size_t origin)
+                        {
+                          return sink.add(match, line_begin + origin);
+                        });
+        matches = std::move(line_matches.matches());
+      }
+      block_match_count += matches.size();
+
+      if (!matches.empty())
+        block_results.lines.push_back({block_results.line_count, line_begin, line_end - line_begin, std::move(matches)});
+
+      ++block_results.line_count;
+      line_begin = line_end + 1;
+    }
+    return block_results;
+  };
+
+  // Already running on a pool (one file of many, say), so search the whole text as one block
+  // rather than start a second pool.
+  bool const                  parallel = !Thread_pool::on_worker_thread();
+  std::unique_ptr<Thread_pool> pool     = parallel ? std::make_unique<Thread_pool>() : nullptr;
+
+  size_t const minimum_block_size = 1 << 16;
+  size_t const block_size         = parallel
+                                  ? std::max(minimum_block_size, text.size() / (pool->thread_count() * 4))
+                                  : text.size();
+
+  std::vector<std::future<Block_results>> blocks;
+  for (size_t block_begin = 0; block_begin < text.size(); )
+  {
+    size_t block_end = text.size();
+    if (text.size() - block_begin > block_size)
+      block_end = std::min(find_newline(text, block_begin + block_size) + 1, text.size());
+
+    auto search_this_block = [&search_block, block_begin, block_end]
+    {
+      return search_block(block_begin, block_end);
+    };
+    if (parallel)
+    {
+      blocks.push_back(pool->submit(search_this_block));
+    }
+    else
+    {
+      std::promise<Block_results> block_promise;
+      block_promise.set_value(search_this_block());
+      blocks.push_back(block_promise.get_future());
+    }
+    block_begin = block_end;
+  }
+
+  size_t            line_count  {0};
+  size_t            match_count {0};
+  std::vector<Line> lines;
+  for (auto& block : blocks)
+  {
+    Block_results block_results = block.get();
+    for (auto& block_line : block_results.lines)
+    {
+      if (max_matches > 0)
+      {
+        if (match_count >= max_matches)
+          break;
+        if (block_line.matches.size() > max_matches - match_count)
+          block_line.matches.resize(max_matches - match_count);
+      }
+      match_count += block_line.matches.size();
+
+      lines.emplace_back(line_count + block_line.line_index + 1,
+                         block_line.position,
+                         block_line.length,
+                         std::move(block_line.matches));
+    }
+    line_count += block_results.line_count;
+  }
+
+  Line_results line_results(algorithm, line_count, std::move(lines));
+  line_results.keep_text_alive(std::move(text_owner));
+  return line_results;
+}
+
+// Replace the matches in the target text sequence as std::regex_replace does, writing the
+// result into a std::string, but running the replacement Format_program for each match
+// rather than parsing the format string again. The text before each match is copied from
+// the end of the last one, which is where the prefix of each match begins. Return a
+// Replace_results object with that result.
+Replace_results Compiled_query::replace(std::string_view text) const
+{
+  auto const  match_flag_mask = _regex_options.match_flag_mask();
+  bool const  copy_unmatched  = !(match_flag_mask & std::regex_constants::format_no_copy);
+  bool const  first_only      =   match_flag_mask & std::regex_constants::format_first_only;
+  char const* text_begin      = text.data();
+  char const* text_end        = text.data() + text.size();
+
+  std::string replace_result;
+  replace_result.reserve(text.size());
+
+  // The text after the last match, which is the whole text if there is none.
+  char const* rest_begin = text_begin;
+  _for_each_match(text_begin, text_end, match_flag_mask, true,
+                  [&](Capture_spans const& match, size_t origin)
+                  {
+                    char const* const match_first = text_begin + origin + match.position(0);
+                    if (copy_unmatched)
+                      replace_result.append(rest_begin, match_first);
+                    _replace_program.run(match, replace_result);
+                    rest_begin = match_first + match.length(0);
+                    return !first_only;
+                  });
+  if (copy_unmatched)
+    replace_result.append(rest_begin, text_end);
+
+  return Replace_results(std::move(replace_result));
+}
@@ -0,0 +1,212 @@
+#ifndef COMPILED_QUERY_H
+#define COMPILED_QUERY_H
+
+#include <iostream>
+#include <memory>
+#include <optional>
+#include <regex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <format_program.h>
+#include <lazy_dfa.h>
+#include <literal_finder.h>
+#include <match_sink.h>
+#include <pike_vm.h>
+#include <regex_analysis.h>
+#include <regex_options.h>
+#include <results.h>
+
+// Stream_options control how text read from a std::istream is buffered while it is searched.
+// Memory use is bounded by the chunk size plus twice the overlap, rather than by the input size.
+// Matches are found exactly once, and exactly as in a search of the whole text, as long as
+// neither a match nor the text the regex must look at to settle it is longer than the overlap.
+// Only the buffered window is known when a match is handed on, so its prefix and suffix lie
+// within the window, and a group that took no part in it is at the end of the window, where
+// in a search of the whole text it would be at the end of the text.
+struct Stream_options
+{
+  size_t chunk_size   {1 << 20}; // Number of bytes read from the stream at a time.
+  size_t overlap_size {1 << 16}; // Number of trailing bytes of a chunk that are searched again with the next one.
+};
+
+// A Compiled_query is a regex compiled together with the Regex_options it runs under, ready
+// to be applied to any number of texts. The regex is compiled (or taken from the process-wide
+// Regex_cache) once, on construction, which throws std::regex_error if it is invalid. After
+// that the query is immutable, and every member function is const, so one Compiled_query may
+// be shared between threads and applied to many texts at once.
+//
+// The algorithm functions take the text as a std::string_view and, by default, return Results
+// that own a copy of every Submatch text, so the text need only live for the duration of the
+// call. Given the owner of the text as well, they instead return Results whose Submatches
+// view the text, and which keep its owner alive. execute() runs whichever algorithm the
+// Regex_options select, line by line if they ask for that. Their Result_options may ask for
+// only a count of the matches, or only whether there is one, and may limit the number of
+// matches found. A search given the owner of the text gathers its matches into a
+// Match_table, which needs the text to stay alive.
+//
+// The format string is parsed into Format_programs along with the regex: one that formats
+// the Matches, under the ECMAScript rules as std::match_results::format does by default,
+// and one that formats the replacements, under the rules the match flags select.
+//
+// Matches are handed on as Capture_spans. Those of the matches std::regex finds are taken
+// from its std::cmatch; those found without it are set directly.
+//
+// A regex that is a plain literal (see literal_of_regex) is not compiled at all: its matches
+// are found with a Literal_finder, and each is handed on with the captures std::regex would
+// have given it, so the output is the same. Its prefix is not the one std::regex would give
+// it, so a query whose format string copies the prefix or suffix of a match compiles the
+// regex after all.
+//
+// Any other regex is also parsed into a Regex_tree. If every match of it lies within one
+// line, and holds a literal (see required_literal), a search looks for the literal with a
+// Literal_finder, and hands only the lines that hold it to std::regex_search. Searches under
+// match_continuous, or under match_not_bol or match_not_bow without match_prev_avail, and
+// queries whose format string copies the prefix or suffix, search the whole text.
+//
+// The Match_bounds of the regex settle a match at once if the text is too short or too long
+// for the regex, or starts with a byte no match can start with. A search, under the same
+// flags and format strings as above, only tries the positions a match can start at: the
+// start of the text alone if the regex is anchored, and otherwise the bytes a match can start
+// with that leave room for the shortest match, as long as those bytes are rare in the text.
+//
+// Under Engine::dfa, a regex that compiles to an Nfa (see compile_nfa) is searched and
+// matched with a Lazy_dfa instead, in time linear in the text. The groups of an ECMAScript
+// regex's match are then found with a Pike_vm, over the match alone, and only if the sink
+// needs them (see Match_sink::groups_needed). std::regex is only run where the Lazy_dfa has
+// found a match of a POSIX regex, under match_continuous from where it starts.
+// A query whose format string copies the prefix or suffix uses std::regex alone.
+//
+// The Regex_tree's findings and the automata are taken, with the std::regex, from the
+// Regex_cache (see Regex_automata), so queries of the same regex share one Lazy_dfa.
+class Compiled_query
+{
+  std::string                       _regex                   {""};
+  Regex_options                     _regex_options           {};
+  std::shared_ptr<std::regex const> _compiled_regex          {nullptr};
+  std::optional<Literal_finder>     _literal_finder          {};
+  std::optional<Literal_finder>     _required_literal_finder {};
+  std::optional<Match_bounds>       _match_bounds            {};
+  std::shared_ptr<Lazy_dfa const>   _lazy_dfa                {nullptr};
+  std::shared_ptr<Pike_vm const>    _pike_vm                 {nullptr};
+  bool                              _dfa_ends_matches        {false}; // Whether the Lazy_dfa finds where std::regex's match ends.
+  bool                              _dfa_finds_groups        {false}; // Whether the groups of a match are known without std::regex: there are none, or the Pike_vm finds them.
+  bool                              _copies_context          {false};
+  Format_program                    _format_program          {};
+  Format_program                    _replace_program         {};
+
+public:
+  Compiled_query() = delete;
+  Compiled_query(std::string                       regex,
+                 Regex_options                     regex_options  = Regex_options(),
+                 std::shared_ptr<std::regex const> compiled_regex = nullptr);
+
+  std::string       const& regex()          const { return _regex;                };
+  Regex_options     const& regex_options()  const { return _regex_options;        };
+  std::regex        const* compiled_regex() const { return _compiled_regex.get(); };
+  Format_program    const& format_program() const { return _format_program;       };
+
+  // Whether the regex is a plain literal, found without std::regex, in which case it has no
+  // compiled regex.
+  bool literal() const { return _literal_finder.has_value(); };
+
+  // Run the algorithm selected in the Regex_options over the text.
+  std::shared_ptr<Results> execute(std::string_view text, std::shared_ptr<void const> text_owner = nullptr) const;
+
+  // Each algorithm on its own, whatever the Regex_options select.
+  Match_results   match  (std::string_view text, std::shared_ptr<void const> text_owner = nullptr) const;
+  Search_results  search (std::string_view text, std::shared_ptr<void const> text_owner = nullptr) const;
+  Replace_results replace(std::string_view text) const;
+  Line_results    lines  (std::string_view text, std::shared_ptr<void const> text_owner = nullptr) const;
+
+  // Search, gathering the matches into the columns of a Match_table. The text must outlive
+  // the Results, unless its owner is given for them to keep alive.
+  Search_table_results search_table(std::string_view text, std::shared_ptr<void const> text_owner = nullptr) const;
+
+  // Search text read from a stream a chunk at a time, without ever holding all of it.
+  Search_results  search (std::istream& text_stream, Stream_options stream_options = Stream_options()) const;
+
+  // Match, handing the match to the sink if it succeeds. The position offset is the position
+  // of the text in a larger one, and is handed to the sink with each match.
+  void match(std::string_view text, Match_sink& sink, size_t position_offset = 0) const;
+
+  // Search in a single pass, handing each match to the sink as soon as it is found.
+  void search(std::string_view text,        Match_sink& sink, size_t position_offset = 0) const;
+  void search(std::istream&    text_stream, Match_sink& sink, Stream_options stream_options = Stream_options()) const;
+
+  // Run the match or search algorithm, line by line if the Regex_options ask for that, in a
+  // single pass, handing each match to the sink as soon as it is found, until the sink asks
+  // to stop or the Result_options' limit on the number of matches is reached. The stream is
+  // always searched.
+  void execute(std::string_view text,        Match_sink& sink) const;
+  void execute(std::istream&    text_stream, Match_sink& sink, Stream_options stream_options = Stream_options()) const;
+
+  // Count the matches of the match or search algorithm, line by line if the Regex_options ask
+  // for that, without constructing or formatting any of them. The stream is always searched.
+  Count_results count(std::string_view text) const;
+  Count_results count(std::istream& text_stream, Stream_options stream_options = Stream_options()) const;
+
+  // Find out whether the match or search algorithm finds a match, line by line if the
+  // Regex_options ask for that, stopping at the first. The stream is always searched.
+  Exists_results exists(std::string_view text) const;
+  Exists_results exists(std::istream& text_stream, Stream_options stream_options = Stream_options()) const;
+
+private:
+  void _run_serially(std::string_view text, Match_limit_sink& sink) const;
+
+  // Match the whole of [first, last) under the match flags, as std::regex_match does, and
+  // set the captures of the match, relative to first, or none if it fails. Only the whole
+  // match is captured unless groups are asked for.
+  bool _match(char const* first, char const* last, std::vector<size_t>& captures, std::regex_constants::match_flag_type flags, bool groups) const;
+
+  // Find the matches in [first, last) in turn under the match flags, as std::cregex_iterator
+  // does, and call visit(match, origin) with the Capture_spans of each until it returns
+  // false. The positions in the match are relative to the origin, itself relative to first.
+  // Only the whole match is captured unless groups are asked for.
+  template <typename Visit>
+  void _for_each_match(char const* first, char const* last, std::regex_constants::match_flag_type flags, bool groups, Visit&& visit) const;
+
+  // Whether the Match_bounds show that the regex cannot match the whole of [first, last)
+  // under the match flags.
+  bool _cannot_match(char const* first, char const* last, std::regex_constants::match_flag_type flags) const;
+
+  // Whether the required literal or the Match_bounds may be used to skip text under the
+  // match flags.
+  bool _prefilter_applies(std::regex_constants::match_flag_type flags) const;
+
+  // As _for_each_match, searching only the lines that hold the required literal.
+  template <typename Visit>
+  void _for_each_required_literal_match(char const* first, char const* last, std::regex_constants::match_flag_type flags, bool groups, Visit&& visit) const;
+
+  // Whether the Match_bounds rule out enough positions in [first, last) for a match to start
+  // at that a search under the match flags should skip them.
+  bool _skips_positions(char const* first, char const* last, std::regex_constants::match_flag_type flags) const;
+
+  // What the searches of one pass through a text keep from one to the next: the std::cmatch
+  // where std::regex leaves its match, and a scanner holding a cache of the Lazy_dfa, if
+  // there is one, so that no search takes one of its own.
+  struct Search_scratch
+  {
+    explicit Search_scratch(Lazy_dfa const* lazy_dfa);
+
+    std::cmatch                      match   {};
+    std::optional<Lazy_dfa::Scanner> scanner {};
+  };
+
+  // Search [first, last) under the match flags as std::regex_search does, trying only the
+  // positions the Match_bounds allow a match to start at if asked to skip the others. Return
+  // the position the captures of the match are relative to, itself relative to first, or
+  // std::string_view::npos if there is no match.
+  size_t _search(char const* first, char const* last, Search_scratch& scratch, std::vector<size_t>& captures, std::regex_constants::match_flag_type flags, bool skip_positions, bool groups) const;
+
+  // Search [first, last) under the match flags with the Lazy_dfa, and return the position
+  // the captures of the match are relative to, as _search does.
+  size_t _dfa_search(char const* first, char const* last, Search_scratch& scratch, std::vector<size_t>& captures, std::regex_constants::match_flag_type flags, bool groups) const;
+
+  // As _for_each_match, searching with _search.
+  template <typename Visit>
+  void _for_each_bounded_match(char const* first, char const* last, std::regex_constants::match_flag_type flags, bool groups, Visit&& visit) const;
+};
+
+#endif /* COMPILED_QUERY_H */
@@ -0,0 +1,120 @@
+#include <document_writer.h>
+
+#include <cstdint>
+#include <cstring>
+
+namespace
+{
+  bool is_continuation_byte(unsigned char byte, unsigned char low = 0x80, unsigned char high = 0xbf)
+  {
+    return byte >= low && byte <= high;
+  }
+}
+
+Document_writer::Document_writer(std::ostream& os, size_t buffer_size, bool delta_positions)
+: _os              (&os),
+  _buffer_size     (buffer_size),
+  _delta_positions (delta_positions)
+{
+  _buffer.reserve(buffer_size);
+}
+
+Document_writer::~Document_writer()
+{
+  if (_os)
+    _os->write(_buffer.data(), static_cast<std::streamsize>(_buffer.size()));
+}
+
+void Document_writer::position(size_t position)
+{
+  if (!_delta_positions)
+  {
+    number(position);
+    return;
+  }
+
+  signed_number(static_cast<long long>(position) - static_cast<long long>(_last_position));
+  _last_position = position;
+}
+
+void Document_writer::flush()
+{
+  if (!_os)
+    return;
+
+  _os->write(_buffer.data(), static_cast<std::streamsize>(_buffer.size()));
+  _os->flush();
+  _buffer.clear();
+}
+
+std::string Document_writer::take()
+{
+  std::string document = std::move(_buffer);
+  _buffer.clear();
+  return document;
+}
+
+void Document_writer::_write_buffer_if_full()
+{
+  if (!_os || _buffer.size() < _buffer_size)
+    return;
+
+  _os->write(_buffer.data(), static_cast<std::streamsize>(_buffer.size()));
+  _buffer.clear();
+}
+
+size_t utf8_sequence_length(std::string_view text)
+{
+  auto const byte = [&](size_t i) { return static_cast<unsigned char>(text[i]); };
+
+  unsigned char const lead = byte(0);
+  if (lead < 0x80)
+    return 1;
+
+  if (lead >= 0xc2 && lead <= 0xdf)
+    return text.size() >= 2 && is_continuation_byte(byte(1)) ? 2 : 0;
+
+  if (lead >= 0xe0 && lead <= 0xef)
+  {
+    unsigned char const low  = lead == 0xe0 ? 0xa0 : 0x80;
+    unsigned char const high = lead == 0xed ? 0x9f : 0xbf;
+    return text.size() >= 3 && is_continuation_byte(byte(1), low, high)
+                            && is_continuation_byte(byte(2)) ? 3 : 0;
+  }
+
+  if (lead >= 0xf0 && lead <= 0xf4)
+  {
+    unsigned char const low  = lead == 0xf0 ? 0x90 : 0x80;
+    unsigned char const high = lead == 0xf4 ? 0x8f : 0xbf;
+    return text.size() >= 4 && is_continuation_byte(byte(1), low, high)
+                            && is_continuation_byte(byte(2))
+                            && is_continuation_byte(byte(3)) ? 4 : 0;
+  }
+
+  return 0;
+}
+
+// Skip ASCII eight bytes at a time, and check any other sequence in full.
+bool is_valid_utf8(std::string_view text)
+{
+  size_t i = 0;
+  while (i < text.size())
+  {
+    if (i + 8 <= text.size())
+    {
+      std::uint64_t block;
+      std::memcpy(&block, text.data() + i, sizeof(block));
+      if ((block & 0x8080808080808080ull) == 0)
+      {
+        i += 8;
+        continue;
+      }
+    }
+
+    size_t const length = utf8_sequence_length(text.substr(i));
+    if (length == 0)
+      return false;
+    i += length;
+  }
+  return true;
+}
@@ -0,0 +1,91 @@
+#ifndef DOCUMENT_WRITER_H
+#define DOCUMENT_WRITER_H
+
+#include <iostream>
+#include <memory>
+#include <string>
+#include <string_view>
+
+// Output_format selects how the query and its results are written to standard output.
+enum class Output_format
+{
+  json,    // The query and its results as one indented JSON document, once the query has run.
+  ndjson,  // Each match as a line of JSON, as soon as it is found.
+  cbor,    // The document of the JSON output, encoded in CBOR (RFC 8949).
+  msgpack, // The document of the JSON output, encoded in MessagePack.
+  arrow    // The matches as a table, in an Apache Arrow IPC stream.
+};
+
+// Output_options control how the query and its results are written. With delta positions, a
+// binary document writes every position as its difference from the position written before
+// it, which keeps the numbers small, and so short, in a long run of matches. With arrow text,
+// an Arrow table holds the text of each match as well as its position.
+struct Output_options
+{
+  Output_format format          {Output_format::json};
+  bool          delta_positions {false};
+  bool          arrow_text      {false};
+};
+
+// A Document_writer writes a document of nested objects and arrays, holding strings, numbers,
+// booleans and nulls, straight into an output buffer as it is given the values, with no
+// document built in memory. Objects and arrays are opened with the number of members or
+// elements they will hold, which a binary encoding writes up front, and closed explicitly;
+// a value in an object follows its key(). Given a stream, the writer writes the buffer to it
+// whenever the buffer grows past the buffer size, and whatever is left when it is flushed or
+// destroyed; otherwise the whole document stays in the buffer, for take().
+class Document_writer
+{
+  std::ostream* _os              {nullptr};
+  size_t        _buffer_size     {0};
+  bool          _delta_positions {false};
+  size_t        _last_position   {0};
+
+protected:
+  std::string   _buffer          {""};
+
+public:
+  static constexpr size_t default_buffer_size = 1 << 16;
+
+  Document_writer() = default;
+  Document_writer(std::ostream& os, size_t buffer_size = default_buffer_size, bool delta_positions = false);
+  virtual ~Document_writer();
+
+  Document_writer(Document_writer const&)            = delete;
+  Document_writer& operator=(Document_writer const&) = delete;
+
+  virtual void begin_object(size_t member_count)  = 0;
+  virtual void end_object()                       = 0;
+  virtual void begin_array (size_t element_count) = 0;
+  virtual void end_array()                        = 0;
+
+  virtual void key          (std::string_view name) = 0;
+  virtual void string       (std::string_view text) = 0;
+  virtual void number       (size_t number)         = 0;
+  virtual void signed_number(long long number)      = 0;
+  virtual void boolean      (bool value)            = 0;
+  virtual void null         ()                      = 0;
+
+  // Write a position in the text as a number or, with delta positions, as the difference
+  // from the last position written.
+  void position(size_t position);
+
+  // Write the buffer to the stream, and flush the stream.
+  void flush();
+
+  // Return the document written so far, for a writer without a stream, and empty the buffer.
+  std::string take();
+
+protected:
+  void _write_buffer_if_full();
+};
+
+// Return the length of the well-formed UTF-8 sequence that starts the text, as defined by
+// RFC 3629 (no overlong forms, surrogates, or code points past U+10FFFF), or 0 if there
+// is none.
+size_t utf8_sequence_length(std::string_view text);
+
+// Return whether the whole text is well-formed UTF-8.
+bool is_valid_utf8(std::string_view text);
+
+#endif /* DOCUMENT_WRITER_H */
@@ -0,0 +1,234 @@
+#include <files_helper.h>
+#include <arrow_writer.h>
+#include <binary_writer.h>
+#include <json_writer.h>
+#include <mapped_file.h>
+#include <stream_insert_overloads.h>
+#include <thread_pool.h>
+
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <stdexcept>
+#include <system_error>
+
+#include <glob.h>
+
+namespace
+{
+  // A file holding a NUL byte within this many bytes of its start is taken to be binary.
+  size_t const binary_probe_size = 1 << 16;
+
+  // Read the file and run the regex over it, unless it cannot be read or looks binary. The
+  // file is read rather than mapped, since the files of a tree being searched may be
+  // truncated while they are, which would fault a mapping. Whatever stops the search of the
+  // file, such as a regex that grows too complex over it, is taken as the reason it is
+  // skipped, and the other files are searched as ever.
+  File_result run_regex_over_file(std::string                           const& path,
+                                  std::shared_ptr<Compiled_query const> const& query)
+  {
+    File_result file_result;
+    file_result.path = path;
+
+    try
+    {
+      Mapped_file      text_file(path, Mapped_file::Access::read);
+      std::string_view text = text_file.view();
+      if (std::memchr(text.data(), '\0', std::min(text.size(), binary_probe_size)))
+      {
+        file_result.skipped_reason = "binary";
+        return file_result;
+      }
+
+      // The Submatches copy their text, so the file need not stay in memory while its
+      // results wait to be written out with those of every other file.
+      file_result.results = query->execute(text);
+    }
+    catch (std::exception const& error)
+    {
+      file_result.skipped_reason = error.what();
+    }
+
+    return file_result;
+  }
+
+  void add_directory_files(std::filesystem::path const& directory, std::vector<std::string>& files)
+  {
+    std::error_code error;
+    auto const options = std::filesystem::directory_options::skip_permission_denied;
+    for (auto it = std::filesystem::recursive_directory_iterator(directory, options, error);
+         !error && it != std::filesystem::recursive_directory_iterator();
+         it.increment(error))
+    {
+      if (it->is_regular_file(error))
+        files.push_back(it->path().string());
+    }
+  }
+
+  void add_path_files(std::string const& path, std::vector<std::string>& files)
+  {
+    std::error_code error;
+    if (std::filesystem::is_directory(path, error))
+      add_directory_files(path, files);
+    else if (std::filesystem::is_regular_file(path, error))
+      files.push_back(path);
+  }
+}
+
+// Expand the paths into files, compile the regex once, and run it over the files on a
+// Thread_pool. The largest files are submitted first, so that they start early and the
+// small ones fill in around them. The results are gathered back in path order.
+Files_helper::Files_helper(std::vector<std::string> const& path_arguments,
+                           std::string                  && regex,
+                           Regex_options                && regex_options)
+: _query (std::make_shared<Compiled_query const>(std::move(regex), std::move(regex_options)))
+{
+  std::vector<std::string> const paths = expand_path_arguments(path_arguments);
+
+  std::vector<std::pair<uintmax_t, size_t>> sizes_and_indices;
+  sizes_and_indices.reserve(paths.size());
+  for (size_t i = 0; i < paths.size(); ++i)
+  {
+    std::error_code error;
+    uintmax_t size = std::filesystem::file_size(paths[i], error);
+    sizes_and_indices.emplace_back(error ? 0 : size, i);
+  }
+  std::sort(sizes_and_indices.begin(), sizes_and_indices.end(), std::greater<>());
+
+  std::vector<std::future<File_result>> file_results(paths.size());
+  {
+    Thread_pool pool;
+    for (auto const& size_and_index : sizes_and_indices)
+    {
+      std::string const& path = paths[size_and_index.second];
+      file_results[size_and_index.second] = pool.submit([this, &path]
+      {
+        return run_regex_over_file(path, _query);
+      });
+    }
+  }
+
+  _file_results.reserve(file_results.size());
+  for (auto& file_result : file_results)
+    _file_results.push_back(file_result.get());
+}
+
+std::vector<std::string> expand_path_arguments(std::vector<std::string> const& path_arguments)
+{
+  std::vector<std::string> files;
+  for (auto const& path_argument : path_arguments)
+  {
+    std::error_code error;
+    if (std::filesystem::exists(path_argument, error))
+    {
+      add_path_files(path_argument, files);
+      continue;
+    }
+
+    glob_t glob_result;
+    if (::glob(path_argument.c_str(), 0, nullptr, &glob_result) == 0)
+    {
+      for (size_t i = 0; i < glob_result.gl_pathc; ++i)
+        add_path_files(glob_result.gl_pathv[i], files);
+    }
+    else
+    {
+      files.push_back(path_argument);
+    }
+    ::globfree(&glob_result);
+  }
+
+  std::sort(files.begin(), files.end());
+  files.erase(std::unique(files.begin(), files.end()), files.end());
+  return files;
+}
+
+bool results_have_match(Results const& results)
+{
+  if (auto line_results = dynamic_cast<Line_results const*>(&results))
+    return line_results->matched_line_count() > 0;
+  if (auto count_results = dynamic_cast<Count_results const*>(&results))
+    return count_results->match_count() > 0;
+  if (auto exists_results = dynamic_cast<Exists_results const*>(&results))
+    return exists_results->exists();
+
+  switch (results.algorithm())
+  {
+    case Algorithm::match:
+      return static_cast<Match_results const&>(results).match().match_successful();
+    case Algorithm::search:
+      if (auto search_table_results = dynamic_cast<Search_table_results const*>(&results))
+        return search_table_results->match_count() > 0;
+      return static_cast<Search_results const&>(results).match_count() > 0;
+    case Algorithm::replace:
+      return true;
+    default:
+      break;
+  }
+  return false;
+}
+
+// Parse the command line arguments into a Files_helper, and return it.
+// The following describes the structure of the parameters of the program:
+//
+// $ cppregex --files=PATH [--files=PATH...] regex [options...]
+//   argv[0]  [1]          [2...]            [i]   [i+1...argc]
+//
+// Every --files=PATH argument, before the regex or among the options, names a file,
+// a directory, or a glob pattern.
+Files_helper create_files_helper_from_args(int argc, char* const argv[])
+{
+  const std::string files_arg_id_text = "--files=";
+  auto is_files_argument = [&](std::string const& arg) { return arg.find(files_arg_id_text) == 0; };
+
+  std::vector<std::string> path_arguments;
+  std::vector<std::string> option_arguments;
+  std::vector<std::string> arguments(argv + 1, argv + argc);
+
+  auto regex_argument = std::find_if_not(arguments.begin(), arguments.end(), is_files_argument);
+  if (regex_argument == arguments.end())
+    throw std::invalid_argument("missing regex after --files");
+  std::string regex = std::move(*regex_argument);
+  arguments.erase(regex_argument);
+
+  for (auto& arg : arguments)
+  {
+    if (is_files_argument(arg))
+      path_arguments.push_back(arg.substr(files_arg_id_text.length()));
+    else
+      option_arguments.push_back(std::move(arg));
+  }
+
+  extract_output_options_from_option_arguments(option_arguments);
+  Regex_options regex_options = create_regex_options_from_option_arguments(option_arguments);
+
+  return Files_helper(path_arguments,
+                      std::move(regex),
+                      std::move(regex_options));
+}
+
+void Files_helper::pretty_print() const
+{
+  Json_writer writer(std::cout, 2);
+  write_document(writer, *this);
+  writer.newline();
+  writer.flush();
+}
+
+void Files_helper::print(Output_options const& output_options) const
+{
+  if (output_options.format == Output_format::arrow)
+  {
+    write_arrow(std::cout, _file_results, output_options);
+    return;
+  }
+  if (output_options.format != Output_format::cbor && output_options.format != Output_format::msgpack)
+  {
+    pretty_print();
+    return;
+  }
+
+  auto writer = create_binary_writer(std::cout, output_options);
+  write_document(*writer, *this);
+  writer->flush();
+}
@@ -0,0 +1,70 @@
+#ifndef FILES_HELPER_H
+#define FILES_HELPER_H
+
+#include <iostream>
+#include <memory>
+#include <regex>
+#include <string>
+#include <vector>
+
+#include <compiled_query.h>
+#include <document_writer.h>
+#include <regex_options.h>
+#include <results.h>
+
+// A File_result is the outcome of running the regex over one file: the Results, or, if
+// the file was skipped, the reason it was skipped.
+struct File_result
+{
+  std::string              path           {""};
+  std::shared_ptr<Results> results        {nullptr};
+  std::string              skipped_reason {""};
+};
+
+// Files_helper runs a regex over many files at once. Given the path arguments, the text of
+// the regex, and the Regex_options, the constructor expands the paths into files, compiles
+// the regex once, and runs it over every file on a work-stealing Thread_pool. Each file is
+// read and searched with the one shared Compiled_query, and files that look binary (they
+// hold a NUL byte near the start) are skipped. The results are kept per file, in path
+// order. As with Regex_helper, pretty_print writes them as JSON.
+class Files_helper
+{
+  std::shared_ptr<Compiled_query const> _query        {nullptr};
+  std::vector<File_result>              _file_results {};
+
+public:
+  Files_helper() = delete;
+  Files_helper(std::vector<std::string> const& path_arguments,
+               std::string                  && regex,
+               Regex_options                && regex_options = Regex_options());
+
+  Compiled_query           const& query()         const { return *_query;                 };
+  std::string              const& regex()         const { return _query->regex();         };
+  Regex_options            const& regex_options() const { return _query->regex_options(); };
+  std::vector<File_result> const& file_results()  const { return _file_results;           };
+
+  // Write formatted JSON to standard output.
+  void pretty_print() const;
+
+  // Write to standard output in the format the Output_options select, as Regex_helper::print
+  // does. The NDJSON format does not apply to files, which are written as JSON.
+  void print(Output_options const& output_options) const;
+
+  friend void write_document(Document_writer& writer, Files_helper const& files_helper);
+};
+
+// Expand path arguments into the sorted list of regular files they name. A regular file
+// names itself, a directory names every regular file beneath it, and any other argument is
+// taken as a glob pattern, whose matches are expanded in turn. An argument that names
+// nothing is kept as it is, so that opening it fails and the file is reported as skipped.
+std::vector<std::string> expand_path_arguments(std::vector<std::string> const& path_arguments);
+
+// Whether the results hold at least one match, so that the file is worth reporting.
+bool results_have_match(Results const& results);
+
+// Read in command line arguments and create a Files_helper reflecting those arguments.
+// argv[1] holds --files=PATH in place of the text, and further --files=PATH arguments may
+// appear before the regex or among the options.
+Files_helper create_files_helper_from_args(int argc, char* const argv[]);
+
+#endif /* FILES_HELPER_H */
@@ -0,0 +1,97 @@
+#include <flatbuffer_builder.h>
+
+#include <algorithm>
+#include <stdexcept>
+
+Flatbuffer_builder::Reference Flatbuffer_builder::create_string(std::string_view text)
+{
+  _align(text.size() + 1, sizeof(std::uint32_t));
+  _reversed_data += '\0';
+  _reversed_data.append(text.rbegin(), text.rend());
+  _prepend(static_cast<std::uint32_t>(text.size()));
+  return static_cast<Reference>(_size());
+}
+
+Flatbuffer_builder::Reference Flatbuffer_builder::create_offset_vector(std::vector<Reference> const& references)
+{
+  _align(references.size() * sizeof(std::uint32_t), sizeof(std::uint32_t));
+  for (auto reference = references.rbegin(); reference != references.rend(); ++reference)
+    _prepend_offset(*reference);
+  _prepend(static_cast<std::uint32_t>(references.size()));
+  return static_cast<Reference>(_size());
+}
+
+// The length before the structs is aligned to 4 bytes, and the structs after it to 8.
+Flatbuffer_builder::Reference Flatbuffer_builder::create_pair_vector(std::vector<std::pair<std::int64_t, std::int64_t>> const& pairs)
+{
+  _align(pairs.size() * 2 * sizeof(std::int64_t), sizeof(std::int64_t));
+  for (auto pair = pairs.rbegin(); pair != pairs.rend(); ++pair)
+  {
+    _prepend(pair->second);
+    _prepend(pair->first);
+  }
+  _prepend(static_cast<std::uint32_t>(pairs.size()));
+  return static_cast<Reference>(_size());
+}
+
+void Flatbuffer_builder::start_table()
+{
+  if (_table_open)
+    throw std::logic_error("flatbuffer: a table is already open");
+
+  _table_open = true;
+  _table_end  = _size();
+}
+
+void Flatbuffer_builder::add_offset(size_t slot, Reference reference)
+{
+  _align(sizeof(std::uint32_t), sizeof(std::uint32_t));
+  _prepend_offset(reference);
+  _table_fields.emplace_back(slot, _size());
+}
+
+// A table starts with the signed offset back to its vtable, which is written just in front
+// of it: the size of the vtable and of the table, then the offset of each field in the table
+// by slot, 0 for a field that is absent.
+Flatbuffer_builder::Reference Flatbuffer_builder::end_table()
+{
+  size_t slot_count = 0;
+  for (auto const& [slot, reference] : _table_fields)
+    slot_count = std::max(slot_count, slot + 1);
+
+  size_t const vtable_size = (2 + slot_count) * sizeof(std::uint16_t);
+  _align(sizeof(std::int32_t), sizeof(std::int32_t));
+  _prepend(static_cast<std::int32_t>(vtable_size));
+  auto const table = static_cast<Reference>(_size());
+
+  std::vector<std::uint16_t> field_offsets(slot_count, 0);
+  for (auto const& [slot, reference] : _table_fields)
+    field_offsets[slot] = static_cast<std::uint16_t>(table - reference);
+
+  for (auto field_offset = field_offsets.rbegin(); field_offset != field_offsets.rend(); ++field_offset)
+    _prepend(*field_offset);
+  _prepend(static_cast<std::uint16_t>(table - _table_end));
+  _prepend(static_cast<std::uint16_t>(vtable_size));
+
+  _table_fields.clear();
+  _table_open = false;
+  return table;
+}
+
+std::string Flatbuffer_builder::finish(Reference root)
+{
+  _align(sizeof(std::uint32_t), sizeof(std::uint64_t));
+  _prepend_offset(root);
+  return std::string(_reversed_data.rbegin(), _reversed_data.rend());
+}
+
+void Flatbuffer_builder::_align(size_t additional, size_t alignment)
+{
+  while ((_size() + additional) % alignment != 0)
+    _reversed_data += '\0';
+}
+
+void Flatbuffer_builder::_prepend_offset(Reference reference)
+{
+  _prepend(static_cast<std::uint32_t>(_size() + sizeof(std::uint32_t) - reference));
+}
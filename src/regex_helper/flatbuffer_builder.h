@@ -0,0 +1,85 @@
+#ifndef FLATBUFFER_BUILDER_H
+#define FLATBUFFER_BUILDER_H
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+// A Flatbuffer_builder builds a FlatBuffer by hand, as the FlatBuffers library would from a
+// schema, for the few small tables that the metadata of a binary format needs. As in that
+// library, the buffer is built from the back to the front: the children of a table (its
+// strings, vectors and subtables) are created first, and each returns a reference that the
+// table then points at, so that every offset points forward, as the format requires. A
+// reference is the distance of the object from the end of the buffer. Every scalar is
+// aligned to its size, and the finished buffer to 8 bytes.
+//
+//   auto const name  = builder.create_string("position");
+//   builder.start_table();
+//   builder.add_offset(0, name);
+//   builder.add_scalar<std::uint8_t>(1, 0);
+//   auto const field = builder.end_table();
+//   std::string const buffer = builder.finish(field);
+class Flatbuffer_builder
+{
+  std::string                            _reversed_data {""};    // The buffer so far, last byte first.
+  bool                                   _table_open    {false};
+  std::vector<std::pair<size_t, size_t>> _table_fields  {};      // [(slot, reference)] of the open table.
+  size_t                                 _table_end     {0};     // The size of the buffer when the table was opened.
+
+public:
+  using Reference = std::uint32_t;
+
+  Reference create_string(std::string_view text);
+
+  // Create a vector of references to tables, strings or vectors.
+  Reference create_offset_vector(std::vector<Reference> const& references);
+
+  // Create a vector of structs made of two 64-bit integers, such as Arrow's FieldNode and Buffer.
+  Reference create_pair_vector(std::vector<std::pair<std::int64_t, std::int64_t>> const& pairs);
+
+  // Open a table, add its fields by slot (the index of the field in the schema, counting the
+  // type of a union as a field of its own), and close it, which returns its reference. Only
+  // one table may be open at a time.
+  void start_table();
+  template <typename T>
+  void add_scalar(size_t slot, T value);
+  void add_offset(size_t slot, Reference reference);
+  Reference end_table();
+
+  // Point the buffer at its root table, and return the finished buffer.
+  std::string finish(Reference root);
+
+private:
+  size_t _size() const { return _reversed_data.size(); };
+
+  // Pad the front of the buffer so that, once a further number of bytes is written, its
+  // size is a multiple of the alignment.
+  void _align(size_t additional, size_t alignment);
+
+  // Write the value in front of the buffer, in little-endian byte order.
+  template <typename T>
+  void _prepend(T value);
+
+  // Write the offset from the front of the buffer to the object with the reference.
+  void _prepend_offset(Reference reference);
+};
+
+template <typename T>
+void Flatbuffer_builder::_prepend(T value)
+{
+  auto const bits = static_cast<std::uint64_t>(value);
+  for (size_t i = sizeof(T); i > 0; --i)
+    _reversed_data += static_cast<char>((bits >> (8 * (i - 1))) & 0xff);
+}
+
+template <typename T>
+void Flatbuffer_builder::add_scalar(size_t slot, T value)
+{
+  _align(sizeof(T), sizeof(T));
+  _prepend(value);
+  _table_fields.emplace_back(slot, _size());
+}
+
+#endif /* FLATBUFFER_BUILDER_H */
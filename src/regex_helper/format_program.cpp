@@ -0,0 +1,145 @@
+#include <format_program.h>
+
+namespace
+{
+  bool is_digit(char character)
+  {
+    return character >= '0' && character <= '9';
+  }
+}
+
+// Translate the format string into steps, following the rules of std::match_results::format
+// in libstdc++ character for character. An escape or reference that names no group copies
+// nothing, as format does, and anything that is not a valid reference is copied literally.
+Format_program::Format_program(std::string_view format_string, std::regex_constants::match_flag_type flags)
+{
+  if (flags & std::regex_constants::format_sed)
+  {
+    bool escaping = false;
+    for (char character : format_string)
+    {
+      if (escaping)
+      {
+        escaping = false;
+        if (is_digit(character))
+          _add_step(Step_kind::group, static_cast<size_t>(character - '0'));
+        else
+          _add_literal(character);
+      }
+      else if (character == '\\')
+        escaping = true;
+      else if (character == '&')
+        _add_step(Step_kind::group, 0);
+      else
+        _add_literal(character);
+    }
+    if (escaping)
+      _add_literal('\\');
+    return;
+  }
+
+  size_t position = 0;
+  while (true)
+  {
+    size_t next = format_string.find('$', position);
+    if (next == std::string_view::npos)
+      break;
+
+    _add_literal(format_string.substr(position, next - position));
+
+    if (++next == format_string.size())
+      _add_literal('$');
+    else if (format_string[next] == '$')
+    {
+      _add_literal('$');
+      ++next;
+    }
+    else if (format_string[next] == '&')
+    {
+      _add_step(Step_kind::group, 0);
+      ++next;
+    }
+    else if (format_string[next] == '`')
+    {
+      _add_step(Step_kind::prefix);
+      ++next;
+    }
+    else if (format_string[next] == '\'')
+    {
+      _add_step(Step_kind::suffix);
+      ++next;
+    }
+    else if (is_digit(format_string[next]))
+    {
+      size_t number = static_cast<size_t>(format_string[next] - '0');
+      if (++next != format_string.size() && is_digit(format_string[next]))
+        number = number * 10 + static_cast<size_t>(format_string[next++] - '0');
+      _add_step(Step_kind::group, number);
+    }
+    else
+      _add_literal('$');
+
+    position = next;
+  }
+  _add_literal(format_string.substr(position));
+}
+
+bool Format_program::copies_prefix_or_suffix() const
+{
+  for (auto const& step : _steps)
+  {
+    if (step.kind == Step_kind::prefix || step.kind == Step_kind::suffix)
+      return true;
+  }
+  return false;
+}
+
+// Run the steps. A group past the last one of the match does not exist, and copies nothing.
+void Format_program::run(Capture_spans const& match, std::string& output) const
+{
+  for (auto const& step : _steps)
+  {
+    switch (step.kind)
+    {
+      case Step_kind::literal:
+        output.append(_literals, step.begin, step.length);
+        break;
+      case Step_kind::group:
+        if (step.begin < match.size())
+          output.append(match.text(step.begin));
+        break;
+      case Step_kind::prefix:
+        if (!match.empty())
+          output.append(match.prefix());
+        break;
+      case Step_kind::suffix:
+        if (!match.empty())
+          output.append(match.suffix());
+        break;
+      default:
+        break;
+    }
+  }
+}
+
+void Format_program::_add_literal(char character)
+{
+  _add_literal(std::string_view(&character, 1));
+}
+
+// Extend the last step if it is a literal too, so that a run of literal text is one copy.
+void Format_program::_add_literal(std::string_view text)
+{
+  if (text.empty())
+    return;
+
+  if (_steps.empty() || _steps.back().kind != Step_kind::literal)
+    _steps.push_back({Step_kind::literal, _literals.size(), 0});
+  _literals.append(text);
+  _steps.back().length += text.size();
+}
+
+void Format_program::_add_step(Step_kind kind, size_t begin)
+{
+  _steps.push_back({kind, begin, 0});
+}
@@ -0,0 +1,58 @@
+#ifndef FORMAT_PROGRAM_H
+#define FORMAT_PROGRAM_H
+
+#include <regex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <capture_spans.h>
+
+// A Format_program is a format string parsed once into a list of steps, each of which either
+// copies a run of literal text or copies part of a match: a group, the prefix, or the suffix.
+// Running the program over a match produces exactly what std::match_results::format produces
+// from the format string, under the ECMAScript rules ($n, $nn, $&, $`, $', $$) or, given
+// std::regex_constants::format_sed, the sed rules (\n, &), but without going over the format
+// string again for every match. An empty format string makes an empty program, whose run
+// writes nothing and can be skipped altogether.
+class Format_program
+{
+  enum class Step_kind
+  {
+    literal, // Copy _literals[begin, begin + length).
+    group,   // Copy the group numbered begin, if it matched.
+    prefix,  // Copy the match prefix, if it is not empty.
+    suffix   // Copy the match suffix, if it is not empty.
+  };
+
+  struct Step
+  {
+    Step_kind kind   {Step_kind::literal};
+    size_t    begin  {0};
+    size_t    length {0};
+  };
+
+  std::vector<Step> _steps    {};
+  std::string       _literals {""}; // The text of every literal step, end to end.
+
+public:
+  Format_program() = default;
+  explicit Format_program(std::string_view                      format_string,
+                          std::regex_constants::match_flag_type flags = std::regex_constants::format_default);
+
+  bool empty() const { return _steps.empty(); };
+
+  // Whether the program copies the prefix or the suffix of a match, and so looks at the text
+  // around it.
+  bool copies_prefix_or_suffix() const;
+
+  // Append the match, formatted, to the output.
+  void run(Capture_spans const& match, std::string& output) const;
+
+private:
+  void _add_literal(char character);
+  void _add_literal(std::string_view text);
+  void _add_step(Step_kind kind, size_t begin = 0);
+};
+
+#endif /* FORMAT_PROGRAM_H */
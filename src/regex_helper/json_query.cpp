@@ -0,0 +1,197 @@
+#include <json_query.h>
+#include <regex_cache.h>
+#include <regex_helper.h>
+#include <thread_pool.h>
+
+#include <deque>
+#include <future>
+#include <stdexcept>
+
+namespace
+{
+  Algorithm algorithm_from_name(std::string const& name)
+  {
+    if (name == "match")
+      return Algorithm::match;
+    if (name == "search")
+      return Algorithm::search;
+    if (name == "replace")
+      return Algorithm::replace;
+    throw std::invalid_argument("unknown algorithm " + name);
+  }
+
+  Grammar grammar_from_name(std::string const& name)
+  {
+    if (name == "ecmascript")
+      return Grammar::ecmascript;
+    if (name == "basic")
+      return Grammar::basic;
+    if (name == "extended")
+      return Grammar::extended;
+    if (name == "awk")
+      return Grammar::awk;
+    if (name == "grep")
+      return Grammar::grep;
+    if (name == "egrep")
+      return Grammar::egrep;
+    throw std::invalid_argument("unknown grammar " + name);
+  }
+
+  Engine engine_from_name(std::string const& name)
+  {
+    if (name == "std")
+      return Engine::std_regex;
+    if (name == "dfa")
+      return Engine::dfa;
+    throw std::invalid_argument("unknown engine " + name);
+  }
+
+  std::string error_json(std::string const& message)
+  {
+    return nlohmann::json{{"error", message}}.dump();
+  }
+
+  std::string statistics_json()
+  {
+    Regex_cache::Statistics const statistics = Regex_cache::instance().statistics();
+    return nlohmann::json{{"regex_cache", {{"size",      statistics.size},
+                                           {"capacity",  statistics.capacity},
+                                           {"hits",      statistics.hits},
+                                           {"misses",    statistics.misses},
+                                           {"evictions", statistics.evictions}}}}.dump();
+  }
+
+  struct Parsed_query
+  {
+    std::string   text          {""};
+    std::string   regex         {""};
+    Regex_options regex_options {};
+  };
+
+  Parsed_query parse_json_query(nlohmann::json const& query_json)
+  {
+    return Parsed_query{query_json.value("text",  std::string("")),
+                        query_json.value("regex", std::string("")),
+                        create_regex_options_from_json(query_json.value("regex_options", nlohmann::json::object()))};
+  }
+}
+
+Regex_options create_regex_options_from_json(nlohmann::json const& regex_options_json)
+{
+  nlohmann::json const empty          = nlohmann::json::object();
+  nlohmann::json const& options       = regex_options_json.is_object() ? regex_options_json : empty;
+  nlohmann::json const  match_json    = options.value("match_options",  empty);
+  nlohmann::json const  syntax_json   = options.value("syntax_options", empty);
+  nlohmann::json const  result_json   = options.value("result_options", empty);
+
+  auto match_options = Match_options(match_json.value("match_not_bol",     false),
+                                     match_json.value("match_not_eol",     false),
+                                     match_json.value("match_not_bow",     false),
+                                     match_json.value("match_not_eow",     false),
+                                     match_json.value("match_any",         false),
+                                     match_json.value("match_not_null",    false),
+                                     match_json.value("match_continuous",  false),
+                                     match_json.value("match_prev_avail",  false),
+                                     match_json.value("format_default",    false),
+                                     match_json.value("format_sed",        false),
+                                     match_json.value("format_no_copy",    false),
+                                     match_json.value("format_first_only", false),
+                                     match_json.value("format_string",     std::string("")));
+
+  auto syntax_options = Syntax_options(grammar_from_name(syntax_json.value("grammar", std::string("ecmascript"))),
+                                       syntax_json.value("icase",     false),
+                                       syntax_json.value("nosubs",    false),
+                                       syntax_json.value("optimize",  false),
+                                       syntax_json.value("collate",   false),
+                                       syntax_json.value("multiline", false));
+
+  auto result_options = Result_options(result_json.value("count",        false),
+                                       result_json.value("count_groups", false),
+                                       result_json.value("max_matches",  size_t(0)),
+                                       result_json.value("exists",       false));
+
+  return Regex_options(algorithm_from_name(options.value("algorithm", std::string("search"))),
+                       match_options,
+                       syntax_options,
+                       options.value("lines", false),
+                       result_options,
+                       engine_from_name(options.value("engine", std::string("std"))));
+}
+
+std::string run_json_query(std::string_view query)
+{
+  try
+  {
+    nlohmann::json query_json = nlohmann::json::parse(query);
+    if (query_json.value("command", std::string("")) == "statistics")
+      return statistics_json();
+
+    Parsed_query parsed_query = parse_json_query(query_json);
+
+    Regex_helper regex_helper(std::move(parsed_query.text),
+                              std::move(parsed_query.regex),
+                              std::move(parsed_query.regex_options));
+    return regex_helper.json(-1);
+  }
+  catch (std::exception const& error)
+  {
+    return error_json(error.what());
+  }
+}
+
+// The text member of the query, if any, is ignored in favour of the descriptor's, and the
+// result holds "text": null rather than an echo of what may be a very large text.
+std::string run_json_query(std::string_view query, int text_fd)
+{
+  try
+  {
+    Mapped_file  text_file(text_fd);
+    Parsed_query parsed_query = parse_json_query(nlohmann::json::parse(query));
+
+    Regex_helper regex_helper(std::move(text_file),
+                              std::make_shared<Compiled_query const>(std::move(parsed_query.regex),
+                                                                     std::move(parsed_query.regex_options)),
+                              false);
+    return regex_helper.json(-1);
+  }
+  catch (std::exception const& error)
+  {
+    return error_json(error.what());
+  }
+}
+
+// Read the queries on this thread and run them on the pool. At most a few queries per
+// worker are in flight at once; once that many are waiting, the oldest result is written
+// before the next query is read, so results come out in order and memory use does not
+// grow with the number of queries.
+void run_json_query_batch(std::istream& queries, std::ostream& results)
+{
+  Thread_pool  pool;
+  size_t const max_in_flight = pool.thread_count() * 16;
+
+  std::deque<std::future<std::string>> in_flight;
+  auto write_oldest = [&]
+  {
+    results << in_flight.front().get() << '\n';
+    in_flight.pop_front();
+  };
+
+  std::string query;
+  while (std::getline(queries, query))
+  {
+    if (query.find_first_not_of(" \t\r") == std::string::npos)
+      continue;
+
+    in_flight.push_back(pool.submit([query = std::move(query)]
+    {
+      return run_json_query(query);
+    }));
+
+    if (in_flight.size() >= max_in_flight)
+      write_oldest();
+  }
+
+  while (!in_flight.empty())
+    write_oldest();
+  results.flush();
+}
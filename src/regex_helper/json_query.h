@@ -0,0 +1,42 @@
+#ifndef JSON_QUERY_H
+#define JSON_QUERY_H
+
+#include <iostream>
+#include <string>
+#include <string_view>
+
+#include <json.hpp>
+#include <mapped_file.h>
+#include <regex_options.h>
+
+// A JSON query is a JSON object in the shape that Regex_helper::pretty_print writes:
+//
+//   {"text": "...", "regex": "...", "regex_options": {"algorithm": "search", ...}}
+//
+// Any member of regex_options may be left out, in which case it takes its default value,
+// as it would on the command line. The result of a query is the single-line JSON of the
+// Regex_helper that ran it, or {"error": "..."} if the query could not be run. Queries
+// take their compiled regexes, and the automata built from them, from the process-wide
+// Regex_cache, so a query repeating an earlier one's regex starts with its Lazy_dfa warm.
+//
+// The query {"command": "statistics"} instead returns the Regex_cache counters:
+//
+//   {"regex_cache": {"size": ..., "capacity": ..., "hits": ..., "misses": ..., "evictions": ...}}
+
+// Create Regex_options from the regex_options member of a JSON query. Throws
+// std::invalid_argument for an unknown algorithm, grammar or engine name.
+Regex_options create_regex_options_from_json(nlohmann::json const& regex_options_json);
+
+// Run one JSON query and return the result.
+std::string run_json_query(std::string_view query);
+
+// Run one JSON query over the contents of an open file descriptor, made into a Mapped_file,
+// rather than the query's own text member. Return the result without echoing the text. The
+// descriptor stays owned by the caller.
+std::string run_json_query(std::string_view query, int text_fd);
+
+// Read JSON queries from the stream, one per line, and write their results to the output
+// stream, one per line, in the same order. Queries run in parallel on a Thread_pool.
+void run_json_query_batch(std::istream& queries, std::ostream& results);
+
+#endif /* JSON_QUERY_H */
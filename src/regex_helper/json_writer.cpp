@@ -0,0 +1,291 @@
+#include <json_writer.h>
+
+#include <charconv>
+
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+namespace
+{
+  // Only acceptable escape sequences in JSON strings: '\b', '\f', '\n', '\r', '\t', '\"', '\\'
+  bool is_valid_json_string_escape_sequence(char escaped_character)
+  {
+    return escaped_character == 'b'  ||
+           escaped_character == 'f'  ||
+           escaped_character == 'n'  ||
+           escaped_character == 'r'  ||
+           escaped_character == 't'  ||
+           escaped_character == '"'  ||
+           escaped_character == '\\';
+  }
+
+  // Append the JSON escape sequence for a control character (below 0x20), which JSON
+  // does not allow to appear raw in a string.
+  void append_json_control_escape(std::string& output, char control)
+  {
+    switch (control)
+    {
+      case '\b': output += "\\b"; break;
+      case '\f': output += "\\f"; break;
+      case '\n': output += "\\n"; break;
+      case '\r': output += "\\r"; break;
+      case '\t': output += "\\t"; break;
+      default:
+      {
+        char const* const hex_digits = "0123456789abcdef";
+        output += "\\u00";
+        output += hex_digits[(control >> 4) & 0xf];
+        output += hex_digits[control & 0xf];
+        break;
+      }
+    }
+  }
+
+  bool needs_attention(unsigned char byte)
+  {
+    return byte < 0x20 || byte >= 0x80 || byte == '"' || byte == '\\';
+  }
+
+  // Return the index of the first byte at or after the start that cannot be copied as it is:
+  // a control character, a quote, a backslash, or a byte of a multi-byte UTF-8 sequence,
+  // which must be checked. Return the size if there is none. The bytes are compared 32 or 16
+  // at a time, as signed bytes, so that one comparison with 0x20 finds both the bytes below
+  // it and those from 0x80 up.
+  size_t find_byte_needing_attention(std::string_view text, size_t start)
+  {
+    char const* const data = text.data();
+    size_t const      size = text.size();
+    size_t            i    = start;
+
+#if defined(__AVX2__)
+    __m256i const space_32     = _mm256_set1_epi8(0x20);
+    __m256i const quote_32     = _mm256_set1_epi8('"');
+    __m256i const backslash_32 = _mm256_set1_epi8('\\');
+    for (; i + 32 <= size; i += 32)
+    {
+      __m256i const block = _mm256_loadu_si256(reinterpret_cast<__m256i const*>(data + i));
+      __m256i const flags = _mm256_or_si256(_mm256_cmpgt_epi8(space_32, block),
+                                            _mm256_or_si256(_mm256_cmpeq_epi8(block, quote_32),
+                                                            _mm256_cmpeq_epi8(block, backslash_32)));
+      unsigned int const mask = static_cast<unsigned int>(_mm256_movemask_epi8(flags));
+      if (mask != 0)
+        return i + static_cast<size_t>(__builtin_ctz(mask));
+    }
+#endif
+
+#if defined(__SSE2__)
+    __m128i const space_16     = _mm_set1_epi8(0x20);
+    __m128i const quote_16     = _mm_set1_epi8('"');
+    __m128i const backslash_16 = _mm_set1_epi8('\\');
+    for (; i + 16 <= size; i += 16)
+    {
+      __m128i const block = _mm_loadu_si128(reinterpret_cast<__m128i const*>(data + i));
+      __m128i const flags = _mm_or_si128(_mm_cmplt_epi8(block, space_16),
+                                         _mm_or_si128(_mm_cmpeq_epi8(block, quote_16),
+                                                      _mm_cmpeq_epi8(block, backslash_16)));
+      unsigned int const mask = static_cast<unsigned int>(_mm_movemask_epi8(flags));
+      if (mask != 0)
+        return i + static_cast<size_t>(__builtin_ctz(mask));
+    }
+#endif
+
+    for (; i < size; ++i)
+    {
+      if (needs_attention(static_cast<unsigned char>(data[i])))
+        return i;
+    }
+    return size;
+  }
+}
+
+Json_writer::Json_writer(int indent)
+: _indent (indent)
+{}
+
+Json_writer::Json_writer(std::ostream& os, int indent, size_t buffer_size)
+: Document_writer (os, buffer_size),
+  _indent         (indent)
+{}
+
+void Json_writer::begin_object(size_t)
+{
+  _begin_scope('{');
+}
+
+void Json_writer::end_object()
+{
+  _end_scope('}');
+}
+
+void Json_writer::begin_array(size_t)
+{
+  _begin_scope('[');
+}
+
+void Json_writer::end_array()
+{
+  _end_scope(']');
+}
+
+void Json_writer::key(std::string_view name)
+{
+  _begin_value();
+  _buffer += '"';
+  append_escaped_for_json(_buffer, name);
+  _buffer += _indent >= 0 ? "\": " : "\":";
+  _after_key = true;
+}
+
+void Json_writer::string(std::string_view text)
+{
+  _begin_value();
+  _buffer += '"';
+  append_escaped_for_json(_buffer, text);
+  _buffer += '"';
+  _write_buffer_if_full();
+}
+
+void Json_writer::number(size_t number)
+{
+  _begin_value();
+  char digits[20];
+  auto const result = std::to_chars(digits, digits + sizeof(digits), number);
+  _buffer.append(digits, result.ptr);
+  _write_buffer_if_full();
+}
+
+void Json_writer::signed_number(long long number)
+{
+  _begin_value();
+  char digits[20];
+  auto const result = std::to_chars(digits, digits + sizeof(digits), number);
+  _buffer.append(digits, result.ptr);
+  _write_buffer_if_full();
+}
+
+void Json_writer::boolean(bool value)
+{
+  _begin_value();
+  _buffer += value ? "true" : "false";
+}
+
+void Json_writer::null()
+{
+  _begin_value();
+  _buffer += "null";
+}
+
+void Json_writer::newline()
+{
+  _buffer += '\n';
+  _write_buffer_if_full();
+}
+
+// A value directly after its key needs nothing before it. Any other value inside an object
+// or array comes after a comma, unless it is the first, and on a line of its own.
+void Json_writer::_begin_value()
+{
+  if (_after_key)
+  {
+    _after_key = false;
+    return;
+  }
+  if (_scope_empty.empty())
+    return;
+
+  if (!_scope_empty.back())
+    _buffer += ',';
+  _scope_empty.back() = false;
+  _write_indent();
+}
+
+void Json_writer::_begin_scope(char open)
+{
+  _begin_value();
+  _buffer += open;
+  _scope_empty.push_back(true);
+}
+
+// An empty object or array closes on the same line, as {} or [].
+void Json_writer::_end_scope(char close)
+{
+  bool const empty = _scope_empty.back();
+  _scope_empty.pop_back();
+  if (!empty)
+    _write_indent();
+  _buffer += close;
+  _write_buffer_if_full();
+}
+
+void Json_writer::_write_indent()
+{
+  if (_indent < 0)
+    return;
+
+  _buffer += '\n';
+  _buffer.append(_scope_empty.size() * static_cast<size_t>(_indent), ' ');
+}
+
+// Copy runs of characters that need no escape whole, found a block at a time, and escape the
+// rest one at a time. Room for the text as it is is made up front, so that a text with few
+// escapes grows the output once.
+void append_escaped_for_json(std::string& output, std::string_view text)
+{
+  output.reserve(output.size() + text.size());
+
+  size_t i = 0;
+  while (true)
+  {
+    size_t const run_end = find_byte_needing_attention(text, i);
+    output.append(text.data() + i, run_end - i);
+    i = run_end;
+    if (i == text.size())
+      break;
+
+    unsigned char const current = static_cast<unsigned char>(text[i]);
+    if (current == '\\')
+    {
+      if (i + 1 < text.size() && is_valid_json_string_escape_sequence(text[i + 1]))
+      {
+        // Move along as-is since the sequence is valid.
+        output.append(text, i, 2);
+        i += 2;
+      }
+      else
+      {
+        // Not valid, so escape the backslash so that the JSON is valid.
+        output += "\\\\";
+        ++i;
+      }
+    }
+    else if (current == '"')
+    {
+      output += "\\\"";
+      ++i;
+    }
+    else if (current < 0x20)
+    {
+      append_json_control_escape(output, text[i]);
+      ++i;
+    }
+    else if (size_t const length = utf8_sequence_length(text.substr(i)))
+    {
+      output.append(text, i, length);
+      i += length;
+    }
+    else
+    {
+      output += "\xef\xbf\xbd";
+      ++i;
+    }
+  }
+}
+
+std::string escape_for_json(std::string_view text)
+{
+  std::string output;
+  output.reserve(text.size());
+  append_escaped_for_json(output, text);
+  return output;
+}
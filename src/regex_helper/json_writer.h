@@ -0,0 +1,63 @@
+#ifndef JSON_WRITER_H
+#define JSON_WRITER_H
+
+#include <iostream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <document_writer.h>
+
+// A Json_writer is a Document_writer that writes JSON text. It puts in the commas, and with an
+// indent of zero or more it puts each member and element on its own line, indented by that
+// many spaces per level, as nlohmann's dump does; with a negative indent it writes everything
+// on one line, with no spaces. JSON has no use for the member and element counts. The writer
+// does not check that values are given where they belong.
+//
+//   writer.begin_object(1);
+//   writer.key("match_count");
+//   writer.number(3);
+//   writer.end_object();
+class Json_writer : public Document_writer
+{
+  int               _indent      {-1};
+  std::vector<bool> _scope_empty {};      // [depth], whether the open object or array has no member yet.
+  bool              _after_key   {false}; // Whether the next value belongs to the key just written.
+
+public:
+  explicit Json_writer(int indent = -1);
+  Json_writer(std::ostream& os, int indent = -1, size_t buffer_size = default_buffer_size);
+
+  void begin_object(size_t member_count)  override;
+  void end_object()                       override;
+  void begin_array (size_t element_count) override;
+  void end_array()                        override;
+
+  void key          (std::string_view name) override;
+  void string       (std::string_view text) override;
+  void number       (size_t number)         override;
+  void signed_number(long long number)      override;
+  void boolean      (bool value)            override;
+  void null         ()                      override;
+
+  // End the line, as after each of a series of values written one per line.
+  void newline();
+
+private:
+  void _begin_value();
+  void _begin_scope(char open);
+  void _end_scope(char close);
+  void _write_indent();
+};
+
+// Append the text to the output with escapes added so that it forms a valid JSON string
+// value, without the quotes. A backslash that already begins a valid JSON escape sequence
+// ('\b', '\f', '\n', '\r', '\t', '\"', '\\') is kept as is, as the text of a regex or a
+// format string is taken to be escaped as intended. A byte that is not part of valid UTF-8
+// is replaced with U+FFFD.
+void append_escaped_for_json(std::string& output, std::string_view text);
+
+// Return the text with escapes added so that it forms a valid JSON string value.
+std::string escape_for_json(std::string_view text);
+
+#endif /* JSON_WRITER_H */
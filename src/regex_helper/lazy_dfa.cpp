@@ -0,0 +1,716 @@
+#include <lazy_dfa.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <set>
+#include <string>
+#include <unordered_map>
+
+namespace
+{
+  // The slot of the threads of the attempt that starts at the current position. Every other
+  // slot is the index of a start position kept while the DFA runs.
+  using Slot = uint16_t;
+  Slot const injected_slot = 0xffff;
+
+  // The symbols a DFA state moves on: the bytes, and the end of the text.
+  size_t const end_symbol   = 256;
+  size_t const symbol_count = 257;
+
+  // The most Nfa states one closure may visit before the search fails as std::regex fails
+  // when its own grows too complex. Each state is visited once for each way the repetitions
+  // on its empty cycle have been entered at the position, so only empty cycles nested deep
+  // within each other come near it.
+  size_t const closure_budget = 1 << 20;
+
+  // The bits of a DFA state. The mode bits stay the same through a run of the DFA, and follow
+  // from the match flags; the others change as it runs.
+  enum State_bits : uint16_t
+  {
+    exact_mode     = 1 << 0, // Only a match of the whole text counts.
+    not_eol_mode   = 1 << 1, // $ does not hold at the end of the text.
+    not_eow_mode   = 1 << 2, // \b does not hold at the end of the text.
+    not_null_mode  = 1 << 3, // An empty match does not count.
+    bol_mode       = 1 << 4, // ^ holds at the start of the text.
+    not_bow_mode   = 1 << 5, // \b does not hold where an attempt starts.
+    first_bit      = 1 << 6, // The next position is the start of the text, where the first attempt starts.
+    searching_bit  = 1 << 7, // An attempt starts at each position after the first.
+    prev_word_bit  = 1 << 8  // The byte before the next position is a word character.
+  };
+
+  // A thread is an Nfa state that an attempt has reached, with the slot of its start.
+  struct Thread
+  {
+    uint32_t state;
+    Slot     slot;
+  };
+
+  int32_t const  no_accept     = -1;
+  uint32_t const unknown_state = 0xffffffff;
+
+  // An edge of a DFA state on a symbol: the state it moves to, the slot of the start of a
+  // match that ends before the symbol, if any, and the map from the slots of the new state to
+  // those of the old, in slot_maps, unless each slot stays as it is but for the last, which
+  // the attempt that starts before the symbol may take. Its start is then written to the
+  // injected slot, which is otherwise the cache's spare slot, so that the DFA need not test
+  // for it on each byte, where it is as likely to be taken as not.
+  struct Edge
+  {
+    uint32_t target   {unknown_state};
+    int32_t  accept   {no_accept};
+    uint32_t slot_map {0}; // The index of the map in slot_maps, plus one, or 0.
+    Slot     injected {0};
+  };
+
+  // What the DFA's loop reads of an edge, kept apart from the edges so that more of them fit
+  // in the processor's cache: the index of the first edge of the state it moves to, and what
+  // else there is to it. An edge is plain if it ends no match and moves to a state that is
+  // not dead, so that the DFA takes it, and maps the starts, without more ado, unless the
+  // state is idle and the DFA skips bytes from idle states.
+  uint32_t const stop_move = 1u << 31; // The edge is not plain, or not built yet.
+  uint32_t const idle_move = 1u << 30; // It moves to an idle state.
+  uint32_t const map_move  = 1u << 29; // It has a slot map.
+  uint32_t const row_mask  = map_move - 1;
+
+  // A map from the slots of a DFA state to those of the state before it, as the slots in
+  // slot_map_data from offset on, of which those before from are mapped to themselves. The
+  // slots of a state's threads never decrease from one thread to the next, and the injected
+  // slot comes last, so each slot is mapped to itself or to one after it, or is injected, and
+  // the starts may be mapped in place, from the first slot on.
+  struct Slot_map
+  {
+    uint32_t offset {0};
+    Slot     from   {0};
+    Slot     size   {0};
+  };
+
+  void map_starts(Slot_map const& slot_map, Slot const* slot_map_data, size_t* starts, size_t position)
+  {
+    Slot const* const slots = slot_map_data + slot_map.offset;
+    for (size_t slot = slot_map.from; slot < slot_map.size; ++slot)
+      starts[slot] = slots[slot] == injected_slot ? position : starts[slots[slot]];
+  }
+
+  // The tries at skipping bytes from idle states after which the DFA stops trying, if they
+  // skipped fewer bytes each than the DFA takes in the time one try costs: a few for memchr,
+  // which only looks for one byte, but many for looking up each byte in turn, which the DFA's
+  // own loop does about as fast.
+  size_t const min_skips       = 16;
+  size_t const min_memchr_skip = 2;
+  size_t const min_lookup_skip = 16;
+
+  struct Dfa_state
+  {
+    uint16_t            bits   {0};
+    std::vector<Thread> kernel {}; // The threads that go on past the last byte, in order.
+    bool                dead   {false}; // No attempt goes on, and none starts.
+    bool                idle   {false}; // No attempt goes on, but one starts at each position.
+  };
+
+  // Follows the threads of a DFA state, and the attempt that starts at the next position, to
+  // the characters states they reach before the next symbol, in the order std::regex's
+  // depth-first search reaches them. A repetition is entered at most twice at one position, as
+  // std::regex enters it. A characters state reached again is left out, as is everything after
+  // an ECMAScript regex's accept: std::regex only goes on to them if the threads before them
+  // fail. A POSIX regex's search goes on past an accept to the longer matches of the same
+  // attempt, so only the threads of the attempts that start later are left out. Any other
+  // state reached again, by the attempt at the next position or by those before it, is left
+  // out too, as it can only reach what it reached the first time, unless the repetitions on
+  // its empty cycle have since been entered more or less often, so that each state is
+  // visited once for each of those.
+  class Closure
+  {
+  public:
+    Closure(Nfa const& nfa, std::array<bool, 256> const& word_bytes)
+    : _nfa        (nfa),
+      _word_bytes (word_bytes),
+      _seen       (nfa.states.size(), 0),
+      _visited    (2 * nfa.states.size(), 0),
+      _entries    (nfa.states.size(), 0)
+    {}
+
+    // Follow the threads and return false if there are too many to follow.
+    bool run(uint16_t bits, std::vector<Thread> const& kernel, size_t symbol)
+    {
+      if (++_generation == 0)
+      {
+        std::fill(_seen.begin(), _seen.end(), 0);
+        std::fill(_visited.begin(), _visited.end(), 0);
+        _generation = 1;
+      }
+      _cycle_visits.clear();
+      _items.clear();
+      _accept    = no_accept;
+      _stopped   = false;
+      _overflow  = false;
+      _steps     = 0;
+      _bits      = bits;
+      _at_end    = symbol == end_symbol;
+      _next_word = !_at_end && _word_bytes[symbol];
+
+      for (auto const& thread : kernel)
+      {
+        _visit(thread.state, thread.slot, false);
+        if (_stopped)
+          break;
+      }
+      if (!_stopped && _accept == no_accept && (bits & (first_bit | searching_bit)))
+        _visit(_nfa.start, injected_slot, true);
+      if (_accept != no_accept && !_nfa.ecmascript)
+      {
+        _items.erase(std::remove_if(_items.begin(), _items.end(), [&](Thread const& thread) { return thread.slot > _accept; }),
+                     _items.end());
+      }
+      return !_overflow;
+    }
+
+    std::vector<Thread> const& items()  const { return _items;  };
+    int32_t                    accept() const { return _accept; };
+
+  private:
+    void _visit(size_t state_index, Slot slot, bool at_start)
+    {
+      if (_stopped)
+        return;
+      if (++_steps > closure_budget)
+      {
+        _overflow = _stopped = true;
+        return;
+      }
+
+      Nfa_state const& state = _nfa.states[state_index];
+      if (state.kind != Nfa_state_kind::characters && state.kind != Nfa_state_kind::accept && !_first_visit(state_index, at_start))
+        return;
+
+      switch (state.kind)
+      {
+        case Nfa_state_kind::characters:
+          if (_seen[state_index] != _generation)
+          {
+            _seen[state_index] = _generation;
+            _items.push_back(Thread{static_cast<uint32_t>(state_index), slot});
+          }
+          return;
+
+        case Nfa_state_kind::accept:
+          if ((at_start && (_bits & not_null_mode)) || ((_bits & exact_mode) && !_at_end))
+            return;
+          if (_accept == no_accept)
+            _accept = slot;
+          if (_nfa.ecmascript)
+            _stopped = true;
+          return;
+
+        case Nfa_state_kind::alternation:
+          for (size_t alternative : state.alternatives)
+          {
+            _visit(alternative, slot, at_start);
+            if (_stopped)
+              return;
+          }
+          return;
+
+        case Nfa_state_kind::repetition:
+          if (state.greedy)
+          {
+            _once_more(state_index, slot, at_start);
+            _visit(state.next, slot, at_start);
+          }
+          else
+          {
+            _visit(state.next, slot, at_start);
+            _once_more(state_index, slot, at_start);
+          }
+          return;
+
+        case Nfa_state_kind::assertion:
+          if (_holds(state.assertion, at_start))
+            _visit(state.next, slot, at_start);
+          return;
+
+        case Nfa_state_kind::group_begin:
+        case Nfa_state_kind::group_end:
+        default:
+          _visit(state.next, slot, at_start);
+          return;
+      }
+    }
+
+    void _once_more(size_t state_index, Slot slot, bool at_start)
+    {
+      uint8_t& entries = _entries[state_index];
+      if (entries >= 2)
+        return;
+      bool const on_cycle = _nfa.states[state_index].cycle != Nfa_state::no_cycle;
+      ++entries;
+      if (on_cycle)
+        _entered.push_back(state_index);
+      _visit(_nfa.states[state_index].body, slot, at_start);
+      if (on_cycle)
+        _entered.pop_back();
+      --entries;
+    }
+
+    // Whether the state has not been reached before at the position, by an attempt that
+    // starts there or not as this one does, with the repetitions on its empty cycle entered
+    // as often as they are now, and mark it reached.
+    bool _first_visit(size_t state_index, bool at_start)
+    {
+      size_t const cycle = _nfa.states[state_index].cycle;
+      if (cycle == Nfa_state::no_cycle)
+      {
+        uint32_t& visited = _visited[2 * state_index + (at_start ? 1 : 0)];
+        if (visited == _generation)
+          return false;
+        visited = _generation;
+        return true;
+      }
+
+      _key.assign({2 * state_index + (at_start ? 1 : 0)});
+      for (size_t repetition : _entered)
+      {
+        if (_nfa.states[repetition].cycle == cycle)
+          _key.push_back(repetition);
+      }
+      std::sort(_key.begin() + 1, _key.end());
+      return _cycle_visits.insert(_key).second;
+    }
+
+    // ^ only holds where the first attempt starts, as the regex is not multiline.
+    bool _holds(Regex_assertion assertion, bool at_start) const
+    {
+      switch (assertion)
+      {
+        case Regex_assertion::line_begin:
+          return at_start && (_bits & first_bit) && (_bits & bol_mode);
+        case Regex_assertion::line_end:
+          return _at_end && !(_bits & not_eol_mode);
+        case Regex_assertion::word_boundary:
+          return _word_boundary(at_start);
+        case Regex_assertion::not_word_boundary:
+        default:
+          return !_word_boundary(at_start);
+      }
+    }
+
+    bool _word_boundary(bool at_start) const
+    {
+      if (at_start && (_bits & not_bow_mode))
+        return false;
+      if (_at_end && (_bits & not_eow_mode))
+        return false;
+      return ((_bits & prev_word_bit) != 0) != _next_word;
+    }
+
+    Nfa const&                    _nfa;
+    std::array<bool, 256> const&  _word_bytes;
+    std::vector<uint32_t>         _seen         {};
+    std::vector<uint32_t>         _visited      {}; // Two for each state: reached by an attempt that starts at the position, or not.
+    std::vector<uint8_t>          _entries      {};
+    std::vector<size_t>           _entered      {}; // The repetitions on empty cycles entered at the position, once for each time.
+    std::set<std::vector<size_t>> _cycle_visits {}; // The states on empty cycles reached, with the repetitions on them entered.
+    std::vector<size_t>           _key          {};
+    uint32_t                      _generation   {0};
+    std::vector<Thread>           _items        {};
+    int32_t                       _accept       {no_accept};
+    bool                          _stopped      {false};
+    bool                          _overflow     {false};
+    size_t                        _steps        {0};
+    uint16_t                      _bits         {0};
+    bool                          _at_end       {false};
+    bool                          _next_word    {false};
+  };
+}
+
+// The DFA states built so far, with an edge for each symbol, and what building more needs.
+struct Lazy_dfa::Cache
+{
+  Cache(Nfa const& nfa, std::array<bool, 256> const& word_bytes)
+  : closure (nfa, word_bytes),
+    seen    (nfa.states.size(), 0),
+    starts  (nfa.states.size() + 1, 0)
+  {
+    spare_slot = static_cast<Slot>(std::min<size_t>(nfa.states.size(), injected_slot - 1));
+    empty_states.fill(unknown_state);
+  }
+
+  std::vector<Dfa_state>                    states        {};
+  std::vector<Edge>                         edges         {}; // symbol_count for each state.
+  std::vector<uint32_t>                     moves         {}; // One for each edge.
+  std::vector<Slot_map>                     slot_maps     {};
+  std::vector<Slot>                         slot_map_data {};
+  std::unordered_map<std::string, uint32_t> index         {};
+  std::array<uint32_t, 1 << 9>              empty_states  {}; // The states without threads, by their bits.
+
+  Closure               closure;
+  std::vector<uint32_t> seen       {};
+  uint32_t              generation {0};
+  std::string           key        {};
+  std::vector<Thread>   kernel     {};
+  std::vector<Slot>     slot_map   {};
+  std::vector<size_t>   starts     {}; // The start of each slot, one for each Nfa state at most, as each has a thread, and the spare slot.
+  Slot                  spare_slot {0};
+
+  void clear()
+  {
+    states.clear();
+    edges.clear();
+    moves.clear();
+    slot_maps.clear();
+    slot_map_data.clear();
+    index.clear();
+    empty_states.fill(unknown_state);
+  }
+
+  // Return the DFA state of the bits and kernel, building it if it is new. Empty the cache
+  // first if it is full, and then set cleared.
+  uint32_t state(uint16_t bits, std::vector<Thread> const& threads, size_t state_limit, bool& cleared)
+  {
+    if (threads.empty() && empty_states[bits] != unknown_state)
+      return empty_states[bits];
+
+    key.assign(reinterpret_cast<char const*>(&bits), sizeof(bits));
+    for (auto const& thread : threads)
+    {
+      key.append(reinterpret_cast<char const*>(&thread.state), sizeof(thread.state));
+      key.append(reinterpret_cast<char const*>(&thread.slot), sizeof(thread.slot));
+    }
+    auto const found = index.find(key);
+    if (found != index.end())
+      return found->second;
+
+    if (states.size() >= state_limit)
+    {
+      clear();
+      cleared = true;
+    }
+    Dfa_state dfa_state;
+    dfa_state.bits   = bits;
+    dfa_state.kernel = threads;
+    dfa_state.dead   = threads.empty() && !(bits & (first_bit | searching_bit));
+    dfa_state.idle   = threads.empty() && (bits & searching_bit) && !(bits & first_bit);
+    states.push_back(std::move(dfa_state));
+    edges.resize(edges.size() + symbol_count);
+    moves.resize(moves.size() + symbol_count, stop_move);
+    uint32_t const state_index = static_cast<uint32_t>(states.size() - 1);
+    index.emplace(key, state_index);
+    if (threads.empty())
+      empty_states[bits] = state_index;
+    return state_index;
+  }
+
+  // Return the DFA state of the bits without threads, as state does.
+  uint32_t empty_state(uint16_t bits, size_t state_limit, bool& cleared)
+  {
+    if (empty_states[bits] != unknown_state)
+      return empty_states[bits];
+    kernel.clear();
+    return state(bits, kernel, state_limit, cleared);
+  }
+};
+
+Lazy_dfa::Lazy_dfa(Nfa nfa, Match_bounds const& match_bounds, size_t state_limit)
+: _nfa          (std::move(nfa)),
+  _match_bounds (match_bounds),
+  _state_limit  (std::min<size_t>(state_limit, row_mask / symbol_count)),
+  _word_bytes   (word_bytes())
+{
+  if (_match_bounds.first_bytes.count() == 1)
+  {
+    _only_first_byte = 0;
+    while (!_match_bounds.first_bytes[static_cast<size_t>(_only_first_byte)])
+      ++_only_first_byte;
+  }
+
+  for (auto const& state : _nfa.states)
+  {
+    if (state.kind == Nfa_state_kind::assertion && (state.assertion == Regex_assertion::word_boundary ||
+                                                    state.assertion == Regex_assertion::not_word_boundary))
+      _word_assertions = true;
+  }
+
+  // A \b or \B is only looked at where the search starts if one is reached from the start
+  // before any byte is consumed.
+  std::vector<bool>   visited(_nfa.states.size(), false);
+  std::vector<size_t> pending {_nfa.start};
+  while (_word_assertions && !pending.empty())
+  {
+    size_t const index = pending.back();
+    pending.pop_back();
+    if (visited[index])
+      continue;
+    visited[index] = true;
+
+    Nfa_state const& state = _nfa.states[index];
+    switch (state.kind)
+    {
+      case Nfa_state_kind::alternation:
+        pending.insert(pending.end(), state.alternatives.begin(), state.alternatives.end());
+        break;
+      case Nfa_state_kind::repetition:
+        pending.push_back(state.body);
+        pending.push_back(state.next);
+        break;
+      case Nfa_state_kind::assertion:
+        if (state.assertion == Regex_assertion::word_boundary || state.assertion == Regex_assertion::not_word_boundary)
+          _leading_word_assertions = true;
+        pending.push_back(state.next);
+        break;
+      case Nfa_state_kind::group_begin:
+      case Nfa_state_kind::group_end:
+        pending.push_back(state.next);
+        break;
+      case Nfa_state_kind::characters:
+      case Nfa_state_kind::accept:
+        break;
+    }
+  }
+}
+
+Lazy_dfa::~Lazy_dfa() = default;
+
+Dfa_search Lazy_dfa::search(char const* first, char const* last, std::regex_constants::match_flag_type flags) const
+{
+  return Scanner(*this).search(first, last, flags);
+}
+
+Dfa_outcome Lazy_dfa::match(char const* first, char const* last, std::regex_constants::match_flag_type flags) const
+{
+  return Scanner(*this).match(first, last, flags);
+}
+
+Lazy_dfa::Scanner::Scanner(Lazy_dfa const& lazy_dfa)
+: _lazy_dfa (lazy_dfa),
+  _cache    (lazy_dfa._take_cache())
+{
+}
+
+Lazy_dfa::Scanner::~Scanner()
+{
+  _lazy_dfa._return_cache(std::move(_cache));
+}
+
+Dfa_search Lazy_dfa::Scanner::search(char const* first, char const* last, std::regex_constants::match_flag_type flags)
+{
+  return _lazy_dfa._run(*_cache, first, last, flags, false);
+}
+
+Dfa_outcome Lazy_dfa::Scanner::match(char const* first, char const* last, std::regex_constants::match_flag_type flags)
+{
+  return _lazy_dfa._run(*_cache, first, last, flags, true).outcome;
+}
+
+std::unique_ptr<Lazy_dfa::Cache> Lazy_dfa::_take_cache() const
+{
+  {
+    std::lock_guard<std::mutex> lock(_cache_mutex);
+    if (!_caches.empty())
+    {
+      auto cache = std::move(_caches.back());
+      _caches.pop_back();
+      return cache;
+    }
+  }
+  return std::make_unique<Cache>(_nfa, _word_bytes);
+}
+
+void Lazy_dfa::_return_cache(std::unique_ptr<Cache> cache) const
+{
+  std::lock_guard<std::mutex> lock(_cache_mutex);
+  _caches.push_back(std::move(cache));
+}
+
+// Under match_prev_avail, std::regex_search ignores match_not_bol and match_not_bow, and ^
+// does not hold at the start of the text. Otherwise each attempt applies match_not_bow where
+// it starts. An anchored regex only matches where the first attempt starts, and under
+// match_continuous, no other attempt is made.
+//
+// Each edge is built the first time the DFA takes it, and a plain edge is then taken in a
+// tight loop over the moves, which follows the index of the current state's first edge
+// rather than the state, and reads the tables through pointers fetched again each time the
+// DFA enters it, as building a state may move them. A DFA state without threads that only
+// waits for an attempt to start skips the bytes no match can start with, as long as no match
+// is empty, and until it turns out that those bytes are too few to be worth skipping.
+Dfa_search Lazy_dfa::_run(Cache& cache, char const* first, char const* last, std::regex_constants::match_flag_type flags, bool exact) const
+{
+  using namespace std::regex_constants;
+
+  bool const prev_avail = (flags & match_prev_avail) != 0;
+  uint16_t   mode       = 0;
+  if (exact)
+    mode |= exact_mode;
+  if (flags & match_not_eol)
+    mode |= not_eol_mode;
+  if (flags & match_not_eow)
+    mode |= not_eow_mode;
+  if (flags & match_not_null)
+    mode |= not_null_mode;
+  if (!prev_avail && !(flags & match_not_bol))
+    mode |= bol_mode;
+  if (!prev_avail && (flags & match_not_bow))
+    mode |= not_bow_mode;
+
+  uint16_t bits = mode | first_bit;
+  if (!exact && !(flags & match_continuous) && !_match_bounds.anchored)
+    bits |= searching_bit;
+  // Like std::regex, only look at the byte before the text if a \b or \B there needs it.
+  if (_leading_word_assertions && prev_avail && _word_bytes[static_cast<unsigned char>(first[-1])])
+    bits |= prev_word_bit;
+
+  size_t const size       = static_cast<size_t>(last - first);
+  bool         skips      = _match_bounds.min_length > 0;
+  size_t       skip_tries = 0;
+  size_t       skipped    = 0;
+  bool const   single     = _only_first_byte >= 0;
+
+  bool     cleared = false;
+  uint32_t state   = cache.empty_state(bits, _state_limit, cleared);
+  size_t*  starts  = cache.starts.data();
+
+  Dfa_search result;
+  result.outcome = Dfa_outcome::not_matched;
+  for (size_t position = 0; ; ++position)
+  {
+    uint32_t const        stop_mask     = skips ? stop_move | idle_move : stop_move;
+    uint32_t const* const moves         = cache.moves.data();
+    Edge const* const     edges         = cache.edges.data();
+    Slot_map const* const slot_maps     = cache.slot_maps.data();
+    Slot const* const     slot_map_data = cache.slot_map_data.data();
+    unsigned char const*  bytes         = reinterpret_cast<unsigned char const*>(first);
+    size_t                row           = state * symbol_count;
+    while (position < size)
+    {
+      size_t const   index = row + bytes[position];
+      uint32_t const move  = moves[index];
+      if (move & stop_mask)
+        break;
+      starts[edges[index].injected] = position;
+      if (move & map_move)
+        map_starts(slot_maps[edges[index].slot_map - 1], slot_map_data, starts, position);
+      row = move & row_mask;
+      ++position;
+    }
+    state = static_cast<uint32_t>(row / symbol_count);
+
+    size_t const symbol = position < size ? static_cast<unsigned char>(first[position]) : end_symbol;
+    Edge         edge   = cache.edges[state * symbol_count + symbol];
+    if (edge.target == unknown_state)
+    {
+      Dfa_state const& dfa_state = cache.states[state];
+      uint16_t const   old_bits  = dfa_state.bits;
+      if (!cache.closure.run(old_bits, dfa_state.kernel, symbol))
+        throw std::regex_error(std::regex_constants::error_complexity);
+
+      edge.accept = cache.closure.accept();
+
+      uint16_t new_bits = old_bits & ~(first_bit | searching_bit | prev_word_bit);
+      if ((old_bits & searching_bit) && edge.accept == no_accept)
+        new_bits |= searching_bit;
+      if (_word_assertions && symbol != end_symbol && _word_bytes[symbol])
+        new_bits |= prev_word_bit;
+
+      // The threads that consume the symbol go on to the states that follow them, each
+      // reached first by the one of them that comes first, and their slots are numbered in
+      // order, since the threads are in order of their starts.
+      cache.kernel.clear();
+      cache.slot_map.clear();
+      if (++cache.generation == 0)
+      {
+        std::fill(cache.seen.begin(), cache.seen.end(), 0);
+        cache.generation = 1;
+      }
+      if (symbol != end_symbol)
+      {
+        for (auto const& thread : cache.closure.items())
+        {
+          Nfa_state const& nfa_state = _nfa.states[thread.state];
+          if (!nfa_state.characters[symbol] || cache.seen[nfa_state.next] == cache.generation)
+            continue;
+          cache.seen[nfa_state.next] = cache.generation;
+          if (cache.slot_map.empty() || cache.slot_map.back() != thread.slot)
+            cache.slot_map.push_back(thread.slot);
+          cache.kernel.push_back(Thread{static_cast<uint32_t>(nfa_state.next), static_cast<Slot>(cache.slot_map.size() - 1)});
+        }
+      }
+
+      size_t from = 0;
+      while (from < cache.slot_map.size() && cache.slot_map[from] == from)
+        ++from;
+
+      cleared     = false;
+      edge.target = symbol == end_symbol ? state : cache.state(new_bits, cache.kernel, _state_limit, cleared);
+      edge.injected = cache.spare_slot;
+      if (from + 1 == cache.slot_map.size() && cache.slot_map[from] == injected_slot)
+      {
+        edge.injected = static_cast<Slot>(from);
+      }
+      else if (from < cache.slot_map.size())
+      {
+        Slot_map slot_map;
+        slot_map.offset = static_cast<uint32_t>(cache.slot_map_data.size());
+        slot_map.from   = static_cast<Slot>(from);
+        slot_map.size   = static_cast<Slot>(cache.slot_map.size());
+        cache.slot_map_data.insert(cache.slot_map_data.end(), cache.slot_map.begin(), cache.slot_map.end());
+        cache.slot_maps.push_back(slot_map);
+        edge.slot_map = static_cast<uint32_t>(cache.slot_maps.size());
+      }
+      if (!cleared)
+      {
+        cache.edges[state * symbol_count + symbol] = edge;
+        Dfa_state const& target = cache.states[edge.target];
+        if (symbol != end_symbol && edge.accept == no_accept && !target.dead)
+        {
+          uint32_t move = static_cast<uint32_t>(edge.target * symbol_count);
+          if (target.idle)
+            move |= idle_move;
+          if (edge.slot_map != 0)
+            move |= map_move;
+          cache.moves[state * symbol_count + symbol] = move;
+        }
+      }
+    }
+
+    if (edge.accept != no_accept)
+    {
+      result.outcome = Dfa_outcome::matched;
+      result.begin   = edge.accept == injected_slot ? position : starts[static_cast<size_t>(edge.accept)];
+      result.end     = position;
+    }
+    if (position == size)
+      return result;
+
+    starts[edge.injected] = position;
+    if (edge.slot_map != 0)
+      map_starts(cache.slot_maps[edge.slot_map - 1], cache.slot_map_data.data(), starts, position);
+
+    state = edge.target;
+    Dfa_state const& dfa_state = cache.states[state];
+    if (dfa_state.dead)
+      return result;
+    if (dfa_state.idle && skips)
+    {
+      size_t next = position + 1;
+      if (single)
+      {
+        void const* found = next < size ? std::memchr(first + next, _only_first_byte, size - next) : nullptr;
+        next = found ? static_cast<size_t>(static_cast<char const*>(found) - first) : size;
+      }
+      else
+      {
+        while (next < size && !_match_bounds.first_bytes[static_cast<unsigned char>(first[next])])
+          ++next;
+      }
+      skipped += next - position - 1;
+      if (++skip_tries >= min_skips && skipped < (single ? min_memchr_skip : min_lookup_skip) * skip_tries)
+        skips = false;
+      if (next > position + 1)
+      {
+        bool const prev_word = _word_assertions && _word_bytes[static_cast<unsigned char>(first[next - 1])];
+        if (prev_word != ((dfa_state.bits & prev_word_bit) != 0))
+          state = cache.empty_state(dfa_state.bits ^ prev_word_bit, _state_limit, cleared);
+        position = next - 1;
+      }
+    }
+  }
+}
@@ -0,0 +1,108 @@
+#ifndef LAZY_DFA_H
+#define LAZY_DFA_H
+
+#include <array>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <regex>
+#include <vector>
+
+#include <regex_analysis.h>
+#include <regex_nfa.h>
+
+// What a Lazy_dfa finds out about a text.
+enum class Dfa_outcome
+{
+  matched,    // The regex matches.
+  not_matched // It does not.
+};
+
+// Where std::regex_search finds its match: where the match starts and ends, relative to the
+// start of the text searched. The end of a POSIX regex's match is that of the longest match
+// that starts there, which is std::regex's if the Nfa finds the longest.
+struct Dfa_search
+{
+  Dfa_outcome outcome {Dfa_outcome::not_matched};
+  size_t      begin   {0};
+  size_t      end     {0};
+};
+
+// A Lazy_dfa runs an Nfa over a text a byte at a time, as a DFA whose states it builds only
+// when the text first leads to them, so each byte costs a table lookup once the states it
+// needs are built. A DFA state is the ordered list of Nfa states that the attempts std::regex
+// would still be making have reached, so the first attempt to succeed, and the match
+// std::regex's depth-first search of it finds first, are the ones std::regex finds, under
+// every match flag. Each Nfa state in the list keeps the position its attempt started at.
+//
+// An ECMAScript regex's first match is its match, so the Lazy_dfa finds where it starts and
+// ends. A POSIX regex's match starts where its first match does, and the Lazy_dfa goes on
+// past the first match to the last position that attempt's threads accept at, the end of
+// the longest match from there, which is where std::regex's ends if the Nfa finds the
+// longest.
+//
+// The DFA states are kept in caches of at most the state limit, or of about two million
+// states if that is less, which are emptied when they fill up. A Lazy_dfa is immutable but
+// for its caches, each of which is used by one search, or one Scanner, at a time, so one
+// may be shared between threads.
+class Lazy_dfa
+{
+  struct Cache;
+
+public:
+  static size_t const default_state_limit = 2048;
+
+  // A Scanner keeps one of a Lazy_dfa's caches for as long as it lives, so that the searches
+  // of one pass through a text neither lock nor take a cache each. It is used by one thread.
+  class Scanner
+  {
+  public:
+    explicit Scanner(Lazy_dfa const& lazy_dfa);
+    ~Scanner();
+
+    Scanner(Scanner const&)            = delete;
+    Scanner& operator=(Scanner const&) = delete;
+
+    // As Lazy_dfa::search and Lazy_dfa::match.
+    Dfa_search  search(char const* first, char const* last, std::regex_constants::match_flag_type flags);
+    Dfa_outcome match (char const* first, char const* last, std::regex_constants::match_flag_type flags);
+
+  private:
+    Lazy_dfa const&        _lazy_dfa;
+    std::unique_ptr<Cache> _cache {nullptr};
+  };
+
+  Lazy_dfa(Nfa nfa, Match_bounds const& match_bounds, size_t state_limit = default_state_limit);
+  ~Lazy_dfa();
+
+  Lazy_dfa(Lazy_dfa const&)            = delete;
+  Lazy_dfa& operator=(Lazy_dfa const&) = delete;
+
+  // Search [first, last) under the match flags, as std::regex_search does. Throw
+  // std::regex_error with error_complexity if the Nfa branches too widely at some position
+  // to follow, as std::regex does when its own search grows too complex.
+  Dfa_search search(char const* first, char const* last, std::regex_constants::match_flag_type flags) const;
+
+  // Match the whole of [first, last) under the match flags, as std::regex_match does, and
+  // throw as search does.
+  Dfa_outcome match(char const* first, char const* last, std::regex_constants::match_flag_type flags) const;
+
+private:
+  Dfa_search _run(Cache& cache, char const* first, char const* last, std::regex_constants::match_flag_type flags, bool exact) const;
+
+  std::unique_ptr<Cache> _take_cache() const;
+  void                   _return_cache(std::unique_ptr<Cache> cache) const;
+
+  Nfa                   _nfa                     {};
+  Match_bounds          _match_bounds            {};
+  size_t                _state_limit             {default_state_limit};
+  std::array<bool, 256> _word_bytes              {};      // The bytes \b takes as word characters.
+  bool                  _word_assertions         {false}; // Whether the Nfa has \b or \B.
+  bool                  _leading_word_assertions {false}; // Whether one may be reached before the first byte.
+  int                   _only_first_byte         {-1};    // The one byte a match can start with, if there is only one.
+
+  mutable std::mutex                          _cache_mutex {};
+  mutable std::vector<std::unique_ptr<Cache>> _caches      {};
+};
+
+#endif /* LAZY_DFA_H */
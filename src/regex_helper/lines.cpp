@@ -0,0 +1,30 @@
+#include <lines.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+size_t find_newline(std::string_view text, size_t position)
+{
+  char const* const begin   = text.data();
+  char const* const end     = begin + text.size();
+  char const*       current = begin + position;
+
+#if defined(__SSE2__)
+  __m128i const newlines = _mm_set1_epi8('\n');
+  for (; end - current >= 16; current += 16)
+  {
+    __m128i const block = _mm_loadu_si128(reinterpret_cast<__m128i const*>(current));
+    int const     mask  = _mm_movemask_epi8(_mm_cmpeq_epi8(block, newlines));
+    if (mask != 0)
+      return static_cast<size_t>(current - begin) + __builtin_ctz(mask);
+  }
+#endif
+
+  for (; current != end; ++current)
+  {
+    if (*current == '\n')
+      return static_cast<size_t>(current - begin);
+  }
+  return text.size();
+}
@@ -0,0 +1,14 @@
+#ifndef LINES_H
+#define LINES_H
+
+#include <string_view>
+
+// Helpers for treating a text as a sequence of newline-delimited lines. A line runs up to,
+// but not including, its '\n'. A '\n' at the very end of the text ends the last line
+// rather than starting an empty one.
+
+// Return the position of the first '\n' in [position, text.size()), or text.size() if
+// there is none. The scan compares 16 bytes at a time where SSE2 is available.
+size_t find_newline(std::string_view text, size_t position);
+
+#endif /* LINES_H */
@@ -0,0 +1,215 @@
+#include <literal_finder.h>
+
+#include <cstring>
+
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+namespace
+{
+  char fold_case(char character)
+  {
+    return character >= 'A' && character <= 'Z' ? static_cast<char>(character - 'A' + 'a') : character;
+  }
+
+  char other_case(char character)
+  {
+    return character >= 'a' && character <= 'z' ? static_cast<char>(character - 'a' + 'A') : character;
+  }
+
+  // The characters with a meaning of their own in any of the grammars, outside brackets.
+  bool is_special(char character)
+  {
+    return std::strchr("^$\\.*+?()[]{}|", character) != nullptr && character != '\0';
+  }
+
+  // Return the character that the escape of the character stands for, if it stands for one
+  // character in the grammar, or std::nullopt. Escapes that name classes, assertions or
+  // back-references, or that differ between implementations, are not taken.
+  std::optional<char> escaped_literal(char character, std::regex_constants::syntax_option_type syntax)
+  {
+    using namespace std::regex_constants;
+
+    if (syntax & (basic | grep))
+    {
+      if (std::strchr(".[*^$\\", character) != nullptr && character != '\0')
+        return character;
+      return std::nullopt;
+    }
+    if (syntax & (extended | egrep))
+    {
+      if (std::strchr(".[()*+?{|^$\\", character) != nullptr && character != '\0')
+        return character;
+      return std::nullopt;
+    }
+    if (syntax & awk)
+    {
+      if (std::strchr(".[()*+?{|^$\\\"/", character) != nullptr && character != '\0')
+        return character;
+      return std::nullopt;
+    }
+
+    switch (character)
+    {
+      case 'f': return '\f';
+      case 'n': return '\n';
+      case 'r': return '\r';
+      case 't': return '\t';
+      case 'v': return '\v';
+      default:
+        if (std::strchr("^$\\.*+?()[]{}|/", character) != nullptr && character != '\0')
+          return character;
+        return std::nullopt;
+    }
+  }
+}
+
+Literal_finder::Literal_finder(std::string literal, bool icase)
+: _literal (std::move(literal)),
+  _icase   (icase)
+{
+  if (_icase)
+  {
+    for (char& character : _literal)
+      character = fold_case(character);
+  }
+}
+
+// The first and last bytes of each candidate are compared at once for a block of starting
+// positions, with each case of a letter under icase; only where both agree is the rest of
+// the literal compared. The last block stops where a candidate would run past the text, and
+// the positions after it are tried one at a time.
+size_t Literal_finder::find(std::string_view text, size_t from) const
+{
+  size_t const length = _literal.size();
+  if (length == 0 || text.size() < length || from > text.size() - length)
+    return std::string_view::npos;
+
+  char const* const data       = text.data();
+  size_t const      last_start = text.size() - length;
+  size_t            i          = from;
+
+  char const first_lower = _literal.front();
+  char const first_upper = _icase ? other_case(first_lower) : first_lower;
+  char const last_lower  = _literal.back();
+  char const last_upper  = _icase ? other_case(last_lower) : last_lower;
+
+#if defined(__AVX2__)
+  __m256i const first_lower_32 = _mm256_set1_epi8(first_lower);
+  __m256i const first_upper_32 = _mm256_set1_epi8(first_upper);
+  __m256i const last_lower_32  = _mm256_set1_epi8(last_lower);
+  __m256i const last_upper_32  = _mm256_set1_epi8(last_upper);
+  for (; i + 32 <= last_start + 1; i += 32)
+  {
+    __m256i const first_block = _mm256_loadu_si256(reinterpret_cast<__m256i const*>(data + i));
+    __m256i const last_block  = _mm256_loadu_si256(reinterpret_cast<__m256i const*>(data + i + length - 1));
+    __m256i const candidates  = _mm256_and_si256(_mm256_or_si256(_mm256_cmpeq_epi8(first_block, first_lower_32),
+                                                                 _mm256_cmpeq_epi8(first_block, first_upper_32)),
+                                                 _mm256_or_si256(_mm256_cmpeq_epi8(last_block, last_lower_32),
+                                                                 _mm256_cmpeq_epi8(last_block, last_upper_32)));
+    for (unsigned int mask = static_cast<unsigned int>(_mm256_movemask_epi8(candidates)); mask != 0; mask &= mask - 1)
+    {
+      size_t const candidate = i + static_cast<size_t>(__builtin_ctz(mask));
+      if (_matches_at(data + candidate))
+        return candidate;
+    }
+  }
+#endif
+
+#if defined(__SSE2__)
+  __m128i const first_lower_16 = _mm_set1_epi8(first_lower);
+  __m128i const first_upper_16 = _mm_set1_epi8(first_upper);
+  __m128i const last_lower_16  = _mm_set1_epi8(last_lower);
+  __m128i const last_upper_16  = _mm_set1_epi8(last_upper);
+  for (; i + 16 <= last_start + 1; i += 16)
+  {
+    __m128i const first_block = _mm_loadu_si128(reinterpret_cast<__m128i const*>(data + i));
+    __m128i const last_block  = _mm_loadu_si128(reinterpret_cast<__m128i const*>(data + i + length - 1));
+    __m128i const candidates  = _mm_and_si128(_mm_or_si128(_mm_cmpeq_epi8(first_block, first_lower_16),
+                                                           _mm_cmpeq_epi8(first_block, first_upper_16)),
+                                              _mm_or_si128(_mm_cmpeq_epi8(last_block, last_lower_16),
+                                                           _mm_cmpeq_epi8(last_block, last_upper_16)));
+    for (unsigned int mask = static_cast<unsigned int>(_mm_movemask_epi8(candidates)); mask != 0; mask &= mask - 1)
+    {
+      size_t const candidate = i + static_cast<size_t>(__builtin_ctz(mask));
+      if (_matches_at(data + candidate))
+        return candidate;
+    }
+  }
+#endif
+
+  for (; i <= last_start; ++i)
+  {
+    if (!_icase)
+    {
+      auto const first = static_cast<char const*>(std::memchr(data + i, first_lower, last_start - i + 1));
+      if (!first)
+        return std::string_view::npos;
+      i = static_cast<size_t>(first - data);
+    }
+    if (_matches_at(data + i))
+      return i;
+  }
+  return std::string_view::npos;
+}
+
+bool Literal_finder::equals(std::string_view text) const
+{
+  return text.size() == _literal.size() && _matches_at(text.data());
+}
+
+bool Literal_finder::_matches_at(char const* first) const
+{
+  if (!_icase)
+    return std::memcmp(first, _literal.data(), _literal.size()) == 0;
+
+  for (size_t i = 0; i < _literal.size(); ++i)
+  {
+    if (fold_case(first[i]) != _literal[i])
+      return false;
+  }
+  return true;
+}
+
+// A regex without a grammar flag is ECMAScript. In grep and egrep, a newline separates
+// alternatives, so a regex holding one is no literal.
+std::optional<std::string> literal_of_regex(std::string_view regex, std::regex_constants::syntax_option_type syntax)
+{
+  using namespace std::regex_constants;
+
+  std::string literal;
+  for (size_t i = 0; i < regex.size(); ++i)
+  {
+    char const character = regex[i];
+    if (character == '\n' && (syntax & (grep | egrep)))
+      return std::nullopt;
+
+    if (character == '\\')
+    {
+      if (++i == regex.size())
+        return std::nullopt;
+      auto const escaped = escaped_literal(regex[i], syntax);
+      if (!escaped)
+        return std::nullopt;
+      literal += *escaped;
+    }
+    else if (is_special(character))
+      return std::nullopt;
+    else
+      literal += character;
+  }
+
+  if (literal.empty())
+    return std::nullopt;
+
+  if (syntax & icase)
+  {
+    for (char character : literal)
+    {
+      if (static_cast<unsigned char>(character) >= 0x80)
+        return std::nullopt;
+    }
+  }
+  return literal;
+}
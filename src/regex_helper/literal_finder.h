@@ -0,0 +1,45 @@
+#ifndef LITERAL_FINDER_H
+#define LITERAL_FINDER_H
+
+#include <optional>
+#include <regex>
+#include <string>
+#include <string_view>
+
+// A Literal_finder finds a literal string in text, as std::regex_search would find a regex
+// that is nothing but that literal, without std::regex. Candidates are found by comparing
+// the first and the last byte of the literal with 32 or 16 positions of the text at a time,
+// and only those are compared in full. With icase, ASCII letters match either case, as
+// they do for std::regex in the "C" locale.
+class Literal_finder
+{
+  std::string _literal {""}; // Lowercased, with icase.
+  bool        _icase   {false};
+
+public:
+  Literal_finder() = delete;
+  Literal_finder(std::string literal, bool icase);
+
+  std::string const& literal() const { return _literal; };
+  size_t             size()    const { return _literal.size(); };
+
+  // Return the position of the first occurrence of the literal that starts at or after the
+  // given position, or std::string_view::npos if there is none.
+  size_t find(std::string_view text, size_t from = 0) const;
+
+  // Whether the text is exactly the literal.
+  bool equals(std::string_view text) const;
+
+private:
+  bool _matches_at(char const* first) const;
+};
+
+// Return the text that the regex matches if, under the grammar of the syntax options, it is
+// a plain literal: not empty, and made only of characters that stand for themselves and of
+// escapes that do, such as "\." or "\n" in ECMAScript. Return std::nullopt for any other
+// regex, and for a literal that is not all ASCII under icase. The test is conservative: a
+// character that is special anywhere in the grammar is taken as special, so some literals
+// are turned down, but whatever is accepted matches exactly as std::regex would match it.
+std::optional<std::string> literal_of_regex(std::string_view regex, std::regex_constants::syntax_option_type syntax);
+
+#endif /* LITERAL_FINDER_H */
@@ -0,0 +1,177 @@
+#include <mapped_file.h>
+
+#include <cerrno>
+#include <system_error>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// Open the file and map or read it. The descriptor is closed as soon as the mapping exists,
+// since the mapping keeps the file alive by itself.
+Mapped_file::Mapped_file(std::string const& path, Access access)
+{
+  int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0)
+    throw std::system_error(errno, std::generic_category(), "cannot open " + path);
+
+  try
+  {
+    if (access == Access::map)
+      _map(fd, path);
+    else
+      _read_file(fd, path);
+  }
+  catch (...)
+  {
+    ::close(fd);
+    throw;
+  }
+  ::close(fd);
+}
+
+// The file is read with pread, which leaves alone the file offset the descriptor shares with
+// the caller's.
+Mapped_file::Mapped_file(int fd)
+{
+  std::string const name = "descriptor " + std::to_string(fd);
+
+  struct stat file_status;
+  if (::fstat(fd, &file_status) < 0)
+    throw std::system_error(errno, std::generic_category(), "cannot stat " + name);
+  if (!S_ISREG(file_status.st_mode))
+    throw std::system_error(EINVAL, std::generic_category(), name + " is not a regular file");
+
+  int const required_seals = F_SEAL_SHRINK | F_SEAL_WRITE;
+  int const seals          = ::fcntl(fd, F_GET_SEALS);
+  if (seals >= 0 && (seals & required_seals) == required_seals)
+    _map(fd, name);
+  else
+    _read_from_start(fd, static_cast<size_t>(file_status.st_size), name);
+}
+
+// Find the size of the open file and map the whole of it read-only. An empty file is
+// not mapped at all (mmap rejects zero-length mappings), and simply produces an empty view.
+// Any other kind of file reports a size of 0 whatever it holds, so it is read instead.
+void Mapped_file::_map(int fd, std::string const& name)
+{
+  struct stat file_status;
+  if (::fstat(fd, &file_status) < 0)
+    throw std::system_error(errno, std::generic_category(), "cannot stat " + name);
+  if (!S_ISREG(file_status.st_mode))
+  {
+    _read(fd, name);
+    return;
+  }
+
+  _length = static_cast<size_t>(file_status.st_size);
+  if (_length > 0)
+  {
+    // Reserve the page before the file along with the file's own, and map the file over all
+    // but that page.
+    size_t const lead   = static_cast<size_t>(::sysconf(_SC_PAGESIZE));
+    void* const  region = ::mmap(nullptr, lead + _length, PROT_READ, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (region == MAP_FAILED)
+    {
+      _length = 0;
+      throw std::system_error(errno, std::generic_category(), "cannot map " + name);
+    }
+    void* data = ::mmap(static_cast<char*>(region) + lead, _length, PROT_READ, MAP_PRIVATE | MAP_FIXED, fd, 0);
+    if (data == MAP_FAILED)
+    {
+      int const error = errno;
+      ::munmap(region, lead + _length);
+      _length = 0;
+      throw std::system_error(error, std::generic_category(), "cannot map " + name);
+    }
+    _data = data;
+    _lead = lead;
+
+    // The regex algorithms walk the text front to back, so let the kernel read ahead.
+    ::madvise(_data, _length, MADV_SEQUENTIAL);
+  }
+}
+
+// Read a regular file as far as the size it has now, and any other kind of file to its end.
+void Mapped_file::_read_file(int fd, std::string const& name)
+{
+  struct stat file_status;
+  if (::fstat(fd, &file_status) < 0)
+    throw std::system_error(errno, std::generic_category(), "cannot stat " + name);
+  if (S_ISREG(file_status.st_mode))
+    _read_from_start(fd, static_cast<size_t>(file_status.st_size), name);
+  else
+    _read(fd, name);
+}
+
+// Read the file to its end, retrying reads that are interrupted.
+void Mapped_file::_read(int fd, std::string const& name)
+{
+  size_t const block_size = 1 << 16;
+  for (;;)
+  {
+    size_t const size = _contents.size();
+    _contents.resize(size + block_size);
+    ssize_t const count = ::read(fd, &_contents[size], block_size);
+    if (count < 0 && errno == EINTR)
+    {
+      _contents.resize(size);
+      continue;
+    }
+    if (count < 0)
+    {
+      _contents.clear();
+      throw std::system_error(errno, std::generic_category(), "cannot read " + name);
+    }
+    _contents.resize(size + static_cast<size_t>(count));
+    if (count == 0)
+      return;
+  }
+}
+
+// Read the first size bytes of the file, or as many as it holds if it has shrunk since.
+void Mapped_file::_read_from_start(int fd, size_t size, std::string const& name)
+{
+  _contents.resize(size);
+  size_t offset = 0;
+  while (offset < size)
+  {
+    ssize_t const count = ::pread(fd, &_contents[offset], size - offset, static_cast<off_t>(offset));
+    if (count < 0 && errno == EINTR)
+      continue;
+    if (count < 0)
+    {
+      _contents.clear();
+      throw std::system_error(errno, std::generic_category(), "cannot read " + name);
+    }
+    if (count == 0)
+      break;
+    offset += static_cast<size_t>(count);
+  }
+  _contents.resize(offset);
+}
+
+Mapped_file::Mapped_file(Mapped_file&& other) noexcept
+: _data     (other._data),
+  _length   (other._length),
+  _lead     (other._lead),
+  _contents (std::move(other._contents))
+{
+  other._data   = nullptr;
+  other._length = 0;
+  other._lead   = 0;
+}
+
+Mapped_file::~Mapped_file()
+{
+  if (_data)
+    ::munmap(static_cast<char*>(_data) - _lead, _lead + _length);
+}
+
+std::string_view Mapped_file::view() const
+{
+  if (!_data)
+    return _contents;
+  return std::string_view(static_cast<char const*>(_data), _length);
+}
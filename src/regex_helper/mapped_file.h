@@ -0,0 +1,59 @@
+#ifndef MAPPED_FILE_H
+#define MAPPED_FILE_H
+
+#include <string>
+#include <string_view>
+
+// A Mapped_file maps a file read-only into memory for as long as the object lives, and
+// exposes the file contents as a std::string_view. This lets the regex algorithms run
+// directly over the bytes of a large file, without first copying them into a std::string.
+// Failure to open, stat, map or read the file is reported by throwing std::system_error. The
+// class only allows move construction, as it owns the mapping.
+//
+// A file that is not a regular file, such as a pipe, a FIFO or a terminal, has no size to map,
+// so it is read into memory to its end instead.
+//
+// Under match_prev_avail, std::regex reads the byte before the text, so a mapped file is
+// mapped after a page of its own, and the byte before the view reads as NUL.
+//
+// A Mapped_file may also be made from an open file descriptor, such as a memfd passed in by
+// another process. The descriptor stays owned by the caller, and may be closed as soon as
+// the constructor returns. That process may still shrink or write to the file, and a mapping
+// of a file that shrinks faults on the pages past its new end, so only a memfd sealed with
+// F_SEAL_SHRINK and F_SEAL_WRITE is mapped. Any other regular file is read into memory, and
+// a descriptor of anything but a regular file is refused. For the same reason, a file opened
+// from its path may be read into memory with Access::read rather than mapped, where another
+// process may well truncate it while it is searched.
+class Mapped_file
+{
+  void*       _data     {nullptr};
+  size_t      _length   {0};
+  size_t      _lead     {0};  // The length of the page mapped before the file.
+  std::string _contents {""}; // The contents of a file that is read rather than mapped.
+
+public:
+  // Whether a regular file opened from its path is mapped or read into memory.
+  enum class Access
+  {
+    map,
+    read
+  };
+
+  Mapped_file() = delete;
+  explicit Mapped_file(std::string const& path, Access access = Access::map);
+  explicit Mapped_file(int fd);
+  Mapped_file(Mapped_file&& other) noexcept;
+  Mapped_file(Mapped_file const&) = delete;
+  Mapped_file& operator=(Mapped_file const&) = delete;
+  ~Mapped_file();
+
+  std::string_view view() const;
+
+private:
+  void _map(int fd, std::string const& name);
+  void _read_file(int fd, std::string const& name);
+  void _read(int fd, std::string const& name);
+  void _read_from_start(int fd, size_t size, std::string const& name);
+};
+
+#endif /* MAPPED_FILE_H */
@@ -1,18 +1,29 @@
 #include <match.h>
 
-Submatch::Submatch(std::ssub_match const& submatch, size_t submatch_position)
-: _length   (submatch.length()),
-  _position (submatch_position),
-  _text     (submatch.str())
-{}
+// A group that took no part in the match has no text in the source to view.
+Submatch::Submatch(std::string_view submatch,
+                   size_t           submatch_position,
+                   Submatch_text    submatch_text)
+: _length   (submatch.size()),
+  _position (submatch_position)
+{
+  if (submatch_text == Submatch_text::viewed && submatch.data())
+    _first = submatch.data();
+  else
+    _text  = std::string(submatch);
+}
 
-Match::Match(std::smatch&& match, std::string&& format_string)
+Match::Match(Capture_spans  const& match,
+             Format_program const& format_program,
+             size_t                position_offset,
+             Submatch_text         submatch_text)
 {
-  _formatted_string        = match.format(format_string);
+  if (!format_program.empty())
+    format_program.run(match, _formatted_string);
   _match_successful        = !match.empty();
-  _max_possible_submatches = match.max_size();
+  _max_possible_submatches = Capture_spans::max_size();
   _submatch_count          = match.size();
 
   for (size_t i = 0; i < _submatch_count; ++i)
-    _submatches.push_back(Submatch(match[i], match.position(i)));
+    _submatches.push_back(Submatch(match.text(i), position_offset + match.position(i), submatch_text));
 }
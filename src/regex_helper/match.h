@@ -3,6 +3,21 @@
 
 #include <vector>
 #include <regex>
+#include <string_view>
+
+#include <capture_spans.h>
+#include <format_program.h>
+#include <document_writer.h>
+
+// Submatch_text selects how a Submatch holds its text. A copied Submatch owns a std::string
+// copy of it. A viewed Submatch only records where the text lies in the source, and reads it
+// from there when asked, which saves an allocation per capture group; whoever creates viewed
+// Submatches must keep the source alive and in place for as long as they are used.
+enum class Submatch_text
+{
+  copied,
+  viewed
+};
 
 // A Submatch describes a component of a Match. A Submatch occurs when the user,
 // in a matching regex, has specified a capture group with parentheses(). Each
@@ -10,29 +25,40 @@
 struct Submatch
 {
   Submatch() = delete;
-  Submatch(std::ssub_match const& submatch, size_t submatch_position);
+  Submatch(std::string_view submatch,
+           size_t           submatch_position,
+           Submatch_text    submatch_text = Submatch_text::copied);
 
-  friend std::ostream& operator<<(std::ostream& os, Submatch const& submatch);
+  friend void write_document(Document_writer& writer, Submatch const& submatch);
 
-  size_t             length()   const { return _length; }
-  size_t             position() const { return _position; }
-  std::string const& text()     const { return _text; }
+  size_t           length()   const { return _length; }
+  size_t           position() const { return _position; }
+  std::string_view text()     const { return _first ? std::string_view(_first, _length) : std::string_view(_text); }
 
 private:
   size_t      _length   {0};
   size_t      _position {0};
-  std::string _text     {""};
+  char const* _first    {nullptr}; // Start of the text in the source, for a viewed Submatch.
+  std::string _text     {""};      // Copy of the text, for a copied Submatch.
 };
 
 // A Match describes a possibly-sucessful std::regex function result. It is constructed
-// from a std::smatch, whose information is translated into Match format, and an optional
-// format std::string, which will be used on construction to generate the formatted string.
+// from the Capture_spans of a match, whose information is translated into Match format,
+// and an optional Format_program, which will be run on construction to generate the
+// formatted string.
+// The algorithms run over [char const*, char const*) ranges rather than std::string, so that
+// the same code serves text held in memory and text mapped from a file. The position offset
+// is added to every Submatch position, for matches found in a window of a larger text.
+// The Submatch_text is passed on to every Submatch.
 struct Match
 {
   Match() = default;
-  Match(std::smatch&& match, std::string&& format_string = "");
+  Match(Capture_spans  const& match,
+        Format_program const& format_program  = Format_program(),
+        size_t                position_offset = 0,
+        Submatch_text         submatch_text   = Submatch_text::copied);
 
-  friend std::ostream& operator<<(std::ostream& os, Match const& match);
+  friend void write_document(Document_writer& writer, Match const& match);
 
   std::string           const& formatted_string()        const { return _formatted_string; }
   bool                         match_successful()        const { return _match_successful; }
@@ -0,0 +1,97 @@
+#include <match_sink.h>
+#include <stream_insert_overloads.h>
+
+#include <algorithm>
+
+Match_vector_sink::Match_vector_sink(Format_program const& format_program, Submatch_text submatch_text)
+: _format_program (format_program),
+  _submatch_text  (submatch_text)
+{}
+
+// The vector grows as the matches come, rather than being sized by a walk over them first.
+bool Match_vector_sink::add(Capture_spans const& match, size_t position_offset)
+{
+  _matches.emplace_back(Match(match, _format_program, position_offset, _submatch_text));
+  return true;
+}
+
+Match_table_sink::Match_table_sink(std::string_view text, Format_program const& format_program)
+: _format_program (format_program),
+  _match_table    (text)
+{}
+
+bool Match_table_sink::add(Capture_spans const& match, size_t position_offset)
+{
+  _match_table.add(match, _format_program, position_offset);
+  return true;
+}
+
+Match_count_sink::Match_count_sink(bool count_groups)
+: _count_groups (count_groups)
+{}
+
+bool Match_count_sink::add(Capture_spans const& match, size_t)
+{
+  ++_match_count;
+  if (_count_groups)
+  {
+    _group_counts.resize(std::max(_group_counts.size(), match.size()));
+    for (size_t i = 0; i < match.size(); ++i)
+      _group_counts[i] += match.matched(i) ? 1 : 0;
+  }
+  return true;
+}
+
+Match_limit_sink::Match_limit_sink(Match_sink& sink, size_t max_matches)
+: _sink        (sink),
+  _max_matches (max_matches)
+{}
+
+bool Match_limit_sink::add(Capture_spans const& match, size_t position_offset)
+{
+  ++_match_count;
+  _stopped = !_sink.add(match, position_offset) || limit_reached();
+  return !_stopped;
+}
+
+Match_callback_sink::Match_callback_sink(std::function<bool(Capture_spans const&, size_t)> callback)
+: _callback (std::move(callback))
+{}
+
+bool Match_callback_sink::add(Capture_spans const& match, size_t position_offset)
+{
+  return _callback(match, position_offset);
+}
+
+Json_match_sink::Json_match_sink(Json_writer& writer, Format_program const& format_program)
+: _writer         (writer),
+  _format_program (format_program)
+{}
+
+bool Json_match_sink::add(Capture_spans const& match, size_t position_offset)
+{
+  _formatted_string.clear();
+  _format_program.run(match, _formatted_string);
+  write_document(_writer, match, _formatted_string, position_offset);
+  ++_match_count;
+  return true;
+}
+
+Ndjson_match_sink::Ndjson_match_sink(Json_writer& writer, Format_program const& format_program)
+: Json_match_sink (writer, format_program),
+  _writer         (writer)
+{}
+
+bool Ndjson_match_sink::add(Capture_spans const& match, size_t position_offset)
+{
+  Json_match_sink::add(match, position_offset);
+  _writer.newline();
+
+  auto const now = std::chrono::steady_clock::now();
+  if (match_count() == 1 || now - _last_flush >= flush_interval)
+  {
+    _writer.flush();
+    _last_flush = now;
+  }
+  return true;
+}
@@ -0,0 +1,149 @@
+#ifndef MATCH_SINK_H
+#define MATCH_SINK_H
+
+#include <chrono>
+#include <functional>
+#include <regex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <capture_spans.h>
+#include <format_program.h>
+#include <json_writer.h>
+#include <match.h>
+#include <match_table.h>
+
+// A Match_sink receives the matches of a search one at a time, in text order, as the search
+// finds them, so that a search walks the text once whatever is done with its matches. The
+// positions in the Capture_spans are relative to the start of the range searched; the
+// position offset gives the position of that start in the whole text. add() returns whether
+// the search should go on, so that a sink may end it early. A sink that formats the matches
+// runs a Format_program, which must outlive the sink.
+//
+// A sink that only looks at where each match lies says so with groups_needed(), and is then
+// given only the whole match, which spares the search finding the groups.
+class Match_sink
+{
+public:
+  virtual ~Match_sink() = default;
+
+  virtual bool add(Capture_spans const& match, size_t position_offset) = 0;
+
+  virtual bool groups_needed() const { return true; };
+};
+
+// Construct a Match from each match, formatted by the Format_program, and keep them in order.
+class Match_vector_sink : public Match_sink
+{
+  Format_program const& _format_program;
+  Submatch_text         _submatch_text {Submatch_text::copied};
+  std::vector<Match>    _matches       {};
+
+public:
+  Match_vector_sink(Format_program const& format_program, Submatch_text submatch_text = Submatch_text::copied);
+
+  bool add(Capture_spans const& match, size_t position_offset) override;
+
+  std::vector<Match>& matches() { return _matches; };
+};
+
+// Add each match as a row of a Match_table, formatted by the Format_program.
+class Match_table_sink : public Match_sink
+{
+  Format_program const& _format_program;
+  Match_table           _match_table {};
+
+public:
+  Match_table_sink(std::string_view text, Format_program const& format_program);
+
+  bool add(Capture_spans const& match, size_t position_offset) override;
+
+  Match_table& match_table() { return _match_table; };
+};
+
+// Only count the matches and, if asked to, the matches in which each group took part.
+class Match_count_sink : public Match_sink
+{
+  bool                _count_groups {false};
+  size_t              _match_count  {0};
+  std::vector<size_t> _group_counts {};
+
+public:
+  explicit Match_count_sink(bool count_groups = false);
+
+  bool add(Capture_spans const& match, size_t position_offset) override;
+  bool groups_needed() const override { return _count_groups; };
+
+  size_t               match_count()  const { return _match_count;  };
+  std::vector<size_t>& group_counts()       { return _group_counts; };
+};
+
+// Pass each match on to another sink until max_matches of them have been passed on, and then
+// end the search. A max_matches of 0 sets no limit. stopped() tells whether the search was
+// ended, by the limit or by the other sink, so that a caller running several searches in
+// turn knows not to start the next.
+class Match_limit_sink : public Match_sink
+{
+  Match_sink& _sink;
+  size_t      _max_matches {0};
+  size_t      _match_count {0};
+  bool        _stopped     {false};
+
+public:
+  Match_limit_sink(Match_sink& sink, size_t max_matches);
+
+  bool add(Capture_spans const& match, size_t position_offset) override;
+  bool groups_needed() const override { return _sink.groups_needed(); };
+
+  bool limit_reached() const { return _max_matches > 0 && _match_count >= _max_matches; };
+  bool stopped()       const { return _stopped; };
+};
+
+// Call a function with each match, which returns whether the search should go on.
+class Match_callback_sink : public Match_sink
+{
+  std::function<bool(Capture_spans const&, size_t)> _callback;
+
+public:
+  explicit Match_callback_sink(std::function<bool(Capture_spans const&, size_t)> callback);
+
+  bool add(Capture_spans const& match, size_t position_offset) override;
+};
+
+// Write each match through the Json_writer as soon as it is found, in the JSON form of a
+// Match, as the next element of the array the writer is in.
+class Json_match_sink : public Match_sink
+{
+  Json_writer&          _writer;
+  Format_program const& _format_program;
+  std::string           _formatted_string {""};
+  size_t                _match_count      {0};
+
+public:
+  Json_match_sink(Json_writer& writer, Format_program const& format_program);
+
+  bool add(Capture_spans const& match, size_t position_offset) override;
+
+  size_t match_count() const { return _match_count; };
+};
+
+// Write each match through the Json_writer as soon as it is found, in the JSON form of a
+// Match, on a line of its own (newline-delimited JSON). The writer is flushed with the first
+// match, and after that with any match that comes flush_interval or more after the last
+// flush, so that a reader gets a match far from the last one without delay, while a dense run
+// of matches is still written a buffer at a time.
+class Ndjson_match_sink : public Json_match_sink
+{
+  Json_writer&                          _writer;
+  std::chrono::steady_clock::time_point _last_flush {};
+
+public:
+  static constexpr std::chrono::milliseconds flush_interval {50};
+
+  Ndjson_match_sink(Json_writer& writer, Format_program const& format_program);
+
+  bool add(Capture_spans const& match, size_t position_offset) override;
+};
+
+#endif /* MATCH_SINK_H */
@@ -0,0 +1,38 @@
+#include <match_table.h>
+
+Match_table::Match_table(std::string_view text)
+: _text (text)
+{}
+
+// Every match of one regex has the same number of groups, so the first row fixes the stride.
+void Match_table::add(Capture_spans const& match, Format_program const& format_program, size_t position_offset)
+{
+  if (_formatted_ends.empty())
+  {
+    _group_count             = match.size();
+    _max_possible_submatches = Capture_spans::max_size();
+  }
+
+  for (size_t i = 0; i < _group_count; ++i)
+  {
+    _positions.push_back(position_offset + match.position(i));
+    _lengths.push_back(match.matched(i) ? match.length(i) : unmatched);
+  }
+
+  if (!format_program.empty())
+    format_program.run(match, _formatted_strings);
+  _formatted_ends.push_back(_formatted_strings.size());
+}
+
+std::string_view Match_table::text(size_t row, size_t group) const
+{
+  if (!matched(row, group))
+    return {};
+  return _text.substr(position(row, group), length(row, group));
+}
+
+std::string_view Match_table::formatted_string(size_t row) const
+{
+  size_t const begin = row > 0 ? _formatted_ends[row - 1] : 0;
+  return std::string_view(_formatted_strings).substr(begin, _formatted_ends[row] - begin);
+}
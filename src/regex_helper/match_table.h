@@ -0,0 +1,59 @@
+#ifndef MATCH_TABLE_H
+#define MATCH_TABLE_H
+
+#include <regex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <capture_spans.h>
+#include <format_program.h>
+
+// A Match_table holds the matches of a search in columns, rather than as a std::vector of
+// Matches that each own a std::vector of Submatches and a formatted std::string. Each match
+// is a row of group_count groups, the first being the whole match and the rest the capture
+// groups. The positions and lengths of every group of every row lie in two flat arrays,
+// indexed by row * group_count + group, and the formatted strings of all rows lie end to end
+// in one std::string. So a table of any size takes a handful of allocations, and a scan over
+// a column runs through contiguous memory.
+//
+// The table never copies matched text; text() reads it from the searched text, which must
+// outlive the table. A group that did not participate in its match has a length of
+// Match_table::unmatched, and length() reports it as 0, as a Submatch does.
+class Match_table
+{
+  std::string_view    _text                    {};
+  size_t              _group_count             {0};
+  size_t              _max_possible_submatches {0};
+  std::vector<size_t> _positions               {}; // [row * group_count + group]
+  std::vector<size_t> _lengths                 {}; // [row * group_count + group]
+  std::string         _formatted_strings       {}; // Every row's formatted string, end to end.
+  std::vector<size_t> _formatted_ends          {}; // [row], the end of its formatted string.
+
+public:
+  static constexpr size_t unmatched = static_cast<size_t>(-1);
+
+  Match_table() = default;
+  explicit Match_table(std::string_view text);
+
+  // Append a row for the match, formatted by the Format_program. The position offset is
+  // added to the match positions, for a match found in a window of the text.
+  void add(Capture_spans const& match, Format_program const& format_program, size_t position_offset = 0);
+
+  size_t match_count()             const { return _formatted_ends.size();   };
+  size_t group_count()             const { return _group_count;             };
+  size_t max_possible_submatches() const { return _max_possible_submatches; };
+
+  size_t position(size_t row, size_t group = 0) const { return _positions[row * _group_count + group]; };
+  bool   matched (size_t row, size_t group = 0) const { return _lengths[row * _group_count + group] != unmatched; };
+  size_t length  (size_t row, size_t group = 0) const { return matched(row, group) ? _lengths[row * _group_count + group] : 0; };
+
+  std::string_view text            (size_t row, size_t group = 0) const;
+  std::string_view formatted_string(size_t row)                   const;
+
+  // The flat columns, for scans over every group of every row.
+  std::vector<size_t> const& positions() const { return _positions; };
+  std::vector<size_t> const& lengths()   const { return _lengths;   };
+};
+
+#endif /* MATCH_TABLE_H */
@@ -0,0 +1,341 @@
+#include <pike_vm.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <set>
+
+namespace
+{
+  // The most Nfa states one closure may visit before the run fails as std::regex fails when
+  // its own search grows too complex, as for a Lazy_dfa.
+  size_t const closure_budget = 1 << 20;
+
+  // A thread is a characters state that the attempt has reached, with the index of its
+  // captures among those of the other threads.
+  struct Thread
+  {
+    size_t state;
+    size_t captures;
+  };
+}
+
+// What a run of a Pike_vm needs, kept from one run to the next. The closure follows the
+// threads to the characters states they reach before the next byte in the order std::regex's
+// depth-first search does, entering a repetition at most twice at one position, and setting
+// and restoring the captures along the way as std::regex does. The first thread to reach the
+// accept state ends the closure: std::regex only goes on to the threads after it if it fails.
+// Any other state reached again is left out, as a Lazy_dfa's closure leaves it out, since
+// the path that reached it first comes first, and the captures along the way do not change
+// where it goes on to.
+class Pike_vm::Run
+{
+public:
+  Run(Nfa const& nfa, std::array<bool, 256> const& word_bytes)
+  : _nfa        (nfa),
+    _word_bytes (word_bytes),
+    _width      (2 * (nfa.group_count + 1)),
+    _seen       (nfa.states.size(), 0),
+    _visited    (nfa.states.size(), 0),
+    _entries    (nfa.states.size(), 0)
+  {}
+
+  // Under match_prev_avail, std::regex ignores match_not_bol and match_not_bow.
+  Dfa_outcome operator()(char const* first, char const* last, size_t end, std::regex_constants::match_flag_type flags, bool exact, std::vector<size_t>& captures)
+  {
+    using namespace std::regex_constants;
+
+    _first      = first;
+    _size       = static_cast<size_t>(last - first);
+    _exact      = exact;
+    _prev_avail = (flags & match_prev_avail) != 0;
+    _bol        = !_prev_avail && !(flags & match_not_bol);
+    _not_bow    = !_prev_avail && (flags & match_not_bow);
+    _not_eol    = (flags & match_not_eol) != 0;
+    _not_eow    = (flags & match_not_eow) != 0;
+    _not_null   = (flags & match_not_null) != 0;
+    _overflow   = false;
+    _matched    = false;
+    _position   = 0;
+
+    _path.assign(_width, no_position);
+    _path[0] = 0;
+    _threads.clear();
+    _visit_all(true);
+    while (!_overflow && _position < end && !_items.empty())
+    {
+      _step();
+      ++_position;
+      if (_threads.empty())
+        break;
+      _visit_all(false);
+    }
+
+    if (_overflow)
+      throw std::regex_error(std::regex_constants::error_complexity);
+    if (!_matched)
+      return Dfa_outcome::not_matched;
+    captures = _match;
+    return Dfa_outcome::matched;
+  }
+
+private:
+  // Follow the threads, and the attempt itself at the start, to the characters states they
+  // reach at the current position.
+  void _visit_all(bool at_start)
+  {
+    if (++_generation == 0)
+    {
+      std::fill(_seen.begin(), _seen.end(), 0);
+      std::fill(_visited.begin(), _visited.end(), 0);
+      _generation = 1;
+    }
+    _cycle_visits.clear();
+    _items.clear();
+    _item_captures.clear();
+    _stopped   = false;
+    _steps     = 0;
+    _at_end    = _position == _size;
+    _next_word = !_at_end && _word_bytes[static_cast<unsigned char>(_first[_position])];
+
+    if (at_start)
+      _visit(_nfa.start);
+    for (auto const& thread : _threads)
+    {
+      if (_stopped)
+        break;
+      _path.assign(_thread_captures.begin() + static_cast<std::ptrdiff_t>(thread.captures),
+                   _thread_captures.begin() + static_cast<std::ptrdiff_t>(thread.captures + _width));
+      _visit(thread.state);
+    }
+  }
+
+  // Move the threads that consume the byte at the current position on to the states that
+  // follow them, each reached first by the one of them that comes first.
+  void _step()
+  {
+    if (++_generation == 0)
+    {
+      std::fill(_seen.begin(), _seen.end(), 0);
+      std::fill(_visited.begin(), _visited.end(), 0);
+      _generation = 1;
+    }
+    size_t const symbol = static_cast<unsigned char>(_first[_position]);
+    _threads.clear();
+    _thread_captures.clear();
+    for (size_t item = 0; item < _items.size(); ++item)
+    {
+      Nfa_state const& state = _nfa.states[_items[item]];
+      if (!state.characters[symbol] || _seen[state.next] == _generation)
+        continue;
+      _seen[state.next] = _generation;
+      _threads.push_back(Thread{state.next, _thread_captures.size()});
+      _thread_captures.insert(_thread_captures.end(),
+                              _item_captures.begin() + static_cast<std::ptrdiff_t>(item * _width),
+                              _item_captures.begin() + static_cast<std::ptrdiff_t>((item + 1) * _width));
+    }
+  }
+
+  void _visit(size_t state_index)
+  {
+    if (_stopped)
+      return;
+    if (++_steps > closure_budget)
+    {
+      _overflow = _stopped = true;
+      return;
+    }
+
+    Nfa_state const& state = _nfa.states[state_index];
+    if (state.kind != Nfa_state_kind::characters && state.kind != Nfa_state_kind::accept && !_first_visit(state_index))
+      return;
+
+    switch (state.kind)
+    {
+      case Nfa_state_kind::characters:
+        if (!_at_end && _seen[state_index] != _generation)
+        {
+          _seen[state_index] = _generation;
+          _items.push_back(state_index);
+          _item_captures.insert(_item_captures.end(), _path.begin(), _path.end());
+        }
+        return;
+
+      case Nfa_state_kind::accept:
+        if ((_position == 0 && _not_null) || (_exact && !_at_end))
+          return;
+        _match    = _path;
+        _match[1] = _position;
+        _matched  = true;
+        _stopped  = true;
+        return;
+
+      case Nfa_state_kind::alternation:
+        for (size_t alternative : state.alternatives)
+        {
+          _visit(alternative);
+          if (_stopped)
+            return;
+        }
+        return;
+
+      case Nfa_state_kind::repetition:
+        if (state.greedy)
+        {
+          _once_more(state_index);
+          _visit(state.next);
+        }
+        else
+        {
+          _visit(state.next);
+          _once_more(state_index);
+        }
+        return;
+
+      case Nfa_state_kind::group_begin:
+      case Nfa_state_kind::group_end:
+      {
+        size_t&      capture = _path[2 * state.group + (state.kind == Nfa_state_kind::group_end ? 1 : 0)];
+        size_t const old     = capture;
+        capture = _position;
+        _visit(state.next);
+        capture = old;
+        return;
+      }
+
+      case Nfa_state_kind::assertion:
+      default:
+        if (_holds(state.assertion))
+          _visit(state.next);
+        return;
+    }
+  }
+
+  void _once_more(size_t state_index)
+  {
+    uint8_t& entries = _entries[state_index];
+    if (entries >= 2)
+      return;
+    bool const on_cycle = _nfa.states[state_index].cycle != Nfa_state::no_cycle;
+    ++entries;
+    if (on_cycle)
+      _entered.push_back(state_index);
+    _visit(_nfa.states[state_index].body);
+    if (on_cycle)
+      _entered.pop_back();
+    --entries;
+  }
+
+  // Whether the state has not been reached before at the position with the repetitions on
+  // its empty cycle entered as often as they are now, and mark it reached.
+  bool _first_visit(size_t state_index)
+  {
+    size_t const cycle = _nfa.states[state_index].cycle;
+    if (cycle == Nfa_state::no_cycle)
+    {
+      if (_visited[state_index] == _generation)
+        return false;
+      _visited[state_index] = _generation;
+      return true;
+    }
+
+    _key.assign({state_index});
+    for (size_t repetition : _entered)
+    {
+      if (_nfa.states[repetition].cycle == cycle)
+        _key.push_back(repetition);
+    }
+    std::sort(_key.begin() + 1, _key.end());
+    return _cycle_visits.insert(_key).second;
+  }
+
+  // ^ only holds at the start of the text, as the regex is not multiline.
+  bool _holds(Regex_assertion assertion) const
+  {
+    switch (assertion)
+    {
+      case Regex_assertion::line_begin:
+        return _position == 0 && _bol;
+      case Regex_assertion::line_end:
+        return _at_end && !_not_eol;
+      case Regex_assertion::word_boundary:
+        return _word_boundary();
+      case Regex_assertion::not_word_boundary:
+      default:
+        return !_word_boundary();
+    }
+  }
+
+  // The byte before the text is only looked at under match_prev_avail, and only here, as
+  // std::regex looks at it.
+  bool _word_boundary() const
+  {
+    if (_position == 0 && _not_bow)
+      return false;
+    if (_at_end && _not_eow)
+      return false;
+    bool const prev_word = (_position > 0 || _prev_avail) && _word_bytes[static_cast<unsigned char>(_first[static_cast<std::ptrdiff_t>(_position) - 1])];
+    return prev_word != _next_word;
+  }
+
+  Nfa const&                    _nfa;
+  std::array<bool, 256> const&  _word_bytes;
+  size_t                        _width;
+  std::vector<uint32_t>         _seen            {};
+  std::vector<uint32_t>         _visited         {};
+  std::vector<uint8_t>          _entries         {};
+  std::vector<size_t>           _entered         {}; // The repetitions on empty cycles entered at the position, once for each time.
+  std::set<std::vector<size_t>> _cycle_visits    {}; // The states on empty cycles reached, with the repetitions on them entered.
+  std::vector<size_t>           _key             {};
+  uint32_t                      _generation      {0};
+  char const*                   _first           {nullptr};
+  size_t                        _size            {0};
+  bool                          _exact           {false};
+  bool                          _prev_avail      {false};
+  bool                          _bol             {false};
+  bool                          _not_bow         {false};
+  bool                          _not_eol         {false};
+  bool                          _not_eow         {false};
+  bool                          _not_null        {false};
+  size_t                        _position        {0};
+  std::vector<size_t>           _path            {}; // The captures of the path being followed.
+  std::vector<size_t>           _items           {}; // The characters states reached at the position, in order.
+  std::vector<size_t>           _item_captures   {};
+  std::vector<Thread>           _threads         {}; // The threads that go on past the position, in order.
+  std::vector<size_t>           _thread_captures {};
+  std::vector<size_t>           _match           {}; // The captures of the match found so far, if any.
+  bool                          _matched         {false};
+  bool                          _stopped         {false};
+  bool                          _overflow        {false};
+  size_t                        _steps           {0};
+  bool                          _at_end          {false};
+  bool                          _next_word       {false};
+};
+
+Pike_vm::Pike_vm(Nfa nfa)
+: _nfa        (std::move(nfa)),
+  _word_bytes (word_bytes())
+{
+}
+
+Pike_vm::~Pike_vm() = default;
+
+Dfa_outcome Pike_vm::run(char const* first, char const* last, size_t end, std::regex_constants::match_flag_type flags, bool exact, std::vector<size_t>& captures) const
+{
+  std::unique_ptr<Run> run;
+  {
+    std::lock_guard<std::mutex> lock(_run_mutex);
+    if (!_runs.empty())
+    {
+      run = std::move(_runs.back());
+      _runs.pop_back();
+    }
+  }
+  if (!run)
+    run = std::make_unique<Run>(_nfa, _word_bytes);
+
+  Dfa_outcome const outcome = (*run)(first, last, end, flags, exact, captures);
+
+  std::lock_guard<std::mutex> lock(_run_mutex);
+  _runs.push_back(std::move(run));
+  return outcome;
+}
@@ -0,0 +1,58 @@
+#ifndef PIKE_VM_H
+#define PIKE_VM_H
+
+#include <array>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <regex>
+#include <vector>
+
+#include <lazy_dfa.h>
+#include <regex_nfa.h>
+
+// A Pike_vm runs an ECMAScript Nfa over a text a byte at a time, keeping each thread of the
+// attempt with the positions its groups captured, so it finds the groups of a match in time
+// proportional to the length of the text times the number of Nfa states, whatever the regex.
+// Its threads are kept in the order std::regex's depth-first search reaches them, and a
+// thread that reaches an Nfa state another has already reached is dropped, as it can only
+// do what the first does, and std::regex would only get to it if the first failed. So the
+// groups are those that std::regex captures, including those a repetition leaves from an
+// earlier time round.
+//
+// A Pike_vm is immutable but for the buffers its runs keep for the next, each of which is
+// used by one run at a time, so one may be shared between threads.
+class Pike_vm
+{
+public:
+  // The position of a group's start or end when it took no part in the match.
+  static constexpr size_t no_position = static_cast<size_t>(-1);
+
+  explicit Pike_vm(Nfa nfa);
+  ~Pike_vm();
+
+  Pike_vm(Pike_vm const&)            = delete;
+  Pike_vm& operator=(Pike_vm const&) = delete;
+
+  // The number of captures run fills in: the start and end of the whole match, and of each
+  // group in turn.
+  size_t capture_count() const { return 2 * (_nfa.group_count + 1); };
+
+  // Make the one attempt std::regex_search makes at the start of [first, last) under the
+  // match flags and match_continuous, or std::regex_match if exact, as far as the position
+  // its match ends at, and fill in the captures of the match, relative to first. The match
+  // must end at that position, as a Lazy_dfa finds it to. Throw std::regex_error with
+  // error_complexity if the Nfa branches too widely at some position to follow.
+  Dfa_outcome run(char const* first, char const* last, size_t end, std::regex_constants::match_flag_type flags, bool exact, std::vector<size_t>& captures) const;
+
+private:
+  class Run;
+
+  Nfa                   _nfa        {};
+  std::array<bool, 256> _word_bytes {}; // The bytes \b takes as word characters.
+
+  mutable std::mutex                        _run_mutex {};
+  mutable std::vector<std::unique_ptr<Run>> _runs      {};
+};
+
+#endif /* PIKE_VM_H */
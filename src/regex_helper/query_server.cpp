@@ -0,0 +1,261 @@
+#include <query_server.h>
+#include <json.hpp>
+#include <json_query.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <system_error>
+#include <thread>
+
+#include <arpa/inet.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace
+{
+  // Read exactly length bytes, retrying short reads. Return false at end of stream or error.
+  bool read_fully(int fd, char* data, size_t length)
+  {
+    while (length > 0)
+    {
+      ssize_t count = ::recv(fd, data, length, 0);
+      if (count < 0 && errno == EINTR)
+        continue;
+      if (count <= 0)
+        return false;
+      data   += count;
+      length -= static_cast<size_t>(count);
+    }
+    return true;
+  }
+
+  // Write exactly length bytes, retrying short writes. Return false on error.
+  bool write_fully(int fd, char const* data, size_t length)
+  {
+    while (length > 0)
+    {
+      ssize_t count = ::send(fd, data, length, MSG_NOSIGNAL);
+      if (count < 0 && errno == EINTR)
+        continue;
+      if (count <= 0)
+        return false;
+      data   += count;
+      length -= static_cast<size_t>(count);
+    }
+    return true;
+  }
+
+  // Read the first bytes of a frame with recvmsg, so as to receive a file descriptor sent
+  // with them. Any descriptors beyond the first are closed.
+  bool read_fully_with_descriptor(int fd, char* data, size_t length, int& passed_fd)
+  {
+    alignas(cmsghdr) char control[CMSG_SPACE(sizeof(int) * 4)];
+
+    iovec  io      {data, length};
+    msghdr message {};
+    message.msg_iov        = &io;
+    message.msg_iovlen     = 1;
+    message.msg_control    = control;
+    message.msg_controllen = sizeof(control);
+
+    ssize_t count;
+    do
+      count = ::recvmsg(fd, &message, MSG_CMSG_CLOEXEC);
+    while (count < 0 && errno == EINTR);
+
+    for (cmsghdr* header = CMSG_FIRSTHDR(&message); header; header = CMSG_NXTHDR(&message, header))
+    {
+      if (header->cmsg_level != SOL_SOCKET || header->cmsg_type != SCM_RIGHTS)
+        continue;
+
+      size_t const fd_count = (header->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+      for (size_t i = 0; i < fd_count; ++i)
+      {
+        int received_fd;
+        std::memcpy(&received_fd, CMSG_DATA(header) + i * sizeof(int), sizeof(int));
+        if (passed_fd < 0)
+          passed_fd = received_fd;
+        else
+          ::close(received_fd);
+      }
+    }
+
+    if (count <= 0)
+      return false;
+    return read_fully(fd, data + count, length - static_cast<size_t>(count));
+  }
+
+  enum class Frame_status
+  {
+    received,  // A whole frame was read.
+    closed,    // The stream ended or failed before a whole frame was read.
+    too_large  // The frame's length is over the limit, and its contents were not read.
+  };
+
+  // Read a frame of at most max_frame_size bytes, and the descriptor sent with it if there
+  // is one (or -1 if not). The frame grows a block at a time as its bytes arrive, rather than
+  // to the length its header claims, so a client must send the bytes it has the server hold.
+  Frame_status read_frame(int fd, std::string& frame, int& passed_fd, size_t max_frame_size)
+  {
+    size_t const block_size = size_t(1) << 16;
+
+    passed_fd = -1;
+
+    uint32_t network_length;
+    if (!read_fully_with_descriptor(fd, reinterpret_cast<char*>(&network_length), sizeof(network_length), passed_fd))
+      return Frame_status::closed;
+
+    size_t const length = ntohl(network_length);
+    if (length > max_frame_size)
+      return Frame_status::too_large;
+
+    frame.clear();
+    while (frame.size() < length)
+    {
+      size_t const received = frame.size();
+      frame.resize(received + std::min(block_size, length - received));
+      if (!read_fully(fd, frame.data() + received, frame.size() - received))
+        return Frame_status::closed;
+    }
+    return Frame_status::received;
+  }
+
+  bool write_frame(int fd, std::string const& frame)
+  {
+    uint32_t const network_length = htonl(static_cast<uint32_t>(frame.size()));
+    return write_fully(fd, reinterpret_cast<char const*>(&network_length), sizeof(network_length)) &&
+           write_fully(fd, frame.data(), frame.size());
+  }
+}
+
+Query_server::Query_server(std::string const& socket_path,
+                           Server_options     server_options,
+                           size_t             thread_count)
+: _socket_path    (socket_path),
+  _server_options (server_options),
+  _pool           (thread_count)
+{
+  sockaddr_un address {};
+  address.sun_family = AF_UNIX;
+  if (socket_path.size() >= sizeof(address.sun_path))
+    throw std::system_error(ENAMETOOLONG, std::generic_category(), "socket path too long: " + socket_path);
+  std::memcpy(address.sun_path, socket_path.c_str(), socket_path.size() + 1);
+
+  _listen_fd = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  if (_listen_fd < 0)
+    throw std::system_error(errno, std::generic_category(), "cannot create socket");
+
+  ::unlink(socket_path.c_str());
+  if (::bind(_listen_fd, reinterpret_cast<sockaddr const*>(&address), sizeof(address)) < 0 ||
+      ::listen(_listen_fd, SOMAXCONN) < 0)
+  {
+    int error = errno;
+    ::close(_listen_fd);
+    throw std::system_error(error, std::generic_category(), "cannot listen on " + socket_path);
+  }
+}
+
+// Shut down the open connections and wait for their threads, which use the pool and the
+// connection members, to finish before those are destroyed.
+Query_server::~Query_server()
+{
+  {
+    std::unique_lock<std::mutex> lock(_connection_mutex);
+    for (auto const& connection : _connections)
+      ::shutdown(connection.first, SHUT_RDWR);
+    _connection_freed.wait(lock, [this] { return _connections.empty(); });
+  }
+  _join_finished_connections();
+
+  ::close(_listen_fd);
+  ::unlink(_socket_path.c_str());
+}
+
+// Give each connection its own thread. A connection lasts as long as its client keeps it
+// open, and is only accepted once there is room for it among those being served. A thread
+// closes its connection and hands itself over to be joined under _connection_mutex, so that
+// the descriptor is never shut down after it is closed, and the thread is in _connections
+// before it can leave it.
+void Query_server::serve()
+{
+  while (true)
+  {
+    {
+      std::unique_lock<std::mutex> lock(_connection_mutex);
+      _connection_freed.wait(lock, [this] { return _connections.size() < _server_options.max_connections; });
+    }
+    _join_finished_connections();
+
+    int connection_fd = ::accept4(_listen_fd, nullptr, nullptr, SOCK_CLOEXEC);
+    if (connection_fd < 0)
+    {
+      if (errno == EINTR || errno == ECONNABORTED)
+        continue;
+      throw std::system_error(errno, std::generic_category(), "cannot accept on " + _socket_path);
+    }
+
+    std::lock_guard<std::mutex> lock(_connection_mutex);
+    _connections.emplace(connection_fd, std::thread([this, connection_fd]
+    {
+      _serve_connection(connection_fd);
+
+      std::lock_guard<std::mutex> lock(_connection_mutex);
+      ::close(connection_fd);
+      auto const connection = _connections.find(connection_fd);
+      _finished_connections.push_back(std::move(connection->second));
+      _connections.erase(connection);
+      _connection_freed.notify_all();
+    }));
+  }
+}
+
+// Join the threads whose connections have closed. They have nothing left to do but return.
+void Query_server::_join_finished_connections()
+{
+  std::vector<std::thread> finished;
+  {
+    std::lock_guard<std::mutex> lock(_connection_mutex);
+    finished.swap(_finished_connections);
+  }
+  for (std::thread& thread : finished)
+    thread.join();
+}
+
+// Answer requests in order until the client closes the connection or breaks the framing.
+// A descriptor sent with a request is the text for that request, and is closed once the
+// request has been answered. The connection itself is closed by its thread.
+void Query_server::_serve_connection(int connection_fd)
+{
+  std::string request;
+  int         text_fd {-1};
+  while (true)
+  {
+    Frame_status const status = read_frame(connection_fd, request, text_fd, _server_options.max_frame_size);
+    if (status != Frame_status::received)
+    {
+      if (text_fd >= 0)
+        ::close(text_fd);
+      if (status == Frame_status::too_large)
+      {
+        std::string const message = "request larger than " + std::to_string(_server_options.max_frame_size) + " bytes";
+        write_frame(connection_fd, nlohmann::json{{"error", message}}.dump());
+      }
+      break;
+    }
+
+    auto response = _pool.submit([&request, text_fd]
+    {
+      return text_fd >= 0 ? run_json_query(request, text_fd)
+                          : run_json_query(request);
+    });
+
+    std::string const response_frame = response.get();
+    if (text_fd >= 0)
+      ::close(text_fd);
+
+    if (!write_frame(connection_fd, response_frame))
+      break;
+  }
+}
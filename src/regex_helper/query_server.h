@@ -0,0 +1,75 @@
+#ifndef QUERY_SERVER_H
+#define QUERY_SERVER_H
+
+#include <condition_variable>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <thread_pool.h>
+
+// Server_options bound what a Query_server takes on, so that no client can make it hold more
+// than the largest frame per connection, or serve more than the most connections at once.
+struct Server_options
+{
+  size_t max_frame_size  {size_t(64) << 20}; // The largest request accepted, in bytes.
+  size_t max_connections {64};               // The most connections served at once.
+};
+
+// A Query_server is a long-running process that answers JSON queries (see json_query.h)
+// over a Unix domain stream socket. Compiled regexes and their automata stay in the process-wide
+// Regex_cache between queries.
+//
+// Requests and responses are framed the same way: a 4-byte length in network byte order,
+// followed by that many bytes of JSON. A client may send any number of requests on one
+// connection, and gets the responses in the same order.
+//
+// Rather than inline a large text in the JSON, a client may send a file descriptor (a memfd
+// or a regular file) as SCM_RIGHTS ancillary data along with the first bytes of a request
+// frame. The server runs the query over its contents, in place of the query's text member,
+// and does not echo the text in the response. A memfd sealed with F_SEAL_SHRINK and
+// F_SEAL_WRITE is mapped and searched in place; any other file is read into memory first, as
+// the client could shrink it under a mapping (see Mapped_file). A descriptor of anything but
+// a regular file is answered with {"error": "..."}.
+//
+// Each connection has a thread that reads its requests and writes its responses, and the
+// queries themselves run on a fixed Thread_pool shared by all connections. Once the most
+// connections allowed are being served, no more are accepted until one closes; clients
+// wait in the socket's backlog meanwhile. A request larger than the largest frame allowed
+// is answered with {"error": "..."}, and its connection closed.
+//
+// The server is destroyed only once every connection thread has finished: the connections
+// still open are shut down, so that their threads stop waiting for requests, and each
+// thread is joined once its query has been answered.
+class Query_server
+{
+  std::string                _socket_path          {""};
+  int                        _listen_fd            {-1};
+  Server_options             _server_options       {};
+  Thread_pool                _pool;
+  std::mutex                 _connection_mutex     {};
+  std::condition_variable    _connection_freed     {};
+  std::map<int, std::thread> _connections          {}; // The thread serving each open connection, by its descriptor.
+  std::vector<std::thread>   _finished_connections {}; // Threads whose connections have closed, yet to be joined.
+
+public:
+  // Listen on a socket at the path, replacing any stale socket file left there. Throws
+  // std::system_error if the socket cannot be created, bound, or listened on.
+  Query_server(std::string const& socket_path,
+               Server_options     server_options = Server_options(),
+               size_t             thread_count   = Thread_pool::default_thread_count());
+  Query_server(Query_server const&) = delete;
+  Query_server& operator=(Query_server const&) = delete;
+  ~Query_server();
+
+  // Accept and serve connections until accepting fails.
+  void serve();
+
+private:
+  void _serve_connection(int connection_fd);
+  void _join_finished_connections();
+};
+
+#endif /* QUERY_SERVER_H */
@@ -0,0 +1,316 @@
+#include <regex_analysis.h>
+
+#include <algorithm>
+#include <string_view>
+
+namespace
+{
+  // The longest literal kept; those of longer repetitions are cut down to it.
+  size_t const max_literal_size = 256;
+
+  // What is known of the text that a node matches: each of its matches starts with the
+  // prefix, ends with the suffix and holds the factor somewhere. If the node is exact, it
+  // only ever matches one text, which is the prefix, the suffix and the factor.
+  struct Literal_info
+  {
+    bool        exact  {false};
+    std::string prefix {""};
+    std::string suffix {""};
+    std::string factor {""};
+  };
+
+  Literal_info exact_info(std::string const& text)
+  {
+    return Literal_info{true, text, text, text};
+  }
+
+  std::string const& longest(std::string const& a, std::string const& b)
+  {
+    return b.size() > a.size() ? b : a;
+  }
+
+  // The character the set holds if it stands for a single one, lowercased under icase.
+  std::optional<char> single_character(Character_set const& characters, bool icase)
+  {
+    if (!icase)
+    {
+      if (characters.count() != 1)
+        return std::nullopt;
+      for (size_t byte = 0; byte < 256; ++byte)
+      {
+        if (characters[byte])
+          return static_cast<char>(byte);
+      }
+    }
+
+    for (size_t byte = 0; byte < 128; ++byte)
+    {
+      if (!characters[byte])
+        continue;
+      char const lower = byte >= 'A' && byte <= 'Z' ? static_cast<char>(byte - 'A' + 'a') : static_cast<char>(byte);
+      char const upper = lower >= 'a' && lower <= 'z' ? static_cast<char>(lower - 'a' + 'A') : lower;
+      Character_set both;
+      both.set(static_cast<unsigned char>(lower));
+      both.set(static_cast<unsigned char>(upper));
+      return both == characters ? std::optional<char>(lower) : std::nullopt;
+    }
+    return std::nullopt;
+  }
+
+  // A match of the first node followed by one of the second starts with the first's prefix,
+  // or all of it and the second's prefix if the first is exact, and likewise at the end.
+  // The first's suffix and the second's prefix meet in the middle.
+  Literal_info concatenate(Literal_info const& first, Literal_info const& second)
+  {
+    Literal_info info;
+    info.exact  = first.exact && second.exact;
+    info.prefix = first.exact  ? first.prefix + second.prefix : first.prefix;
+    info.suffix = second.exact ? first.suffix + second.suffix : second.suffix;
+    info.factor = longest(longest(first.factor, second.factor), first.suffix + second.prefix);
+    if (info.prefix.size() > max_literal_size || info.suffix.size() > max_literal_size)
+    {
+      info.exact = false;
+      if (info.prefix.size() > max_literal_size)
+        info.prefix.resize(max_literal_size);
+      if (info.suffix.size() > max_literal_size)
+        info.suffix.erase(0, info.suffix.size() - max_literal_size);
+    }
+    if (info.factor.size() > max_literal_size)
+      info.factor.resize(max_literal_size);
+    return info;
+  }
+
+  Literal_info literal_info(Regex_node const& node, bool icase)
+  {
+    switch (node.kind)
+    {
+      case Regex_node_kind::empty:
+      case Regex_node_kind::assertion:
+      case Regex_node_kind::lookahead:
+        return exact_info("");
+
+      case Regex_node_kind::characters:
+      {
+        auto const character = single_character(node.characters, icase);
+        return character ? exact_info(std::string(1, *character)) : Literal_info();
+      }
+
+      case Regex_node_kind::concatenation:
+      {
+        Literal_info info = exact_info("");
+        for (auto const& child : node.children)
+          info = concatenate(info, literal_info(child, icase));
+        return info;
+      }
+
+      // Only what all the alternatives start or end with is known.
+      case Regex_node_kind::alternation:
+      {
+        Literal_info info = literal_info(node.children.front(), icase);
+        for (size_t i = 1; i < node.children.size(); ++i)
+        {
+          Literal_info const other = literal_info(node.children[i], icase);
+          info.exact = info.exact && other.exact && info.prefix == other.prefix;
+
+          auto const prefix = std::mismatch(info.prefix.begin(), info.prefix.end(), other.prefix.begin(), other.prefix.end());
+          info.prefix.erase(prefix.first, info.prefix.end());
+          auto const suffix = std::mismatch(info.suffix.rbegin(), info.suffix.rend(), other.suffix.rbegin(), other.suffix.rend());
+          info.suffix.erase(info.suffix.begin(), suffix.first.base());
+        }
+        if (!info.exact)
+          info.factor = longest(info.prefix, info.suffix);
+        return info;
+      }
+
+      // A repetition of at least one holds what its child does; of an exact child, as many
+      // times as the least number of repetitions.
+      case Regex_node_kind::repetition:
+      {
+        if (node.max == 0)
+          return exact_info("");
+        if (node.min == 0)
+          return Literal_info();
+
+        Literal_info const child = literal_info(node.children.front(), icase);
+        if (!child.exact)
+          return Literal_info{false, child.prefix, child.suffix, child.factor};
+
+        Literal_info info = exact_info("");
+        for (size_t i = 0; i < node.min && info.exact; ++i)
+          info = concatenate(info, child);
+        if (node.max != node.min)
+          info.exact = false;
+        return info;
+      }
+
+      case Regex_node_kind::group:
+        return literal_info(node.children.front(), icase);
+
+      case Regex_node_kind::backreference:
+      default:
+        return Literal_info();
+    }
+  }
+
+  bool within_lines(Regex_node const& node)
+  {
+    switch (node.kind)
+    {
+      case Regex_node_kind::characters:
+        return !node.characters['\n'];
+      case Regex_node_kind::lookahead:
+        return false;
+      default:
+        return std::all_of(node.children.begin(), node.children.end(), within_lines);
+    }
+  }
+
+  size_t add_lengths(size_t a, size_t b)
+  {
+    return a > Regex_node::unbounded - b ? Regex_node::unbounded : a + b;
+  }
+
+  size_t multiply_lengths(size_t a, size_t b)
+  {
+    if (a == 0 || b == 0)
+      return 0;
+    return a > Regex_node::unbounded / b ? Regex_node::unbounded : a * b;
+  }
+
+  // The bytes a match of the node of one character or more can start with, and the least
+  // and most characters a match holds. A node with a minimum length of zero may match the
+  // empty string, and then a match of what follows it starts the match of both.
+  void bound_lengths(Regex_node const& node, Match_bounds& bounds)
+  {
+    switch (node.kind)
+    {
+      case Regex_node_kind::empty:
+      case Regex_node_kind::assertion:
+      case Regex_node_kind::lookahead:
+        bounds = Match_bounds{Character_set(), false, 0, 0};
+        return;
+
+      case Regex_node_kind::characters:
+        bounds = Match_bounds{node.characters, false, 1, 1};
+        return;
+
+      case Regex_node_kind::concatenation:
+      {
+        bounds = Match_bounds{Character_set(), false, 0, 0};
+        for (auto const& child : node.children)
+        {
+          Match_bounds child_bounds;
+          bound_lengths(child, child_bounds);
+          if (bounds.min_length == 0)
+            bounds.first_bytes |= child_bounds.first_bytes;
+          bounds.min_length = add_lengths(bounds.min_length, child_bounds.min_length);
+          bounds.max_length = add_lengths(bounds.max_length, child_bounds.max_length);
+        }
+        return;
+      }
+
+      case Regex_node_kind::alternation:
+      {
+        bound_lengths(node.children.front(), bounds);
+        for (size_t i = 1; i < node.children.size(); ++i)
+        {
+          Match_bounds child_bounds;
+          bound_lengths(node.children[i], child_bounds);
+          bounds.first_bytes |= child_bounds.first_bytes;
+          bounds.min_length   = std::min(bounds.min_length, child_bounds.min_length);
+          bounds.max_length   = std::max(bounds.max_length, child_bounds.max_length);
+        }
+        return;
+      }
+
+      case Regex_node_kind::repetition:
+      {
+        if (node.max == 0)
+        {
+          bounds = Match_bounds{Character_set(), false, 0, 0};
+          return;
+        }
+        bound_lengths(node.children.front(), bounds);
+        bounds.min_length = multiply_lengths(bounds.min_length, node.min);
+        bounds.max_length = multiply_lengths(bounds.max_length, node.max);
+        return;
+      }
+
+      case Regex_node_kind::group:
+        bound_lengths(node.children.front(), bounds);
+        return;
+
+      case Regex_node_kind::backreference:
+      default:
+        bounds = Match_bounds{Character_set().set(), false, 0, Regex_node::unbounded};
+        return;
+    }
+  }
+
+  // Whether the node always matches the empty string, and so no characters.
+  bool zero_width(Regex_node const& node)
+  {
+    switch (node.kind)
+    {
+      case Regex_node_kind::empty:
+      case Regex_node_kind::assertion:
+      case Regex_node_kind::lookahead:
+        return true;
+      case Regex_node_kind::characters:
+      case Regex_node_kind::backreference:
+        return false;
+      case Regex_node_kind::repetition:
+        return node.max == 0 || zero_width(node.children.front());
+      default:
+        return std::all_of(node.children.begin(), node.children.end(), zero_width);
+    }
+  }
+
+  // Whether every match of the node passes a ^ before it matches any character.
+  bool starts_at_line_begin(Regex_node const& node)
+  {
+    switch (node.kind)
+    {
+      case Regex_node_kind::assertion:
+        return node.assertion == Regex_assertion::line_begin;
+      case Regex_node_kind::concatenation:
+        for (auto const& child : node.children)
+        {
+          if (starts_at_line_begin(child))
+            return true;
+          if (!zero_width(child))
+            return false;
+        }
+        return false;
+      case Regex_node_kind::alternation:
+        return std::all_of(node.children.begin(), node.children.end(), starts_at_line_begin);
+      case Regex_node_kind::repetition:
+        return node.min > 0 && starts_at_line_begin(node.children.front());
+      case Regex_node_kind::group:
+        return starts_at_line_begin(node.children.front());
+      default:
+        return false;
+    }
+  }
+}
+
+std::optional<std::string> required_literal(Regex_tree const& tree)
+{
+  std::string literal = literal_info(tree.root, tree.icase).factor;
+  if (literal.empty())
+    return std::nullopt;
+  return literal;
+}
+
+bool matches_within_lines(Regex_tree const& tree)
+{
+  return within_lines(tree.root);
+}
+
+Match_bounds match_bounds(Regex_tree const& tree)
+{
+  Match_bounds bounds;
+  bound_lengths(tree.root, bounds);
+  bounds.anchored = !tree.multiline && starts_at_line_begin(tree.root);
+  return bounds;
+}
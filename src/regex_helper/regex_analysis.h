@@ -0,0 +1,37 @@
+#ifndef REGEX_ANALYSIS_H
+#define REGEX_ANALYSIS_H
+
+#include <optional>
+#include <string>
+
+#include <regex_syntax.h>
+
+// Return a literal that every match of the regex holds, the longest the analysis finds,
+// or std::nullopt if it finds none. The literal is taken from what the regex must match in
+// sequence: runs of single characters, carried through groups, assertions and repetitions
+// of at least one, and across alternatives only where they all begin or end alike. Under
+// icase, a character only counts if it is ASCII, and the literal is lowercased, to be
+// found in any case by a Literal_finder.
+std::optional<std::string> required_literal(Regex_tree const& tree);
+
+// Whether every match of the regex lies within one line: no character of the regex can
+// match a newline, and it has no lookahead, which could look past the end of the line.
+// Back-references repeat text of the match, and so lie within its line as well.
+bool matches_within_lines(Regex_tree const& tree);
+
+// What the analysis finds of where the matches of a regex can start and how long they can
+// be. Assertions and lookaheads match no characters, and a back-reference may match any
+// number, so the bounds hold however the regex is matched.
+struct Match_bounds
+{
+  Character_set first_bytes {};                     // The bytes a match of one character or more can start with.
+  bool          anchored    {false};                // Whether every match starts where ^ holds.
+  size_t        min_length  {0};                    // The least number of characters a match holds.
+  size_t        max_length  {Regex_node::unbounded}; // The most, or unbounded.
+};
+
+// Return the Match_bounds of the regex. A regex is only anchored if ^ holds nowhere but at
+// the start of the text, which is not so under multiline.
+Match_bounds match_bounds(Regex_tree const& tree);
+
+#endif /* REGEX_ANALYSIS_H */
@@ -0,0 +1,45 @@
+#include <regex_automata.h>
+#include <regex_nfa.h>
+
+Regex_automata::Regex_automata(std::string const& regex, std::regex_constants::syntax_option_type syntax_option_mask)
+: _tree(parse_regex(regex, syntax_option_mask))
+{
+  if (!_tree)
+    return;
+  _match_bounds = ::match_bounds(*_tree);
+  if (matches_within_lines(*_tree))
+    _required_literal = ::required_literal(*_tree);
+}
+
+std::optional<Match_bounds> const& Regex_automata::match_bounds() const
+{
+  return _match_bounds;
+}
+
+std::optional<std::string> const& Regex_automata::required_literal() const
+{
+  return _required_literal;
+}
+
+bool Regex_automata::icase() const
+{
+  return _tree && _tree->icase;
+}
+
+// The Nfa is compiled from the Regex_tree, copied into the Pike_vm if there is one, and then
+// moved into the Lazy_dfa.
+Regex_automata::Dfa const& Regex_automata::dfa() const
+{
+  std::call_once(_dfa_built, [this]
+  {
+    auto nfa = _tree ? compile_nfa(*_tree) : std::nullopt;
+    if (!nfa)
+      return;
+    if (nfa->ecmascript && nfa->group_count > 0)
+      _dfa.pike_vm = std::make_shared<Pike_vm const>(*nfa);
+    _dfa.ends_matches = nfa->ecmascript || nfa->finds_longest;
+    _dfa.finds_groups = nfa->group_count == 0 || _dfa.pike_vm;
+    _dfa.lazy_dfa     = std::make_shared<Lazy_dfa const>(std::move(*nfa), *_match_bounds);
+  });
+  return _dfa;
+}
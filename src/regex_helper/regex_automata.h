@@ -0,0 +1,60 @@
+#ifndef REGEX_AUTOMATA_H
+#define REGEX_AUTOMATA_H
+
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <regex>
+#include <string>
+
+#include <lazy_dfa.h>
+#include <pike_vm.h>
+#include <regex_analysis.h>
+#include <regex_syntax.h>
+
+// Regex_automata are what a Compiled_query learns about a regex beyond its std::regex: the
+// Match_bounds and required literal its Regex_tree yields, and the Lazy_dfa and Pike_vm
+// built from its Nfa. The Regex_cache keeps them next to the std::regex, under the same
+// key, so that every query of the same regex shares them, and a Lazy_dfa's states, once
+// built by one query, serve the next rather than being built again.
+//
+// The regex is parsed and analysed on construction. Its automata are only built on the first
+// call to dfa(), since only queries under Engine::dfa need them; threads calling it at once
+// wait for that one build. After that the Regex_automata are immutable.
+class Regex_automata
+{
+public:
+  // The automata of a regex that compiles to an Nfa (see compile_nfa).
+  struct Dfa
+  {
+    std::shared_ptr<Lazy_dfa const> lazy_dfa     {nullptr}; // Null if the regex does not compile to an Nfa.
+    std::shared_ptr<Pike_vm const>  pike_vm      {nullptr}; // Only built for an ECMAScript regex with groups.
+    bool                            ends_matches {false};   // Whether the Lazy_dfa finds where std::regex's match ends.
+    bool                            finds_groups {false};   // Whether the groups of a match are known without std::regex: there are none, or the Pike_vm finds them.
+  };
+
+  Regex_automata(std::string const& regex, std::regex_constants::syntax_option_type syntax_option_mask);
+  Regex_automata(Regex_automata const&) = delete;
+  Regex_automata& operator=(Regex_automata const&) = delete;
+
+  // Null if the parser does not take the regex (see parse_regex).
+  std::optional<Match_bounds> const& match_bounds() const;
+
+  // The regex's required literal (see required_literal), if it has one and every match of it
+  // lies within one line (see matches_within_lines).
+  std::optional<std::string> const& required_literal() const;
+
+  // Whether the required literal is matched ignoring case.
+  bool icase() const;
+
+  Dfa const& dfa() const;
+
+private:
+  std::optional<Regex_tree>   _tree             {};
+  std::optional<Match_bounds> _match_bounds     {};
+  std::optional<std::string>  _required_literal {};
+  mutable std::once_flag      _dfa_built        {};
+  mutable Dfa                 _dfa              {};
+};
+
+#endif /* REGEX_AUTOMATA_H */
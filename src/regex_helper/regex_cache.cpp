@@ -0,0 +1,93 @@
+#include <regex_cache.h>
+
+Regex_cache::Regex_cache(size_t capacity)
+: _capacity(capacity)
+{}
+
+// Find or add the entry under the cache's lock, then compile outside it, under the entry's
+// own std::once_flag, so that a slow compile only holds up requests for the same regex. The
+// Regex_automata are only built once the std::regex has shown the regex to be valid.
+Regex_cache::Compiled
+Regex_cache::get(std::string const&                       regex,
+                 std::regex_constants::syntax_option_type syntax_option_mask)
+{
+  std::shared_ptr<Entry> entry;
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+    Key  key(regex, syntax_option_mask);
+    auto found = _index.find(key);
+    if (found != _index.end())
+    {
+      ++_hits;
+      _entries.splice(_entries.begin(), _entries, found->second);
+      entry = *found->second;
+    }
+    else
+    {
+      ++_misses;
+      entry      = std::make_shared<Entry>();
+      entry->key = key;
+      _entries.push_front(entry);
+      _index.emplace(std::move(key), _entries.begin());
+      _evict_to_capacity();
+    }
+  }
+
+  try
+  {
+    std::call_once(entry->compiled_once, [&]
+    {
+      auto compiled_regex = std::make_shared<std::regex const>(regex, syntax_option_mask);
+      entry->compiled     = Compiled{std::move(compiled_regex), std::make_shared<Regex_automata const>(regex, syntax_option_mask)};
+    });
+  }
+  catch (...)
+  {
+    // Do not keep the invalid regex around, unless another request has replaced its entry.
+    std::lock_guard<std::mutex> lock(_mutex);
+    auto found = _index.find(entry->key);
+    if (found != _index.end() && *found->second == entry)
+    {
+      _entries.erase(found->second);
+      _index.erase(found);
+    }
+    throw;
+  }
+  return entry->compiled;
+}
+
+size_t Regex_cache::capacity() const
+{
+  std::lock_guard<std::mutex> lock(_mutex);
+  return _capacity;
+}
+
+void Regex_cache::set_capacity(size_t capacity)
+{
+  std::lock_guard<std::mutex> lock(_mutex);
+  _capacity = capacity;
+  _evict_to_capacity();
+}
+
+Regex_cache::Statistics Regex_cache::statistics() const
+{
+  std::lock_guard<std::mutex> lock(_mutex);
+  return Statistics{_entries.size(), _capacity, _hits, _misses, _evictions};
+}
+
+Regex_cache& Regex_cache::instance()
+{
+  static Regex_cache cache;
+  return cache;
+}
+
+// Drop least recently used entries until the cache fits. Must hold _mutex.
+void Regex_cache::_evict_to_capacity()
+{
+  while (_entries.size() > _capacity)
+  {
+    _index.erase(_entries.back()->key);
+    _entries.pop_back();
+    ++_evictions;
+  }
+}
@@ -0,0 +1,97 @@
+#ifndef REGEX_CACHE_H
+#define REGEX_CACHE_H
+
+#include <cstddef>
+#include <functional>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <regex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+
+#include <regex_automata.h>
+
+// A Regex_cache hands out compiled std::regexes keyed on the regex text and the syntax
+// option mask, so that a regex used again and again is compiled once. It holds at most
+// capacity() regexes, and evicts the least recently used one to make room for another.
+// Each std::regex is kept along with the Regex_automata of the same text and mask, which
+// are built with it and evicted with it. An evicted std::regex, or Regex_automata, lives on
+// for as long as a caller still holds it.
+//
+// The cache is safe to use from many threads: a thread asking for a regex that another
+// thread is compiling waits for that compile rather than repeating it, while requests for
+// other regexes go ahead. The std::regexes are immutable once built, and are shared
+// read-only between the callers. There is one process-wide cache, instance(), which every
+// Regex_helper uses unless it is handed a compiled regex.
+class Regex_cache
+{
+public:
+  // Counters since the cache was created.
+  struct Statistics
+  {
+    size_t size      {0}; // Regexes held now.
+    size_t capacity  {0};
+    size_t hits      {0}; // Requests answered with a regex already in the cache.
+    size_t misses    {0}; // Requests that added a regex to the cache.
+    size_t evictions {0}; // Regexes dropped to make room.
+  };
+
+  // A regex compiled by the cache.
+  struct Compiled
+  {
+    std::shared_ptr<std::regex const>     regex    {nullptr};
+    std::shared_ptr<Regex_automata const> automata {nullptr};
+  };
+
+  explicit Regex_cache(size_t capacity = default_capacity);
+  Regex_cache(Regex_cache const&) = delete;
+  Regex_cache& operator=(Regex_cache const&) = delete;
+
+  // Return the std::regex for the text and mask, with its Regex_automata, compiling both if
+  // they are not in the cache. Throws std::regex_error if the regex is invalid, in which case
+  // it is not cached.
+  Compiled get(std::string const&                       regex,
+               std::regex_constants::syntax_option_type syntax_option_mask);
+
+  size_t     capacity() const;
+  void       set_capacity(size_t capacity);
+  Statistics statistics() const;
+
+  static Regex_cache& instance();
+
+  static size_t const default_capacity = 256;
+
+private:
+  using Key = std::pair<std::string, std::regex_constants::syntax_option_type>;
+
+  struct Key_hash
+  {
+    size_t operator()(Key const& key) const
+    {
+      return std::hash<std::string>()(key.first) ^ (static_cast<size_t>(key.second) * 0x9e3779b97f4a7c15ull);
+    }
+  };
+
+  struct Entry
+  {
+    Key            key           {};
+    std::once_flag compiled_once {};
+    Compiled       compiled      {};
+  };
+
+  using Entry_list = std::list<std::shared_ptr<Entry>>; // Most recently used first.
+
+  void _evict_to_capacity();
+
+  mutable std::mutex                                        _mutex     {};
+  Entry_list                                                _entries   {};
+  std::unordered_map<Key, Entry_list::iterator, Key_hash>   _index     {};
+  size_t                                                    _capacity  {default_capacity};
+  size_t                                                    _hits      {0};
+  size_t                                                    _misses    {0};
+  size_t                                                    _evictions {0};
+};
+
+#endif /* REGEX_CACHE_H */
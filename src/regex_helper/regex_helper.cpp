@@ -1,110 +1,96 @@
 #include <regex_helper.h>
-#include <json.hpp>
+#include <arrow_writer.h>
+#include <binary_writer.h>
+#include <json_writer.h>
+#include <stream_insert_overloads.h>
 
-// On construction, call the regex function according to the algorithm type.
+#include <algorithm>
+#include <stdexcept>
+
+// On construction, compile the regex with its options into a Compiled_query, and run the
+// algorithm they select over the text.
 Regex_helper::Regex_helper(std::string   && text,
                            std::string   && regex,
                            Regex_options && regex_options)
-: _text          (std::move(text)),
-  _regex         (std::move(regex)),
-  _regex_options (std::move(regex_options))
+: _query (std::make_shared<Compiled_query const>(std::move(regex), std::move(regex_options)))
 {
-  switch (regex_options.algorithm())
-  {
-    case Algorithm::match:
-      _execute_regex_match();
-      break;
-    case Algorithm::search:
-      _execute_regex_search();
-      break;
-    case Algorithm::replace:
-      _execute_regex_replace();
-      break;
-    default:
-      break;
-  }
+  _own_text(std::move(text));
+  _execute();
 }
 
-// Call std::regex_match() on the target text sequence, which will produce a std::smatch.
-// Create a Match from that std::smatch, giving it the format string for output. Store
-// the Search_results created with the match.
-void Regex_helper::_execute_regex_match()
+// As above, but run a query that was already compiled, and may be shared between helpers.
+Regex_helper::Regex_helper(std::string                           && text,
+                           std::shared_ptr<Compiled_query const>    query)
+: _query (std::move(query))
 {
-  auto regex           = _construct_regex();
-  auto match_flag_mask = _regex_options.match_flag_mask();
-  auto format_string   = _regex_options.format_string();
-
-  std::smatch match_out;
-  std::regex_match(_text, match_out, regex, match_flag_mask);
-
-  Match match = Match(std::move(match_out), std::move(format_string));
-
-  _results = std::make_shared<Match_results>(std::move(match));
+  _own_text(std::move(text));
+  _execute();
 }
 
-// Call std::regex_search iteratively on the text with std::sregex_iterator.
-// A single std::regex_search only finds the first potential match. This function
-// searches the entire text, regardless of matches, and places them in a
-// std::vector<Match>, which it std::moves into the Search_results constructor.
-void Regex_helper::_execute_regex_search()
+// As above, but search the contents of a mapped file in place.
+Regex_helper::Regex_helper(Mapped_file                           && text_file,
+                           std::shared_ptr<Compiled_query const>    query,
+                           bool                                     echo_text)
+: _echo_text (echo_text),
+  _query     (std::move(query))
 {
-  auto text_begin      = _text.begin();
-  auto text_end        = _text.end();
-  auto regex           = _construct_regex();
-  auto match_flag_mask = _regex_options.match_flag_mask();
-  auto format_string   = _regex_options.format_string();
-
-  auto regex_iterator_begin = std::sregex_iterator(text_begin, text_end,
-                                                   regex,
-                                                   match_flag_mask);
-
-  auto matches = _get_matches_from_iterator(regex_iterator_begin, format_string);
+  auto mapping = std::make_shared<Mapped_file const>(std::move(text_file));
+  _text       = mapping->view();
+  _text_owner = std::move(mapping);
 
-  _results = std::make_shared<Search_results>(std::move(matches));
+  _execute();
 }
 
-// Call std::regex_replace on the target text sequence, which produces a
-// formatted result std::string. Create a Replace_results object with that
-// result.
-void Regex_helper::_execute_regex_replace()
-{
-  auto regex           = _construct_regex();
-  auto format_string   = _regex_options.format_string();
-  auto match_flag_mask = _regex_options.match_flag_mask();
+Regex_helper::Regex_helper(Mapped_file   && text_file,
+                           std::string   && regex,
+                           Regex_options && regex_options)
+: Regex_helper(std::move(text_file),
+               std::make_shared<Compiled_query const>(std::move(regex), std::move(regex_options)))
+{}
 
-  std::string replace_result = std::regex_replace(_text,
-                                                  regex,
-                                                  std::move(format_string),
-                                                  match_flag_mask);
+// Read the text from a stream. A search reads and searches it a chunk at a time, and
+// never holds the whole text. std::regex_match and std::regex_replace need the whole
+// text at once, so for those the stream is read to the end first.
+Regex_helper::Regex_helper(std::istream  &  text_stream,
+                           std::string   && regex,
+                           Regex_options && regex_options,
+                           Stream_options    stream_options)
+: _query (std::make_shared<Compiled_query const>(std::move(regex), std::move(regex_options)))
+{
+  if (_query->regex_options().algorithm() == Algorithm::search && !_query->regex_options().lines())
+  {
+    _text_streamed = true;
+    _echo_text     = false;
+    if (_query->regex_options().result_options().exists())
+      _results = std::make_shared<Exists_results>(_query->exists(text_stream, stream_options));
+    else if (_query->regex_options().result_options().count())
+      _results = std::make_shared<Count_results>(_query->count(text_stream, stream_options));
+    else
+      _results = std::make_shared<Search_results>(_query->search(text_stream, stream_options));
+    return;
+  }
 
-  _results = std::make_shared<Replace_results>(std::move(replace_result));
+  _own_text(std::string(std::istreambuf_iterator<char>(text_stream),
+                        std::istreambuf_iterator<char>()));
+  _execute();
 }
 
-// Take the regex text and the mask generated from the syntax options, and
-// create a std::regex to use in the std::regex matching functions.
-std::regex Regex_helper::_construct_regex() const
+// Move the text into shared storage, so that _text stays valid when the helper is moved.
+void Regex_helper::_own_text(std::string&& text)
 {
-  return std::regex(_regex, _regex_options.syntax_option_mask());
+  auto text_storage = std::make_shared<std::string const>(std::move(text));
+  _text       = *text_storage;
+  _text_owner = std::move(text_storage);
 }
 
-// Given a std::sregex_iterator created from the target text sequence,
-// regex, and match flags, iterate through it and construct Matches with
-// the desired format string applied.
-std::vector<Match>
-Regex_helper::_get_matches_from_iterator(std::sregex_iterator begin,
-                                         std::string          format_string) const
+// The helper keeps its text for its whole life, so the Submatches view it rather than copy it.
+// A count or an existence check is wanted for its own sake, so the text is not echoed with it.
+void Regex_helper::_execute()
 {
-  auto end = std::sregex_iterator();
-  std::vector<Match> matches;
-  matches.reserve(std::distance(begin, end));
-
-  for (std::sregex_iterator it = begin; it != end; ++it)
-  {
-    std::smatch match = *it;
-    matches.emplace_back(Match(std::move(match), std::move(format_string)));
-  }
-
-  return matches;
+  auto const& result_options = _query->regex_options().result_options();
+  if (result_options.count() || result_options.exists())
+    _echo_text = false;
+  _results = _query->execute(_text, _text_owner);
 }
 
 // Parse the command line arguments into a Regex_helper, and return it.
@@ -114,27 +100,237 @@ Regex_helper::_get_matches_from_iterator(std::sregex_iterator begin,
 //   argv[0]  [1]  [2]   [3...argc]
 //
 // argv[0]      is ignored, since it holds the program name.
-// argv[1,3)    must hold the target text sequence and regex strings
+// argv[1,3)    must hold the target text sequence (or --text-file=PATH) and regex strings
 // argv[3,argc) may hold additional options
 Regex_helper create_helper_from_args(int argc, char* const argv[])
 {
-  std::vector<std::string> text_and_regex_arguments(argv + 1, argv + 3);
-  std::vector<std::string> option_arguments        (argv + 3, argv + argc);
+  std::string_view const   text_argument = argv[1];
+  std::string              regex         = argv[2];
+  std::vector<std::string> option_arguments(argv + 3, argv + argc);
 
-  std::string text  = text_and_regex_arguments.at(0);
-  std::string regex = text_and_regex_arguments.at(1);
+  Stream_options stream_options = extract_stream_options_from_option_arguments(option_arguments, text_argument == "--stdin");
+  extract_output_options_from_option_arguments(option_arguments);
+  Regex_options  regex_options  = create_regex_options_from_option_arguments(option_arguments);
 
-  Regex_options regex_options = create_regex_options_from_option_arguments(option_arguments);
+  const std::string_view text_file_arg_id_text = "--text-file=";
+  if (text_argument.substr(0, text_file_arg_id_text.length()) == text_file_arg_id_text)
+  {
+    // Map the file at the path contained in [text_file_arg_id_text.length(), text_argument.length()).
+    Mapped_file text_file(std::string(text_argument.substr(text_file_arg_id_text.length())));
+    return Regex_helper(std::move(text_file),
+                        std::move(regex),
+                        std::move(regex_options));
+  }
+
+  if (text_argument == "--stdin")
+  {
+    return Regex_helper(std::cin,
+                        std::move(regex),
+                        std::move(regex_options),
+                        stream_options);
+  }
 
-  return Regex_helper(std::move(text),
+  return Regex_helper(std::string(text_argument),
                       std::move(regex),
                       std::move(regex_options));
 }
 
+// Only a match or a search hands over its matches one by one; anything else has Results that
+// are only whole once the query has run, so they are written as one line at the end.
+int print_ndjson_from_args(int argc, char* const argv[])
+{
+  std::string_view const   text_argument = argv[1];
+  std::vector<std::string> option_arguments(argv + 3, argv + argc);
+
+  Stream_options       stream_options = extract_stream_options_from_option_arguments(option_arguments, text_argument == "--stdin");
+  extract_output_options_from_option_arguments(option_arguments);
+  Compiled_query const query(argv[2], create_regex_options_from_option_arguments(option_arguments));
+
+  auto const& regex_options   = query.regex_options();
+  auto const& result_options  = regex_options.result_options();
+  bool const  streams_matches = regex_options.algorithm() != Algorithm::replace &&
+                                !result_options.count()                         &&
+                                !result_options.exists();
+
+  Json_writer       writer(std::cout);
+  Ndjson_match_sink sink(writer, query.format_program());
+
+  auto run_over_text = [&](std::string_view text)
+  {
+    if (streams_matches)
+    {
+      query.execute(text, sink);
+      return sink.match_count() > 0;
+    }
+
+    std::shared_ptr<Results> results = query.execute(text);
+    write_document(writer, results);
+    writer.newline();
+    return results_have_match(*results);
+  };
+
+  bool matched = false;
+  const std::string_view text_file_arg_id_text = "--text-file=";
+  if (text_argument.substr(0, text_file_arg_id_text.length()) == text_file_arg_id_text)
+  {
+    Mapped_file text_file(std::string(text_argument.substr(text_file_arg_id_text.length())));
+    matched = run_over_text(text_file.view());
+  }
+  else if (text_argument == "--stdin" && streams_matches &&
+           regex_options.algorithm() == Algorithm::search && !regex_options.lines())
+  {
+    query.execute(std::cin, sink, stream_options);
+    matched = sink.match_count() > 0;
+  }
+  else if (text_argument == "--stdin")
+  {
+    matched = run_over_text(std::string(std::istreambuf_iterator<char>(std::cin),
+                                        std::istreambuf_iterator<char>()));
+  }
+  else
+  {
+    matched = run_over_text(text_argument);
+  }
+
+  writer.flush();
+  return result_options.exists() && !matched ? 1 : 0;
+}
+
+namespace
+{
+  // Parse the value of a size option, which must be a whole number of bytes, and more than
+  // zero unless zero_allowed. Throws std::invalid_argument naming the option otherwise.
+  size_t parse_size_option(std::string const& option, std::string const& value, bool zero_allowed)
+  {
+    bool const digits = !value.empty() &&
+                        std::all_of(value.begin(), value.end(), [](char c) { return c >= '0' && c <= '9'; });
+    size_t size = 0;
+    try
+    {
+      if (digits)
+        size = std::stoul(value);
+    }
+    catch (std::out_of_range const&)
+    {
+      throw std::invalid_argument(option + " is too large: " + value);
+    }
+    if (!digits || (size == 0 && !zero_allowed))
+      throw std::invalid_argument(option + " must be a number of bytes" +
+                                  (zero_allowed ? "" : " greater than zero") + ", not " +
+                                  (value.empty() ? "nothing" : value));
+    return size;
+  }
+}
+
+// Remove the --chunk-size=N and --overlap-size=N arguments from the option arguments,
+// and return Stream_options reflecting them. Both sizes are in bytes; the chunk size must
+// be greater than zero. Only a search of standard input reads the text a chunk at a time, so
+// unless from_stdin, the arguments are ignored with a warning on standard error.
+Stream_options extract_stream_options_from_option_arguments(std::vector<std::string>& option_arguments, bool from_stdin)
+{
+  const std::string chunk_size_arg_id_text   = "--chunk-size=";
+  const std::string overlap_size_arg_id_text = "--overlap-size=";
+
+  Stream_options stream_options;
+  std::vector<std::string> remaining_arguments;
+  for (auto& arg : option_arguments)
+  {
+    bool const chunk_size   = arg.find(chunk_size_arg_id_text)   == 0;
+    bool const overlap_size = arg.find(overlap_size_arg_id_text) == 0;
+    if (!chunk_size && !overlap_size)
+    {
+      remaining_arguments.push_back(std::move(arg));
+      continue;
+    }
+
+    if (chunk_size)
+      stream_options.chunk_size   = parse_size_option("--chunk-size",
+                                                      arg.substr(chunk_size_arg_id_text.length()),
+                                                      false);
+    else
+      stream_options.overlap_size = parse_size_option("--overlap-size",
+                                                      arg.substr(overlap_size_arg_id_text.length()),
+                                                      true);
+    if (!from_stdin)
+      std::cerr << "Ignoring " << arg << " without --stdin" << std::endl;
+  }
+
+  option_arguments = std::move(remaining_arguments);
+  return stream_options;
+}
+
+// Remove the --output=FORMAT, --ndjson, --delta-positions and --arrow-text arguments from the
+// option arguments, and return Output_options reflecting them. --ndjson is --output=ndjson.
+Output_options extract_output_options_from_option_arguments(std::vector<std::string>& option_arguments)
+{
+  const std::string output_arg_id_text          = "--output=";
+  const std::string ndjson_arg_id_text          = "--ndjson";
+  const std::string delta_positions_arg_id_text = "--delta-positions";
+  const std::string arrow_text_arg_id_text      = "--arrow-text";
+
+  Output_options output_options;
+  std::vector<std::string> remaining_arguments;
+  for (auto& arg : option_arguments)
+  {
+    if (arg.find(output_arg_id_text) == 0)
+    {
+      std::string const format = arg.substr(output_arg_id_text.length());
+      if (format == "json")
+        output_options.format = Output_format::json;
+      else if (format == "ndjson")
+        output_options.format = Output_format::ndjson;
+      else if (format == "cbor")
+        output_options.format = Output_format::cbor;
+      else if (format == "msgpack")
+        output_options.format = Output_format::msgpack;
+      else if (format == "arrow")
+        output_options.format = Output_format::arrow;
+      else
+        throw std::invalid_argument("unknown output format " + format);
+    }
+    else if (arg == ndjson_arg_id_text)
+      output_options.format = Output_format::ndjson;
+    else if (arg == delta_positions_arg_id_text)
+      output_options.delta_positions = true;
+    else if (arg == arrow_text_arg_id_text)
+      output_options.arrow_text = true;
+    else
+      remaining_arguments.push_back(std::move(arg));
+  }
+
+  option_arguments = std::move(remaining_arguments);
+  return output_options;
+}
+
+std::string Regex_helper::json(int indent) const
+{
+  Json_writer writer(indent);
+  write_document(writer, *this);
+  return writer.take();
+}
+
 void Regex_helper::pretty_print() const
 {
-  std::stringstream json_output_buffer;
-  json_output_buffer << *this;
-  nlohmann::json j = nlohmann::json::parse(json_output_buffer.str());
-  std::cout << j.dump(2) << std::endl;
+  Json_writer writer(std::cout, 2);
+  write_document(writer, *this);
+  writer.newline();
+  writer.flush();
+}
+
+void Regex_helper::print(Output_options const& output_options) const
+{
+  if (output_options.format == Output_format::arrow)
+  {
+    write_arrow(std::cout, *_results, output_options);
+    return;
+  }
+  if (output_options.format != Output_format::cbor && output_options.format != Output_format::msgpack)
+  {
+    pretty_print();
+    return;
+  }
+
+  auto writer = create_binary_writer(std::cout, output_options);
+  write_document(*writer, *this);
+  writer->flush();
 }
@@ -4,58 +4,116 @@
 #include <iostream>
 #include <memory>
 #include <regex>
+#include <string_view>
 #include <vector>
 
+#include <compiled_query.h>
+#include <document_writer.h>
+#include <mapped_file.h>
 #include <regex_options.h>
 #include <results.h>
 
 // Regex_helper is a class intended to do the heavy lifting of std::regex algorithms.
 // Given the target text sequence, the text of the regex, and the Regex_options, the class
-// constructor reads the options and executes the regex as specified by the arguments.
+// constructor compiles them into a Compiled_query and executes it over the text. A query
+// that was already compiled may be given instead, so that many helpers share one.
 // The class gives access to its properties directly if needed. The pretty_print function
 // writes a JSON representation of the query and results to standard output by calling
-// the relevant operator<< functions on the members of Regex_helper, then parsing and
-// serializing via nlohmann's C++ json library, which handles indentation and ensures
-// adherence to the JSON specification. The class only allows move construction, as
-// the strings may be quite large and therefore undesirable to copy.
+// the relevant write_document functions on the members of Regex_helper, which write them
+// through a Json_writer straight into an output buffer, indented and escaped, in one pass;
+// the print function does the same in the Output_format chosen, such as CBOR or MessagePack,
+// or writes the matches as an Arrow table.
+// The class only allows move construction, as the strings may be quite large and
+// therefore undesirable to copy.
+//
+// The target text is either owned as a std::string or mapped from a file with Mapped_file.
+// Either way, the algorithms only ever see it through the std::string_view _text, and
+// _text_owner keeps the underlying storage alive (and in place) for the life of the helper,
+// and for that of its Results, whose Submatches view the text rather than copy it.
+// Text read from a std::istream is searched chunk by chunk and never held in full, so in
+// that case _text is empty and _text_streamed is set. The JSON output echoes the text
+// unless it was streamed, the matches are only counted or checked for, or _echo_text was
+// turned off for a mapped text that may be huge.
 class Regex_helper
 {
   // Properties populated on construction.
-  std::string              _text          {""};
-  std::string              _regex         {""};
-  Regex_options            _regex_options {};
-  std::shared_ptr<Results> _results       {nullptr};
+  std::shared_ptr<void const> _text_owner    {nullptr};
+  std::string_view            _text          {};
+  bool                        _text_streamed {false};
+  bool                        _echo_text     {true};
+  std::shared_ptr<Results>    _results       {nullptr};
+
+  std::shared_ptr<Compiled_query const> _query {nullptr};
 
 public:
   Regex_helper() = delete;
   Regex_helper(std::string   && text,
                std::string   && regex,
                Regex_options && regex_options = Regex_options());
+  Regex_helper(std::string                           && text,
+               std::shared_ptr<Compiled_query const>    query);
+  Regex_helper(Mapped_file   && text_file,
+               std::string   && regex,
+               Regex_options && regex_options = Regex_options());
+  Regex_helper(Mapped_file                           && text_file,
+               std::shared_ptr<Compiled_query const>    query,
+               bool                                     echo_text = true);
+  Regex_helper(std::istream  &  text_stream,
+               std::string   && regex,
+               Regex_options && regex_options = Regex_options(),
+               Stream_options    stream_options = Stream_options());
+
+  std::string_view                text()          const { return _text;                   };
+  bool                            text_streamed() const { return _text_streamed;          };
+  bool                            echo_text()     const { return _echo_text;              };
+  Compiled_query           const& query()         const { return *_query;                 };
+  std::string              const& regex()         const { return _query->regex();         };
+  Regex_options            const& regex_options() const { return _query->regex_options(); };
+  std::shared_ptr<Results> const& results()       const { return _results;                };
 
-  std::string              const& text()          const { return _text;          };
-  std::string              const& regex()         const { return _regex;         };
-  Regex_options            const& regex_options() const { return _regex_options; };
-  std::shared_ptr<Results> const& results()       const { return _results;       };
+  // Return the JSON representation, indented by the given number of spaces per level,
+  // or on a single line if the indent is negative.
+  std::string json(int indent) const;
 
   // Write formatted JSON to standard output.
   void pretty_print() const;
 
-  friend std::ostream& operator<<(std::ostream& os, Regex_helper const& regex_helper);
+  // Write to standard output in the format the Output_options select: formatted JSON, as
+  // pretty_print does, a CBOR or MessagePack document of the same shape, or an Arrow IPC
+  // stream of the matches.
+  void print(Output_options const& output_options) const;
 
-private:
-  std::regex _construct_regex() const;
+  friend void write_document(Document_writer& writer, Regex_helper const& regex_helper);
 
-  // Helpers for each algorithm that call std::regex_match/search/replace and populate the results.
-  void _execute_regex_match();
-  void _execute_regex_search();
-  void _execute_regex_replace();
+private:
+  void _own_text(std::string&& text);
 
-  // Helper for Algorithm::Search.
-  std::vector<Match> _get_matches_from_iterator(std::sregex_iterator begin,
-                                                std::string          format_string) const;
+  // Run the Compiled_query over _text.
+  void _execute();
 };
 
 // Read in command line arguments and create a Regex_helper reflecting those arguments.
+// The target text is either argv[1] itself or, given --text-file=PATH in its place, the
+// contents of the file at PATH. Given --stdin in its place, the text is read from standard
+// input, in chunks for a search.
 Regex_helper create_helper_from_args(int argc, char* const argv[]);
 
+// Read in command line arguments as create_helper_from_args does, and run the query, writing
+// newline-delimited JSON to standard output rather than one JSON document. For the match and
+// search algorithms, each match is written on a line of its own as soon as it is found, with
+// its position in the whole text, and no Results are gathered; a search of standard input
+// reads it a chunk at a time. For anything else (a replace, a count, an existence check),
+// the Results are written on a single line. Return the exit status: with --exists, 0 if the
+// regex matched and 1 if not, and otherwise 0.
+int print_ndjson_from_args(int argc, char* const argv[]);
+
+// Remove the arguments that configure stream buffering from the option arguments, and
+// return Stream_options reflecting them. Throws std::invalid_argument for a size that is not
+// a number, or a chunk size of zero. The arguments are ignored unless from_stdin.
+Stream_options extract_stream_options_from_option_arguments(std::vector<std::string>& option_arguments, bool from_stdin);
+
+// Remove the arguments that configure the output from the option arguments, and return
+// Output_options reflecting them. Throws std::invalid_argument for an unknown format.
+Output_options extract_output_options_from_option_arguments(std::vector<std::string>& option_arguments);
+
 #endif /* REGEX_HELPER_H */
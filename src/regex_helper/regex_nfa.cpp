@@ -0,0 +1,430 @@
+#include <regex_nfa.h>
+
+#include <algorithm>
+#include <deque>
+#include <regex>
+
+namespace
+{
+  // The most states an Nfa is given; a regex whose repetitions unroll into more is not compiled.
+  size_t const max_states = 10000;
+
+  // Compiles the nodes of a Regex_tree back to front, each onto the state that follows it.
+  class Nfa_compiler
+  {
+  public:
+    explicit Nfa_compiler(Nfa& nfa) : _nfa(nfa) {}
+
+    // Add the states of the node, followed by the next state, and return the first of them,
+    // or std::nullopt if the node cannot be compiled.
+    std::optional<size_t> compile(Regex_node const& node, size_t next);
+
+    // Add a state of the kind, followed by the next state, and return it.
+    std::optional<size_t> add(Nfa_state_kind kind, size_t next);
+
+  private:
+    std::optional<size_t> _compile_repetition(Regex_node const& node, size_t next);
+
+    Nfa& _nfa;
+  };
+
+  std::optional<size_t> Nfa_compiler::add(Nfa_state_kind kind, size_t next)
+  {
+    if (_nfa.states.size() >= max_states)
+      return std::nullopt;
+    Nfa_state state;
+    state.kind = kind;
+    state.next = next;
+    _nfa.states.push_back(std::move(state));
+    return _nfa.states.size() - 1;
+  }
+
+  std::optional<size_t> Nfa_compiler::compile(Regex_node const& node, size_t next)
+  {
+    switch (node.kind)
+    {
+      case Regex_node_kind::empty:
+        return next;
+
+      case Regex_node_kind::characters:
+      {
+        auto const state = add(Nfa_state_kind::characters, next);
+        if (state)
+          _nfa.states[*state].characters = node.characters;
+        return state;
+      }
+
+      case Regex_node_kind::concatenation:
+        for (auto child = node.children.rbegin(); child != node.children.rend(); ++child)
+        {
+          auto const first = compile(*child, next);
+          if (!first)
+            return std::nullopt;
+          next = *first;
+        }
+        return next;
+
+      case Regex_node_kind::alternation:
+      {
+        std::vector<size_t> alternatives;
+        for (auto const& child : node.children)
+        {
+          auto const first = compile(child, next);
+          if (!first)
+            return std::nullopt;
+          alternatives.push_back(*first);
+        }
+        auto const state = add(Nfa_state_kind::alternation, next);
+        if (state)
+          _nfa.states[*state].alternatives = std::move(alternatives);
+        return state;
+      }
+
+      case Regex_node_kind::repetition:
+        return _compile_repetition(node, next);
+
+      case Regex_node_kind::group:
+      {
+        auto const end = add(Nfa_state_kind::group_end, next);
+        if (!end)
+          return std::nullopt;
+        auto const body = compile(node.children.front(), *end);
+        if (!body)
+          return std::nullopt;
+        auto const begin = add(Nfa_state_kind::group_begin, *body);
+        if (begin)
+          _nfa.states[*begin].group = _nfa.states[*end].group = node.group;
+        return begin;
+      }
+
+      case Regex_node_kind::assertion:
+      {
+        auto const state = add(Nfa_state_kind::assertion, next);
+        if (state)
+          _nfa.states[*state].assertion = node.assertion;
+        return state;
+      }
+
+      case Regex_node_kind::backreference:
+      case Regex_node_kind::lookahead:
+      default:
+        return std::nullopt;
+    }
+  }
+
+  // As std::regex compiles them: x+ is x followed by a repetition back into the same x, and
+  // x{n,} is n copies of x followed by x*, whose repetition loops through a copy of its own.
+  // The Regex_tree does not tell x{1,} from x+, and both are compiled as x+.
+  // x{n,m} is n copies followed by m - n nested repetitions of x, each of which leads on to
+  // the next, and all of which lead out to what follows.
+  std::optional<size_t> Nfa_compiler::_compile_repetition(Regex_node const& node, size_t next)
+  {
+    Regex_node const& child = node.children.front();
+    if (node.max == 0)
+      return next;
+
+    size_t first = next;
+    if (node.max == Regex_node::unbounded)
+    {
+      auto const repetition = add(Nfa_state_kind::repetition, next);
+      if (!repetition)
+        return std::nullopt;
+      auto const body = compile(child, *repetition);
+      if (!body)
+        return std::nullopt;
+      _nfa.states[*repetition].body   = *body;
+      _nfa.states[*repetition].greedy = node.greedy;
+      if (node.min == 1)
+        return body;
+      first = *repetition;
+    }
+    else
+    {
+      for (size_t i = node.min; i < node.max; ++i)
+      {
+        auto const repetition = add(Nfa_state_kind::repetition, next);
+        if (!repetition)
+          return std::nullopt;
+        auto const body = compile(child, first);
+        if (!body)
+          return std::nullopt;
+        _nfa.states[*repetition].body   = *body;
+        _nfa.states[*repetition].greedy = node.greedy;
+        first = *repetition;
+      }
+    }
+
+    for (size_t i = 0; i < node.min; ++i)
+    {
+      auto const copy = compile(child, first);
+      if (!copy)
+        return std::nullopt;
+      first = *copy;
+    }
+    return first;
+  }
+
+  // The states a state goes on to without consuming a byte.
+  std::vector<size_t> empty_moves(Nfa_state const& state)
+  {
+    switch (state.kind)
+    {
+      case Nfa_state_kind::alternation:
+        return state.alternatives;
+      case Nfa_state_kind::repetition:
+        return {state.body, state.next};
+      case Nfa_state_kind::group_begin:
+      case Nfa_state_kind::group_end:
+      case Nfa_state_kind::assertion:
+        return {state.next};
+      case Nfa_state_kind::characters:
+      case Nfa_state_kind::accept:
+      default:
+        return {};
+    }
+  }
+
+  // The states a state goes on to, consuming a byte or not.
+  std::vector<size_t> moves(Nfa_state const& state)
+  {
+    if (state.kind == Nfa_state_kind::characters)
+      return {state.next};
+    return empty_moves(state);
+  }
+
+  // The strongly connected components of the states under the moves, found as Tarjan's
+  // algorithm finds them, with a stack of the states being visited in place of recursion.
+  // Return the component of each state, numbered in the order they are found, so that the
+  // states a state moves to are in its component or in one found before it. A component is
+  // cyclic if it has more than one state, or one that moves to itself.
+  template <typename Moves>
+  std::vector<size_t> strong_components(Nfa const& nfa, Moves const& moves_of, std::vector<bool>& cyclic)
+  {
+    size_t const        unvisited = static_cast<size_t>(-1);
+    size_t const        count     = nfa.states.size();
+    std::vector<size_t> order(count, unvisited);
+    std::vector<size_t> low(count, 0);
+    std::vector<bool>   on_stack(count, false);
+    std::vector<size_t> component;
+    std::vector<size_t> components(count, 0);
+    size_t              next_order = 0;
+    cyclic.clear();
+
+    struct Frame
+    {
+      size_t              state;
+      std::vector<size_t> moves;
+      size_t              move;
+    };
+
+    for (size_t root = 0; root < count; ++root)
+    {
+      if (order[root] != unvisited)
+        continue;
+
+      std::vector<Frame> frames;
+      auto enter = [&](size_t state)
+      {
+        order[state] = low[state] = next_order++;
+        component.push_back(state);
+        on_stack[state] = true;
+        frames.push_back(Frame{state, moves_of(nfa.states[state]), 0});
+      };
+      enter(root);
+      while (!frames.empty())
+      {
+        Frame& frame = frames.back();
+        if (frame.move < frame.moves.size())
+        {
+          size_t const target = frame.moves[frame.move++];
+          if (order[target] == unvisited)
+            enter(target);
+          else if (on_stack[target])
+            low[frame.state] = std::min(low[frame.state], order[target]);
+          continue;
+        }
+
+        size_t const state = frame.state;
+        bool const   loops = std::find(frame.moves.begin(), frame.moves.end(), state) != frame.moves.end();
+        frames.pop_back();
+        if (!frames.empty())
+          low[frames.back().state] = std::min(low[frames.back().state], low[state]);
+        if (low[state] != order[state])
+          continue;
+
+        auto const first = std::find(component.rbegin(), component.rend(), state).base() - 1;
+        for (auto member = first; member != component.end(); ++member)
+        {
+          components[*member] = cyclic.size();
+          on_stack[*member]   = false;
+        }
+        cyclic.push_back(component.end() - first > 1 || loops);
+        component.erase(first, component.end());
+      }
+    }
+    return components;
+  }
+
+  // Number the empty cycles as the cyclic components of the empty moves.
+  void number_empty_cycles(Nfa& nfa)
+  {
+    std::vector<bool>   cyclic;
+    auto const          components = strong_components(nfa, empty_moves, cyclic);
+    std::vector<size_t> cycles(cyclic.size(), Nfa_state::no_cycle);
+    size_t              cycle_count = 0;
+    for (size_t component = 0; component < cyclic.size(); ++component)
+    {
+      if (cyclic[component])
+        cycles[component] = cycle_count++;
+    }
+    for (size_t state = 0; state < nfa.states.size(); ++state)
+      nfa.states[state].cycle = cycles[components[state]];
+  }
+
+  size_t const unbounded = static_cast<size_t>(-1);
+
+  // The fewest bytes consumed on the way from each state to the accept state, found
+  // breadth-first back from it, a move that consumes a byte going to the back of the queue.
+  std::vector<size_t> min_lengths(Nfa const& nfa)
+  {
+    size_t const                     count = nfa.states.size();
+    std::vector<std::vector<size_t>> sources(count);
+    std::deque<size_t>               pending;
+    std::vector<size_t>              lengths(count, unbounded);
+    for (size_t state = 0; state < count; ++state)
+    {
+      for (size_t target : moves(nfa.states[state]))
+        sources[target].push_back(state);
+      if (nfa.states[state].kind == Nfa_state_kind::accept)
+      {
+        lengths[state] = 0;
+        pending.push_back(state);
+      }
+    }
+
+    while (!pending.empty())
+    {
+      size_t const state = pending.front();
+      pending.pop_front();
+      for (size_t source : sources[state])
+      {
+        bool const   consumes = nfa.states[source].kind == Nfa_state_kind::characters;
+        size_t const length   = lengths[state] + (consumes ? 1 : 0);
+        if (length >= lengths[source])
+          continue;
+        lengths[source] = length;
+        if (consumes)
+          pending.push_back(source);
+        else
+          pending.push_front(source);
+      }
+    }
+    return lengths;
+  }
+
+  // The most bytes consumed on the way from each state to the accept state, which is
+  // unbounded from a state that reaches a cycle, whether or not going round it consumes a
+  // byte. The components are found after those they move to, so each is done after them.
+  std::vector<size_t> max_lengths(Nfa const& nfa)
+  {
+    std::vector<bool>                cyclic;
+    auto const                       components = strong_components(nfa, moves, cyclic);
+    std::vector<std::vector<size_t>> members(cyclic.size());
+    std::vector<size_t>              lengths(nfa.states.size(), 0);
+    for (size_t state = 0; state < nfa.states.size(); ++state)
+      members[components[state]].push_back(state);
+
+    for (size_t component = 0; component < cyclic.size(); ++component)
+    {
+      for (size_t state : members[component])
+      {
+        if (cyclic[component])
+        {
+          lengths[state] = unbounded;
+          continue;
+        }
+        for (size_t target : moves(nfa.states[state]))
+          lengths[state] = std::max(lengths[state], lengths[target]);
+        if (lengths[state] != unbounded && nfa.states[state].kind == Nfa_state_kind::characters)
+          ++lengths[state];
+      }
+    }
+    return lengths;
+  }
+
+  // The bytes that may be consumed first on the way from the state, through the states it
+  // goes on to without consuming a byte.
+  Character_set first_bytes(Nfa const& nfa, size_t start)
+  {
+    Character_set       bytes;
+    std::vector<bool>   visited(nfa.states.size(), false);
+    std::vector<size_t> pending {start};
+    while (!pending.empty())
+    {
+      size_t const state = pending.back();
+      pending.pop_back();
+      if (visited[state])
+        continue;
+      visited[state] = true;
+      if (nfa.states[state].kind == Nfa_state_kind::characters)
+        bytes |= nfa.states[state].characters;
+      auto const targets = empty_moves(nfa.states[state]);
+      pending.insert(pending.end(), targets.begin(), targets.end());
+    }
+    return bytes;
+  }
+
+  // std::regex's search of a POSIX regex goes round a repetition once more before it leaves
+  // it, and only leaves it if going round finds no match, so it misses a longer match that
+  // leaving finds unless every match that goes round is longer than every match that leaves:
+  // because going round consumes more bytes than leaving may, or because going round
+  // consumes a byte and none of the bytes it may consume first are any leaving may.
+  bool finds_longest(Nfa const& nfa)
+  {
+    auto const min_length = min_lengths(nfa);
+    auto const max_length = max_lengths(nfa);
+    for (auto const& state : nfa.states)
+    {
+      if (state.kind != Nfa_state_kind::repetition)
+        continue;
+      if (!state.greedy)
+        return false;
+      if (max_length[state.next] != unbounded && max_length[state.next] < min_length[state.body])
+        continue;
+      if (min_length[state.body] == 0 || (first_bytes(nfa, state.body) & first_bytes(nfa, state.next)).any())
+        return false;
+    }
+    return true;
+  }
+}
+
+std::optional<Nfa> compile_nfa(Regex_tree const& tree)
+{
+  if (tree.multiline)
+    return std::nullopt;
+
+  Nfa nfa;
+  nfa.group_count = tree.group_count;
+  nfa.ecmascript  = tree.ecmascript;
+
+  Nfa_compiler compiler(nfa);
+  auto const   accept = compiler.add(Nfa_state_kind::accept, 0);
+  auto const   start  = accept ? compiler.compile(tree.root, *accept) : std::nullopt;
+  if (!start)
+    return std::nullopt;
+  nfa.start = *start;
+  number_empty_cycles(nfa);
+  nfa.finds_longest = !nfa.ecmascript && finds_longest(nfa);
+  return nfa;
+}
+
+std::array<bool, 256> word_bytes()
+{
+  std::regex_traits<char> const traits;
+  char const                    word_name[] = "w";
+  auto const                    word_class  = traits.lookup_classname(word_name, word_name + 1);
+  std::array<bool, 256>         word {};
+  for (size_t byte = 0; byte < 256; ++byte)
+    word[byte] = traits.isctype(static_cast<char>(byte), word_class);
+  return word;
+}
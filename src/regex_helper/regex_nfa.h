@@ -0,0 +1,71 @@
+#ifndef REGEX_NFA_H
+#define REGEX_NFA_H
+
+#include <array>
+#include <cstddef>
+#include <optional>
+#include <vector>
+
+#include <regex_syntax.h>
+
+// The kinds of Nfa_state.
+enum class Nfa_state_kind
+{
+  characters,  // Consumes one byte of its Character_set, and goes on to next.
+  alternation, // Goes on to each of its alternatives, tried in order.
+  repetition,  // Goes on to its body once more, and out to next, in the order greedy selects.
+  group_begin, // Goes on to next, where the capture of its group starts.
+  group_end,   // Goes on to next, where the capture of its group ends.
+  assertion,   // Goes on to next where its Regex_assertion holds.
+  accept       // Ends a match.
+};
+
+// An Nfa_state is a state of an Nfa. Which of the members mean anything depends on the kind.
+struct Nfa_state
+{
+  // The cycle of a state that lies on none.
+  static constexpr size_t no_cycle = static_cast<size_t>(-1);
+
+  Nfa_state_kind      kind         {Nfa_state_kind::accept};
+  Character_set       characters   {};                            // The bytes a characters state consumes.
+  size_t              next         {0};                           // The state that follows.
+  std::vector<size_t> alternatives {};                            // The states an alternation goes on to.
+  size_t              body         {0};                           // The first state of a repetition's body.
+  bool                greedy       {true};                        // Whether a repetition goes on to its body first.
+  size_t              group        {0};                           // The group a group state captures.
+  Regex_assertion     assertion    {Regex_assertion::line_begin};
+  size_t              cycle        {no_cycle};                    // The empty cycle the state lies on, if any.
+};
+
+// An Nfa is a regex compiled into states laid out as std::regex lays out its own: each
+// repetition is a state of its own, which std::regex enters at most twice at one position
+// of the text, and a repetition of at most n is unrolled into n nested optional ones. Run
+// in the same order, with the same limit on entering repetitions, its states reach the same
+// matches, in the same order, as std::regex does.
+//
+// The states that may be gone round and back to without consuming a byte, through a
+// repetition whose body may be empty, lie on an empty cycle, numbered from 0, which they
+// share. Where the states reached at one position go on to next depends on how often the
+// repetitions there have been entered at that position only if they are on the same cycle.
+//
+// std::regex's search of a POSIX regex only leaves a repetition if going round it once more
+// finds no match, and then keeps the longest match it finds. That is the longest match that
+// starts where it starts, unless going round may find a shorter match than leaving would.
+struct Nfa
+{
+  std::vector<Nfa_state> states        {};
+  size_t                 start         {0};
+  size_t                 group_count   {0};     // The number of capturing groups.
+  bool                   ecmascript    {true};  // Whether the grammar is ECMAScript, and so matches leftmost-first.
+  bool                   finds_longest {false}; // Whether std::regex's match of a POSIX regex is the longest that starts where it starts.
+};
+
+// Compile the Regex_tree into an Nfa. Return std::nullopt for a regex with back-references,
+// which no automaton matches, lookaheads or multiline, which it does not take, and for one
+// whose repetitions unroll into too many states.
+std::optional<Nfa> compile_nfa(Regex_tree const& tree);
+
+// The bytes std::regex takes as word characters for \b and \B.
+std::array<bool, 256> word_bytes();
+
+#endif /* REGEX_NFA_H */
@@ -104,12 +104,28 @@ std::regex_constants::match_flag_type Match_options::mask() const
          (_format_first_only ? std::regex_constants::format_first_only : no_mask);
 }
 
+Result_options::Result_options(bool   count,
+                               bool   count_groups,
+                               size_t max_matches,
+                               bool   exists)
+: _count        (count || count_groups),
+  _count_groups (count_groups),
+  _max_matches  (max_matches),
+  _exists       (exists)
+{}
+
 Regex_options::Regex_options(Algorithm      algorithm,
                              Match_options  match_options,
-                             Syntax_options syntax_options)
+                             Syntax_options syntax_options,
+                             bool           lines,
+                             Result_options result_options,
+                             Engine         engine)
 : _algorithm      (algorithm),
   _match_options  (match_options),
-  _syntax_options (syntax_options)
+  _syntax_options (syntax_options),
+  _lines          (lines),
+  _result_options (result_options),
+  _engine         (engine)
 {}
 
 std::string const& Regex_options::format_string() const
@@ -132,6 +148,14 @@ Regex_options create_regex_options_from_option_arguments(std::vector<std::string
 {
   // Algorithm options
   Algorithm algorithm {Algorithm::search};
+  bool      lines     {false};
+  Engine    engine    {Engine::std_regex};
+
+  // Result options
+  bool   count        {false};
+  bool   count_groups {false};
+  size_t max_matches  {0};
+  bool   exists       {false};
 
   // Grammar options
   Grammar grammar {Grammar::ecmascript};
@@ -167,6 +191,24 @@ Regex_options create_regex_options_from_option_arguments(std::vector<std::string
       algorithm = Algorithm::match;
     else if (arg == "--replace")
       algorithm = Algorithm::replace;
+    else if (arg == "--lines")
+      lines     = true;
+    else if (arg == "--engine=std")
+      engine    = Engine::std_regex;
+    else if (arg == "--engine=dfa")
+      engine    = Engine::dfa;
+
+    // Result options:
+    else if (arg == "--count")
+      count        = true;
+    else if (arg == "--count-groups")
+      count_groups = true;
+    else if (arg.find("--max-matches=") == 0)
+      max_matches  = std::stoul(arg.substr(std::string("--max-matches=").length()));
+    else if (arg == "--first")
+      max_matches  = 1;
+    else if (arg == "--exists")
+      exists       = true;
 
     // Match options:
     else if (arg == "--match-not-bol")
@@ -251,5 +293,10 @@ Regex_options create_regex_options_from_option_arguments(std::vector<std::string
                                        collate,
                                        multiline);
 
-  return Regex_options(algorithm, match_options, syntax_options);
+  auto result_options = Result_options(count,
+                                       count_groups,
+                                       max_matches,
+                                       exists);
+
+  return Regex_options(algorithm, match_options, syntax_options, lines, result_options, engine);
 }
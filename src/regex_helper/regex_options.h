@@ -3,6 +3,8 @@
 
 #include <regex>
 
+#include <document_writer.h>
+
 // Algorithms correspond to std::regex match algorithms.
 enum class Algorithm
 {
@@ -26,6 +28,13 @@ enum class Grammar
               //   newline '\n' as an alternation separator in addtion to '|'.
 };
 
+// Engines are the ways a Compiled_query may find the matches of its regex.
+enum class Engine
+{
+  std_regex, // std::regex alone.
+  dfa        // A Lazy_dfa finds where the matches are, and std::regex makes them, as it would have.
+};
+
 // Match_options contains options corresponding to std::regex_constants::match_flag_type constants.
 // It also contains the format string whose syntax is controlled by other Match_options.
 // The struct has a member function that returns the bitwise-OR'd std::regex_constants::match_flag_type.
@@ -49,7 +58,7 @@ struct Match_options
   std::string const&                    format_string() const;
   std::regex_constants::match_flag_type mask()          const;
 
-  friend std::ostream& operator<<(std::ostream& os, Match_options const& match_options);
+  friend void write_document(Document_writer& writer, Match_options const& match_options);
 
 private:
   bool _match_not_bol     {false}; // The first character in [first,last) will be treated as if it is not at the beginning of a line (i.e. ^ will not match [first,first)
@@ -93,7 +102,7 @@ struct Syntax_options
 
   std::regex_constants::syntax_option_type mask() const;
 
-  friend std::ostream& operator<<(std::ostream& os, Syntax_options const& syntax_options);
+  friend void write_document(Document_writer& writer, Syntax_options const& syntax_options);
 
 private:
   Grammar _grammar   {Grammar::ecmascript};
@@ -104,28 +113,69 @@ private:
   bool    _multiline {false}; // Specifies that ^ shall match the beginning of a line and $ shall match the end of a line, if the ECMAScript engine is selected.
 };
 
-// Regex_options is a struct containing Syntax_options, Match_options, and the selected std::regex
-// match algorithm to use. It can give the bitmasks of its options structs, and the match format string.
+// Result_options select how much of the outcome of the match and search algorithms is kept.
+// With count set, the matches are only counted, without being constructed or formatted. With
+// count_groups set as well, the count of matches in which each group took part is kept too.
+// A search stops as soon as it has found max_matches matches, unless that is 0. With exists
+// set, the only outcome kept is whether there is a match at all, and the search stops at the
+// first one.
+struct Result_options
+{
+  Result_options() = default;
+  Result_options(bool   count,
+                 bool   count_groups,
+                 size_t max_matches = 0,
+                 bool   exists      = false);
+
+  bool   count()        const { return _count;        };
+  bool   count_groups() const { return _count_groups; };
+  size_t max_matches()  const { return _max_matches;  };
+  bool   exists()       const { return _exists;       };
+
+  friend void write_document(Document_writer& writer, Result_options const& result_options);
+
+private:
+  bool   _count        {false}; // Only count the matches.
+  bool   _count_groups {false}; // Also count the matches in which each group took part.
+  size_t _max_matches  {0};     // Stop after this many matches, if not 0.
+  bool   _exists       {false}; // Only find out whether there is a match.
+};
+
+// Regex_options is a struct containing Syntax_options, Match_options, Result_options, and the selected
+// std::regex match algorithm to use. It can give the bitmasks of its options structs, and the match
+// format string. When lines is set, the match and search algorithms treat each newline-delimited line
+// of the text as a target sequence of its own. The engine selects how the matches are found, which
+// does not change what they are.
 struct Regex_options
 {
   Regex_options() = default;
+  Regex_options(Regex_options const&) = default;
   Regex_options(Regex_options&&) = default;
   Regex_options(Algorithm      algorithm,
                 Match_options  match_options,
-                Syntax_options syntax_options);
+                Syntax_options syntax_options,
+                bool           lines          = false,
+                Result_options result_options = Result_options(),
+                Engine         engine         = Engine::std_regex);
 
-  Algorithm algorithm() const { return _algorithm; };
+  Algorithm             algorithm()      const { return _algorithm;      };
+  bool                  lines()          const { return _lines;          };
+  Result_options const& result_options() const { return _result_options; };
+  Engine                engine()         const { return _engine;         };
 
   std::string const&                       format_string()      const;
   std::regex_constants::match_flag_type    match_flag_mask()    const;
   std::regex_constants::syntax_option_type syntax_option_mask() const;
 
-  friend std::ostream& operator<<(std::ostream& os, Regex_options const& regex_options);
+  friend void write_document(Document_writer& writer, Regex_options const& regex_options);
 
 private:
   Algorithm      _algorithm      {Algorithm::search};
   Match_options  _match_options  {};
   Syntax_options _syntax_options {};
+  bool           _lines          {false};
+  Result_options _result_options {};
+  Engine         _engine         {Engine::std_regex};
 };
 
 Regex_options create_regex_options_from_option_arguments(std::vector<std::string> const& option_arguments);
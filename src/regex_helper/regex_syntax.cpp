@@ -0,0 +1,860 @@
+#include <regex_syntax.h>
+
+#include <cstring>
+#include <locale>
+#include <string>
+#include <utility>
+
+namespace
+{
+  // Thrown within the parser for a regex it does not take, and caught by parse_regex().
+  struct Unsupported_regex {};
+
+  // The largest repetition count taken.
+  size_t const max_repetition_count = 1000;
+
+  enum class Token
+  {
+    ordinary,           // A character, with its value.
+    any,                // .
+    line_begin,         // ^
+    line_end,           // $
+    word_boundary,      // \b, or \B with the value "n".
+    quoted_class,       // \d, \D, \s, \S, \w or \W, with the letter as value.
+    backreference,      // With the digits as value.
+    group_begin,
+    non_capturing_begin,
+    lookahead_begin,    // With the value "n" for a negative lookahead.
+    group_end,
+    bracket_begin,
+    negated_bracket_begin,
+    bracket_end,
+    bracket_dash,
+    class_name,         // [:name:], with the name as value.
+    interval_begin,
+    count,              // With the digits as value.
+    comma,
+    interval_end,
+    star,
+    plus,
+    question,
+    alternation,
+    end
+  };
+
+  // A Regex_parser turns a regex into a Regex_tree the way the libstdc++ scanner and
+  // compiler turn it into an NFA: token by token, in the same three states (outside
+  // brackets, inside them and inside braces), under the same rules for each grammar.
+  class Regex_parser
+  {
+    enum class State
+    {
+      normal,
+      in_bracket,
+      in_brace
+    };
+
+    std::string_view               _regex            {};
+    size_t                         _position         {0};
+    std::ctype<char> const&        _ctype;
+    bool                           _ecmascript       {true};
+    bool                           _basic            {false}; // basic or grep
+    bool                           _awk              {false};
+    bool                           _icase            {false};
+    bool                           _nosubs           {false};
+    char const*                    _special          {""};    // The characters special outside brackets.
+    State                          _state            {State::normal};
+    bool                           _at_bracket_start {false};
+    Token                          _token            {Token::end};
+    std::string                    _token_value      {""};    // The value of the token.
+    std::string                    _value            {""};    // The value of the token last matched.
+    size_t                         _group_count      {0};
+    std::vector<size_t>            _open_groups      {};
+
+  public:
+    Regex_parser(std::string_view regex, std::regex_constants::syntax_option_type syntax);
+
+    Regex_tree parse();
+
+  private:
+    // The scanner.
+    void _advance();
+    void _scan_normal();
+    void _scan_in_bracket();
+    void _scan_in_brace();
+    void _eat_escape_ecmascript();
+    void _eat_escape_posix();
+    void _eat_escape_awk();
+    void _eat_class_name();
+    bool _match_token(Token token);
+
+    // The compiler.
+    Regex_node _disjunction();
+    Regex_node _alternative();
+    bool       _term(Regex_node& term);
+    bool       _assertion(Regex_node& assertion);
+    bool       _atom(Regex_node& atom);
+    bool       _quantifier(Regex_node& term);
+    bool       _try_char();
+    Regex_node _bracket(bool negated);
+
+    bool          _is_digit(char character) const { return _ctype.is(std::ctype_base::digit, character); };
+    char          _translate(char character) const;
+    Character_set _characters(char character) const;
+    Character_set _class(std::string const& name, bool negated) const;
+    size_t        _count_value() const;
+  };
+
+  Regex_node make_node(Regex_node_kind kind)
+  {
+    Regex_node node;
+    node.kind = kind;
+    return node;
+  }
+
+  Regex_node make_characters(Character_set const& characters)
+  {
+    Regex_node node = make_node(Regex_node_kind::characters);
+    node.characters = characters;
+    return node;
+  }
+
+  Regex_node make_assertion(Regex_assertion assertion)
+  {
+    Regex_node node = make_node(Regex_node_kind::assertion);
+    node.assertion = assertion;
+    return node;
+  }
+
+  // A node made of the nodes, which is the only one if there is only one.
+  Regex_node make_sequence(Regex_node_kind kind, std::vector<Regex_node>&& nodes)
+  {
+    if (nodes.size() == 1)
+      return std::move(nodes.front());
+
+    Regex_node node = make_node(nodes.empty() ? Regex_node_kind::empty : kind);
+    node.children   = std::move(nodes);
+    return node;
+  }
+
+  unsigned char to_byte(char character)
+  {
+    return static_cast<unsigned char>(character);
+  }
+}
+
+Regex_parser::Regex_parser(std::string_view regex, std::regex_constants::syntax_option_type syntax)
+: _regex      (regex),
+  _ctype      (std::use_facet<std::ctype<char>>(std::locale())),
+  _icase      ((syntax & std::regex_constants::icase)  != 0),
+  _nosubs     ((syntax & std::regex_constants::nosubs) != 0)
+{
+  using namespace std::regex_constants;
+
+  if (syntax & collate)
+    throw Unsupported_regex();
+
+  // As for std::basic_regex, no grammar means ECMAScript.
+  if (!(syntax & (ECMAScript | basic | extended | awk | grep | egrep)))
+    syntax |= ECMAScript;
+
+  _ecmascript = (syntax & ECMAScript) != 0;
+  _basic      = !_ecmascript && (syntax & (basic | grep)) != 0;
+  _awk        = !_ecmascript && (syntax & awk) != 0;
+  _special    = _ecmascript         ? "^$\\.*+?()[]{}|"
+              : (syntax & basic)    ? ".[\\*^$"
+              : (syntax & extended) ? ".[\\()*+?{|^$"
+              : (syntax & grep)     ? ".[\\*^$\n"
+              : (syntax & egrep)    ? ".[\\()*+?{|^$\n"
+              :                       ".[\\()*+?{|^$";
+}
+
+Regex_tree Regex_parser::parse()
+{
+  _advance();
+
+  Regex_tree tree;
+  tree.root = _disjunction();
+  if (!_match_token(Token::end))
+    throw Unsupported_regex();
+
+  tree.group_count = _group_count;
+  tree.ecmascript  = _ecmascript;
+  tree.icase       = _icase;
+  return tree;
+}
+
+void Regex_parser::_advance()
+{
+  if (_position == _regex.size())
+  {
+    _token = Token::end;
+    return;
+  }
+
+  switch (_state)
+  {
+    case State::normal:     _scan_normal();     break;
+    case State::in_bracket: _scan_in_bracket(); break;
+    case State::in_brace:   _scan_in_brace();   break;
+  }
+}
+
+// A NUL is special in every grammar, and is an ordinary character only in ECMAScript. In
+// basic and grep, "\(", "\)" and "\{" stand for what "(", ")" and "{" do in the others.
+void Regex_parser::_scan_normal()
+{
+  char character = _regex[_position++];
+
+  if (character != '\0' && std::strchr(_special, character) == nullptr)
+  {
+    _token = Token::ordinary;
+    _token_value.assign(1, character);
+    return;
+  }
+
+  if (character == '\\')
+  {
+    if (_position == _regex.size())
+      throw Unsupported_regex();
+
+    char const next = _regex[_position];
+    if (!_basic || (next != '(' && next != ')' && next != '{'))
+    {
+      if (_ecmascript)
+        _eat_escape_ecmascript();
+      else
+        _eat_escape_posix();
+      return;
+    }
+    character = _regex[_position++];
+  }
+
+  if (character == '(')
+  {
+    if (_ecmascript && _position < _regex.size() && _regex[_position] == '?')
+    {
+      if (++_position == _regex.size())
+        throw Unsupported_regex();
+
+      char const kind = _regex[_position++];
+      if (kind == ':')
+        _token = Token::non_capturing_begin;
+      else if (kind == '=' || kind == '!')
+      {
+        _token = Token::lookahead_begin;
+        _token_value.assign(1, kind == '!' ? 'n' : 'p');
+      }
+      else
+        throw Unsupported_regex();
+    }
+    else
+      _token = _nosubs ? Token::non_capturing_begin : Token::group_begin;
+  }
+  else if (character == ')')
+    _token = Token::group_end;
+  else if (character == '[')
+  {
+    _state            = State::in_bracket;
+    _at_bracket_start = true;
+    if (_position < _regex.size() && _regex[_position] == '^')
+    {
+      _token = Token::negated_bracket_begin;
+      ++_position;
+    }
+    else
+      _token = Token::bracket_begin;
+  }
+  else if (character == '{')
+  {
+    _state = State::in_brace;
+    _token = Token::interval_begin;
+  }
+  else if (character == '\0')
+  {
+    if (!_ecmascript)
+      throw Unsupported_regex();
+    _token = Token::ordinary;
+    _token_value.assign(1, character);
+  }
+  else if (character == ']' || character == '}')
+  {
+    _token = Token::ordinary;
+    _token_value.assign(1, character);
+  }
+  else
+  {
+    switch (character)
+    {
+      case '^':  _token = Token::line_begin;  break;
+      case '$':  _token = Token::line_end;    break;
+      case '.':  _token = Token::any;         break;
+      case '*':  _token = Token::star;        break;
+      case '+':  _token = Token::plus;        break;
+      case '?':  _token = Token::question;    break;
+      case '|':
+      case '\n': _token = Token::alternation; break;
+      default:   throw Unsupported_regex();
+    }
+  }
+}
+
+// In POSIX grammars, "]" right after "[" or "[^" is an ordinary character, while in
+// ECMAScript it closes the bracket. Only ECMAScript and awk have escapes in brackets.
+void Regex_parser::_scan_in_bracket()
+{
+  char const character = _regex[_position++];
+
+  if (character == '-')
+    _token = Token::bracket_dash;
+  else if (character == '[')
+  {
+    if (_position == _regex.size())
+      throw Unsupported_regex();
+
+    char const kind = _regex[_position];
+    if (kind == ':')
+    {
+      ++_position;
+      _eat_class_name();
+      _token = Token::class_name;
+    }
+    else if (kind == '.' || kind == '=')
+      throw Unsupported_regex();
+    else
+    {
+      _token = Token::ordinary;
+      _token_value.assign(1, character);
+    }
+  }
+  else if (character == ']' && (_ecmascript || !_at_bracket_start))
+  {
+    _token = Token::bracket_end;
+    _state = State::normal;
+  }
+  else if (character == '\\' && (_ecmascript || _awk))
+  {
+    if (_position == _regex.size())
+      throw Unsupported_regex();
+    if (_ecmascript)
+      _eat_escape_ecmascript();
+    else
+      _eat_escape_posix();
+  }
+  else
+  {
+    _token = Token::ordinary;
+    _token_value.assign(1, character);
+  }
+  _at_bracket_start = false;
+}
+
+void Regex_parser::_scan_in_brace()
+{
+  char const character = _regex[_position++];
+
+  if (_is_digit(character))
+  {
+    _token = Token::count;
+    _token_value.assign(1, character);
+    while (_position < _regex.size() && _is_digit(_regex[_position]))
+      _token_value += _regex[_position++];
+  }
+  else if (character == ',')
+    _token = Token::comma;
+  else if (_basic)
+  {
+    if (character != '\\' || _position == _regex.size() || _regex[_position] != '}')
+      throw Unsupported_regex();
+    ++_position;
+    _state = State::normal;
+    _token = Token::interval_end;
+  }
+  else if (character == '}')
+  {
+    _state = State::normal;
+    _token = Token::interval_end;
+  }
+  else
+    throw Unsupported_regex();
+}
+
+// Any escape not otherwise taken stands for the character itself, letters included. "\b"
+// is a backspace in brackets, and "\cX" stands for X.
+void Regex_parser::_eat_escape_ecmascript()
+{
+  char const character = _regex[_position++];
+
+  char const* const escapes = "0\0b\bf\fn\nr\rt\tv\v";
+  for (size_t i = 0; i < 14; i += 2)
+  {
+    if (escapes[i] == character && (character != 'b' || _state == State::in_bracket))
+    {
+      _token = Token::ordinary;
+      _token_value.assign(1, escapes[i + 1]);
+      return;
+    }
+  }
+
+  if (character == 'b' || character == 'B')
+  {
+    _token = Token::word_boundary;
+    _token_value.assign(1, character == 'B' ? 'n' : 'p');
+  }
+  else if (std::strchr("dDsSwW", character) != nullptr && character != '\0')
+  {
+    _token = Token::quoted_class;
+    _token_value.assign(1, character);
+  }
+  else if (character == 'c')
+  {
+    if (_position == _regex.size())
+      throw Unsupported_regex();
+    _token = Token::ordinary;
+    _token_value.assign(1, _regex[_position++]);
+  }
+  else if (character == 'x' || character == 'u')
+  {
+    int const digit_count = character == 'x' ? 2 : 4;
+    int       value       = 0;
+    for (int i = 0; i < digit_count; ++i)
+    {
+      if (_position == _regex.size() || !_ctype.is(std::ctype_base::xdigit, _regex[_position]))
+        throw Unsupported_regex();
+      char const digit = _ctype.tolower(_regex[_position++]);
+      value = value * 16 + (_is_digit(digit) ? digit - '0' : digit - 'a' + 10);
+    }
+    _token = Token::ordinary;
+    _token_value.assign(1, static_cast<char>(value));
+  }
+  else if (_is_digit(character))
+  {
+    _token = Token::backreference;
+    _token_value.assign(1, character);
+    while (_position < _regex.size() && _is_digit(_regex[_position]))
+      _token_value += _regex[_position++];
+  }
+  else
+  {
+    _token = Token::ordinary;
+    _token_value.assign(1, character);
+  }
+}
+
+// An escaped special character stands for itself. Basic and grep have the back-references
+// "\1" to "\9", and awk has escapes of its own. The escape of any other character is
+// undefined in POSIX, which libstdc++ rejects when built for strict ISO C++, and which is
+// not taken here either way.
+void Regex_parser::_eat_escape_posix()
+{
+  char const character = _regex[_position];
+
+  if (character != '\0' && std::strchr(_special, character) != nullptr)
+  {
+    _token = Token::ordinary;
+    _token_value.assign(1, character);
+  }
+  else if (_awk)
+  {
+    _eat_escape_awk();
+    return;
+  }
+  else if (_basic && _is_digit(character) && character != '0')
+  {
+    _token = Token::backreference;
+    _token_value.assign(1, character);
+  }
+  else
+    throw Unsupported_regex();
+  ++_position;
+}
+
+// Awk has the escapes of C, and up to three octal digits.
+void Regex_parser::_eat_escape_awk()
+{
+  char const character = _regex[_position++];
+
+  char const* const escapes = "\"\"//\\\\a\ab\bf\fn\nr\rt\tv\v";
+  for (size_t i = 0; i < 20; i += 2)
+  {
+    if (escapes[i] == character)
+    {
+      _token = Token::ordinary;
+      _token_value.assign(1, escapes[i + 1]);
+      return;
+    }
+  }
+
+  if (character < '0' || character > '7')
+    throw Unsupported_regex();
+
+  int value = character - '0';
+  for (int i = 0; i < 2 && _position < _regex.size() && _regex[_position] >= '0' && _regex[_position] <= '7'; ++i)
+    value = value * 8 + (_regex[_position++] - '0');
+  _token = Token::ordinary;
+  _token_value.assign(1, static_cast<char>(value));
+}
+
+// Eat "name:]" after "[:".
+void Regex_parser::_eat_class_name()
+{
+  _token_value.clear();
+  while (_position < _regex.size() && _regex[_position] != ':')
+    _token_value += _regex[_position++];
+
+  if (_regex.substr(_position, 2) != ":]")
+    throw Unsupported_regex();
+  _position += 2;
+}
+
+// Take the token if it is the one given, keeping its value.
+bool Regex_parser::_match_token(Token token)
+{
+  if (_token != token)
+    return false;
+  _value = _token_value;
+  _advance();
+  return true;
+}
+
+Regex_node Regex_parser::_disjunction()
+{
+  std::vector<Regex_node> alternatives;
+  alternatives.push_back(_alternative());
+  while (_match_token(Token::alternation))
+    alternatives.push_back(_alternative());
+  return make_sequence(Regex_node_kind::alternation, std::move(alternatives));
+}
+
+Regex_node Regex_parser::_alternative()
+{
+  std::vector<Regex_node> terms;
+  for (Regex_node term; _term(term); )
+    terms.push_back(std::move(term));
+  return make_sequence(Regex_node_kind::concatenation, std::move(terms));
+}
+
+// Assertions take no quantifiers, and atoms any number of them.
+bool Regex_parser::_term(Regex_node& term)
+{
+  if (_assertion(term))
+    return true;
+  if (!_atom(term))
+    return false;
+  while (_quantifier(term))
+    ;
+  return true;
+}
+
+bool Regex_parser::_assertion(Regex_node& assertion)
+{
+  if (_match_token(Token::line_begin))
+    assertion = make_assertion(Regex_assertion::line_begin);
+  else if (_match_token(Token::line_end))
+    assertion = make_assertion(Regex_assertion::line_end);
+  else if (_match_token(Token::word_boundary))
+    assertion = make_assertion(_value == "n" ? Regex_assertion::not_word_boundary : Regex_assertion::word_boundary);
+  else if (_match_token(Token::lookahead_begin))
+  {
+    bool const negated = _value == "n";
+
+    assertion         = make_node(Regex_node_kind::lookahead);
+    assertion.negated = negated;
+    assertion.children.push_back(_disjunction());
+    if (!_match_token(Token::group_end))
+      throw Unsupported_regex();
+  }
+  else
+    return false;
+  return true;
+}
+
+// In ECMAScript, a "?" right after a quantifier makes it lazy; elsewhere it is a quantifier
+// of its own.
+bool Regex_parser::_quantifier(Regex_node& term)
+{
+  Regex_node repetition = make_node(Regex_node_kind::repetition);
+
+  if (_match_token(Token::star))
+  {
+    repetition.min = 0;
+    repetition.max = Regex_node::unbounded;
+  }
+  else if (_match_token(Token::plus))
+  {
+    repetition.min = 1;
+    repetition.max = Regex_node::unbounded;
+  }
+  else if (_match_token(Token::question))
+  {
+    repetition.min = 0;
+    repetition.max = 1;
+  }
+  else if (_match_token(Token::interval_begin))
+  {
+    if (!_match_token(Token::count))
+      throw Unsupported_regex();
+    repetition.min = _count_value();
+    repetition.max = repetition.min;
+
+    if (_match_token(Token::comma))
+      repetition.max = _match_token(Token::count) ? _count_value() : Regex_node::unbounded;
+    if (!_match_token(Token::interval_end) || repetition.max < repetition.min)
+      throw Unsupported_regex();
+  }
+  else
+    return false;
+
+  repetition.greedy = !(_ecmascript && _match_token(Token::question));
+  repetition.children.push_back(std::move(term));
+  term = std::move(repetition);
+  return true;
+}
+
+// A back-reference must name a group that is already closed.
+bool Regex_parser::_atom(Regex_node& atom)
+{
+  if (_match_token(Token::any))
+  {
+    Character_set characters;
+    for (int byte = 0; byte < 256; ++byte)
+    {
+      char const translated = _translate(static_cast<char>(byte));
+      characters[static_cast<size_t>(byte)] = _ecmascript
+                                            ? translated != _translate('\n') && translated != _translate('\r')
+                                            : translated != _translate('\0');
+    }
+    atom = make_characters(characters);
+  }
+  else if (_try_char())
+    atom = make_characters(_characters(_value[0]));
+  else if (_match_token(Token::backreference))
+  {
+    size_t const group = _count_value();
+    if (group == 0 || group > _group_count)
+      throw Unsupported_regex();
+    for (size_t open_group : _open_groups)
+    {
+      if (open_group == group)
+        throw Unsupported_regex();
+    }
+    atom       = make_node(Regex_node_kind::backreference);
+    atom.group = group;
+  }
+  else if (_match_token(Token::quoted_class))
+    atom = make_characters(_class(_value, _ctype.is(std::ctype_base::upper, _value[0])));
+  else if (_match_token(Token::non_capturing_begin))
+  {
+    atom = _disjunction();
+    if (!_match_token(Token::group_end))
+      throw Unsupported_regex();
+  }
+  else if (_match_token(Token::group_begin))
+  {
+    size_t const group = ++_group_count;
+    _open_groups.push_back(group);
+
+    atom       = make_node(Regex_node_kind::group);
+    atom.group = group;
+    atom.children.push_back(_disjunction());
+    if (!_match_token(Token::group_end))
+      throw Unsupported_regex();
+    _open_groups.pop_back();
+  }
+  else if (_match_token(Token::bracket_begin))
+    atom = _bracket(false);
+  else if (_match_token(Token::negated_bracket_begin))
+    atom = _bracket(true);
+  else
+    return false;
+  return true;
+}
+
+bool Regex_parser::_try_char()
+{
+  return _match_token(Token::ordinary);
+}
+
+// The bracket's characters, ranges and classes are gathered as libstdc++'s _BracketMatcher
+// gathers them, and then every byte is tested against them as it would be. A "-" is
+// ordinary first and last, and, in ECMAScript only, right after a range.
+Regex_node Regex_parser::_bracket(bool negated)
+{
+  std::vector<char>                  characters;
+  std::vector<std::pair<char, char>> ranges;
+  Character_set                      classes;
+
+  std::optional<char> last_char;
+  bool                last_class = false;
+
+  auto push_char = [&](char character)
+  {
+    if (last_char)
+      characters.push_back(*last_char);
+    last_char  = character;
+    last_class = false;
+  };
+  auto push_class = [&](Character_set const& class_characters)
+  {
+    if (last_char)
+      characters.push_back(*last_char);
+    last_char.reset();
+    last_class = true;
+    classes   |= class_characters;
+  };
+
+  if (_try_char())
+    last_char = _value[0];
+  else if (_match_token(Token::bracket_dash))
+    last_char = '-';
+
+  while (!_match_token(Token::bracket_end))
+  {
+    if (_match_token(Token::class_name))
+      push_class(_class(_value, false));
+    else if (_try_char())
+      push_char(_value[0]);
+    else if (_match_token(Token::bracket_dash))
+    {
+      if (_match_token(Token::bracket_end))
+      {
+        push_char('-');
+        break;
+      }
+      if (last_class)
+        throw Unsupported_regex();
+      if (last_char)
+      {
+        char last = '-';
+        if (_try_char())
+          last = _value[0];
+        else if (!_match_token(Token::bracket_dash))
+          throw Unsupported_regex();
+        if (*last_char > last)
+          throw Unsupported_regex();
+        ranges.emplace_back(*last_char, last);
+        last_char.reset();
+        last_class = false;
+      }
+      else if (_ecmascript)
+        push_char('-');
+      else
+        throw Unsupported_regex();
+    }
+    else if (_match_token(Token::quoted_class))
+      push_class(_class(_value, _ctype.is(std::ctype_base::upper, _value[0])));
+    else
+      throw Unsupported_regex();
+  }
+  if (last_char)
+    characters.push_back(*last_char);
+
+  Character_set matched = classes;
+  for (char character : characters)
+    matched |= _characters(character);
+  for (int byte = 0; byte < 256; ++byte)
+  {
+    char const character = static_cast<char>(byte);
+    char const lower     = _icase ? _ctype.tolower(character) : character;
+    char const upper     = _icase ? _ctype.toupper(character) : character;
+    for (auto const& [first, last] : ranges)
+    {
+      if ((first <= lower && lower <= last) || (first <= upper && upper <= last))
+        matched.set(static_cast<size_t>(byte));
+    }
+  }
+  if (negated)
+    matched.flip();
+  return make_characters(matched);
+}
+
+char Regex_parser::_translate(char character) const
+{
+  return _icase ? _ctype.tolower(character) : character;
+}
+
+// The bytes that match the character, every case of it under icase.
+Character_set Regex_parser::_characters(char character) const
+{
+  Character_set characters;
+  char const    translated = _translate(character);
+  for (int byte = 0; byte < 256; ++byte)
+  {
+    if (_translate(static_cast<char>(byte)) == translated)
+      characters.set(static_cast<size_t>(byte));
+  }
+  return characters;
+}
+
+// The bytes in the named class, as regex_traits looks it up: by its lowercased name, with
+// "d", "s" and "w" for the classes of "\d", "\s" and "\w", and "lower" and "upper" meaning
+// "alpha" under icase. A negated class holds the bytes not in the class.
+Character_set Regex_parser::_class(std::string const& name, bool negated) const
+{
+  static std::pair<char const*, std::ctype_base::mask> const classes[] =
+  {
+    {"d",      std::ctype_base::digit},
+    {"w",      std::ctype_base::alnum},
+    {"s",      std::ctype_base::space},
+    {"alnum",  std::ctype_base::alnum},
+    {"alpha",  std::ctype_base::alpha},
+    {"blank",  std::ctype_base::blank},
+    {"cntrl",  std::ctype_base::cntrl},
+    {"digit",  std::ctype_base::digit},
+    {"graph",  std::ctype_base::graph},
+    {"lower",  std::ctype_base::lower},
+    {"print",  std::ctype_base::print},
+    {"punct",  std::ctype_base::punct},
+    {"space",  std::ctype_base::space},
+    {"upper",  std::ctype_base::upper},
+    {"xdigit", std::ctype_base::xdigit},
+  };
+
+  std::string lowered;
+  for (char character : name)
+    lowered += _ctype.tolower(character);
+
+  for (auto const& [class_name, class_mask] : classes)
+  {
+    if (lowered != class_name)
+      continue;
+
+    auto mask = class_mask;
+    if (_icase && (mask & (std::ctype_base::lower | std::ctype_base::upper)) != 0)
+      mask = std::ctype_base::alpha;
+
+    Character_set characters;
+    for (int byte = 0; byte < 256; ++byte)
+    {
+      char const character = static_cast<char>(byte);
+      bool const in_class  = _ctype.is(mask, character) || (lowered == "w" && character == '_');
+      characters[to_byte(character)] = in_class != negated;
+    }
+    return characters;
+  }
+  throw Unsupported_regex();
+}
+
+size_t Regex_parser::_count_value() const
+{
+  if (_value.size() > 4)
+    throw Unsupported_regex();
+  size_t const count = std::stoul(_value);
+  if (count > max_repetition_count)
+    throw Unsupported_regex();
+  return count;
+}
+
+std::optional<Regex_tree> parse_regex(std::string_view regex, std::regex_constants::syntax_option_type syntax)
+{
+  try
+  {
+    Regex_tree tree = Regex_parser(regex, syntax).parse();
+    tree.multiline  = tree.ecmascript && (syntax & std::regex_constants::multiline) != 0;
+    return tree;
+  }
+  catch (Unsupported_regex const&)
+  {
+    return std::nullopt;
+  }
+}
@@ -0,0 +1,72 @@
+#ifndef REGEX_SYNTAX_H
+#define REGEX_SYNTAX_H
+
+#include <bitset>
+#include <cstddef>
+#include <optional>
+#include <regex>
+#include <string_view>
+#include <vector>
+
+// A Character_set holds the bytes that one character of a regex matches, indexed as
+// unsigned char.
+using Character_set = std::bitset<256>;
+
+// The kinds of Regex_node.
+enum class Regex_node_kind
+{
+  empty,          // Matches the empty string.
+  characters,     // Matches one byte of its Character_set.
+  concatenation,  // Matches each child in turn.
+  alternation,    // Matches one of the children, tried in order.
+  repetition,     // Matches its child between min and max times.
+  group,          // Matches its child, and captures what it matched as its group.
+  assertion,      // Matches the empty string where its Regex_assertion holds.
+  backreference,  // Matches the text its group last captured.
+  lookahead       // Matches the empty string where its child matches next, or does not.
+};
+
+// The assertions that hold between two characters: ^, $, \b and \B.
+enum class Regex_assertion
+{
+  line_begin,
+  line_end,
+  word_boundary,
+  not_word_boundary
+};
+
+// A Regex_node is a node of the syntax tree of a regex. Which of the members mean anything
+// depends on the kind.
+struct Regex_node
+{
+  static constexpr size_t unbounded = static_cast<size_t>(-1);
+
+  Regex_node_kind         kind       {Regex_node_kind::empty};
+  Character_set           characters {};                           // The bytes a characters node matches.
+  std::vector<Regex_node> children   {};
+  size_t                  min        {0};                          // The least number of repetitions.
+  size_t                  max        {0};                          // The most, or unbounded.
+  bool                    greedy     {true};                       // Whether a repetition tries more repetitions first.
+  size_t                  group      {0};                          // The group a group node captures, or a backreference repeats.
+  Regex_assertion         assertion  {Regex_assertion::line_begin};
+  bool                    negated    {false};                      // Whether a lookahead matches where its child does not.
+};
+
+// A Regex_tree is a regex parsed under the syntax options it is compiled with.
+struct Regex_tree
+{
+  Regex_node root        {};
+  size_t     group_count {0};     // The number of capturing groups.
+  bool       ecmascript  {true};  // Whether the grammar is ECMAScript, and so matches leftmost-first.
+  bool       icase       {false}; // Whether the Character_sets hold every case of their letters.
+  bool       multiline   {false}; // Whether ^ and $ also hold next to a line terminator.
+};
+
+// Parse the regex under the grammar of the syntax options, as std::regex parses it in the
+// global locale, each character set holding exactly the bytes std::regex would match with
+// it. Return std::nullopt for a regex std::regex would reject, and for one the parser does
+// not take: one using collating elements, equivalence classes or the collate option, or
+// whose repetition counts run to thousands.
+std::optional<Regex_tree> parse_regex(std::string_view regex, std::regex_constants::syntax_option_type syntax);
+
+#endif /* REGEX_SYNTAX_H */
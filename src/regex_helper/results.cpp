@@ -10,14 +10,41 @@ Match_results::Match_results(Match&& match)
 {}
 
 Search_results::Search_results(std::vector<Match>&& matches)
-: Results(Algorithm::search)
-{
-  for (auto& match : matches)
-    _matches.emplace_back(std::move(match));
-  _match_count = _matches.size();
-}
+: Results(Algorithm::search),
+  _match_count(matches.size()),
+  _matches(std::move(matches))
+{}
+
+Search_table_results::Search_table_results(Match_table&& match_table)
+: Results(Algorithm::search),
+  _match_table(std::move(match_table))
+{}
+
+Count_results::Count_results(Algorithm algorithm, size_t match_count, std::vector<size_t>&& group_counts)
+: Results(algorithm),
+  _match_count  (match_count),
+  _group_counts (std::move(group_counts))
+{}
+
+Exists_results::Exists_results(Algorithm algorithm, bool exists)
+: Results(algorithm),
+  _exists (exists)
+{}
 
 Replace_results::Replace_results(std::string&& replaced_text)
 : Results(Algorithm::replace),
   _replaced_text(std::move(replaced_text))
 {}
+
+Line::Line(size_t line_number, size_t position, size_t length, std::vector<Match>&& matches)
+: _line_number (line_number),
+  _position    (position),
+  _length      (length),
+  _matches     (std::move(matches))
+{}
+
+Line_results::Line_results(Algorithm algorithm, size_t line_count, std::vector<Line>&& lines)
+: Results(algorithm),
+  _line_count (line_count),
+  _lines      (std::move(lines))
+{}
@@ -2,12 +2,15 @@
 #define RESULTS_H
 
 #include <iostream>
+#include <memory>
 
 #include <match.h>
+#include <match_table.h>
 #include <regex_options.h>
 
 // The Results struct is an ancestor meant to hold common information among Results.
-// The only common information is the algorithm type.
+// The common information is the algorithm type, and the owner of the source text when
+// the Submatches view it rather than copy it, which the Results keep alive with them.
 struct Results
 {
   Results() = delete;
@@ -16,10 +19,13 @@ struct Results
 
   Algorithm algorithm() const { return _algorithm; };
 
-  friend std::ostream& operator<<(std::ostream& os, Results const& results);
+  void keep_text_alive(std::shared_ptr<void const> text_owner) { _text_owner = std::move(text_owner); };
+
+  friend void write_document(Document_writer& writer, Results const& results);
 
 private:
-  Algorithm _algorithm{Algorithm::match};
+  Algorithm                   _algorithm  {Algorithm::match};
+  std::shared_ptr<void const> _text_owner {nullptr};
 };
 
 // Match_results are Results that have a single Match that may or may not be successful.
@@ -28,7 +34,7 @@ struct Match_results : Results
   Match_results() = delete;
   Match_results(Match&& match);
 
-  friend std::ostream& operator<<(std::ostream& os, Match_results const& match_results);
+  friend void write_document(Document_writer& writer, Match_results const& match_results);
 
   Match const& match() const { return _match; }
 
@@ -44,7 +50,7 @@ struct Search_results : Results
   Search_results() = delete;
   Search_results(std::vector<Match>&& matches);
 
-  friend std::ostream& operator<<(std::ostream& os, Search_results const& search_results);
+  friend void write_document(Document_writer& writer, Search_results const& search_results);
 
   size_t                    match_count() const { return _match_count; }
   std::vector<Match> const& matches()     const { return _matches; }
@@ -54,6 +60,55 @@ private:
   std::vector<Match> _matches     {};
 };
 
+// Search_table_results are the Results of a search like Search_results, but with the Matches
+// held in the columns of a Match_table. They are written out exactly as Search_results are.
+struct Search_table_results : Results
+{
+  Search_table_results() = delete;
+  Search_table_results(Match_table&& match_table);
+
+  friend void write_document(Document_writer& writer, Search_table_results const& search_table_results);
+
+  size_t             match_count() const { return _match_table.match_count(); }
+  Match_table const& match_table() const { return _match_table; }
+
+private:
+  Match_table _match_table {};
+};
+
+// Count_results are the Results of the match or search algorithm when the matches are only
+// counted. When asked for, the group counts hold the number of matches in which each group
+// took part, indexed as the Submatches of a Match are, so the first is the match count.
+struct Count_results : Results
+{
+  Count_results() = delete;
+  Count_results(Algorithm algorithm, size_t match_count, std::vector<size_t>&& group_counts = {});
+
+  friend void write_document(Document_writer& writer, Count_results const& count_results);
+
+  size_t                     match_count()  const { return _match_count; }
+  std::vector<size_t> const& group_counts() const { return _group_counts; }
+
+private:
+  size_t              _match_count  {0};
+  std::vector<size_t> _group_counts {};
+};
+
+// Exists_results are the Results of the match or search algorithm when all that is kept is
+// whether the regex matched at all.
+struct Exists_results : Results
+{
+  Exists_results() = delete;
+  Exists_results(Algorithm algorithm, bool exists);
+
+  friend void write_document(Document_writer& writer, Exists_results const& exists_results);
+
+  bool exists() const { return _exists; }
+
+private:
+  bool _exists {false};
+};
+
 // Replace_results are Results with a single piece of information: the target
 // text sequence, with all regex matches replaced as specified by the format options.
 struct Replace_results : Results
@@ -61,7 +116,7 @@ struct Replace_results : Results
   Replace_results() = delete;
   Replace_results(std::string&& replaced_text);
 
-  friend std::ostream& operator<<(std::ostream& os, Replace_results const& replace_results);
+  friend void write_document(Document_writer& writer, Replace_results const& replace_results);
 
   std::string const& replaced_text() const { return _replaced_text; }
 
@@ -69,4 +124,45 @@ private:
   std::string _replaced_text {""};
 };
 
+// A Line is a newline-delimited line of the text in which the regex matched, when the
+// algorithm runs line by line. It knows its 1-based line number and the position and
+// length of the line in the larger text. For a search it holds every Match in the line;
+// for a match it holds the single successful Match.
+struct Line
+{
+  Line() = delete;
+  Line(size_t line_number, size_t position, size_t length, std::vector<Match>&& matches);
+
+  friend void write_document(Document_writer& writer, Line const& line);
+
+  size_t                    line_number() const { return _line_number; }
+  size_t                    position()    const { return _position; }
+  size_t                    length()      const { return _length; }
+  std::vector<Match> const& matches()     const { return _matches; }
+
+private:
+  size_t             _line_number {0};
+  size_t             _position    {0};
+  size_t             _length      {0};
+  std::vector<Match> _matches     {};
+};
+
+// Line_results are the Results of running the match or search algorithm on each line of the
+// text separately. Only the Lines in which the regex matched are kept, in text order.
+struct Line_results : Results
+{
+  Line_results() = delete;
+  Line_results(Algorithm algorithm, size_t line_count, std::vector<Line>&& lines);
+
+  friend void write_document(Document_writer& writer, Line_results const& line_results);
+
+  size_t                   line_count()         const { return _line_count; }
+  size_t                   matched_line_count() const { return _lines.size(); }
+  std::vector<Line> const& lines()              const { return _lines; }
+
+private:
+  size_t            _line_count {0};
+  std::vector<Line> _lines      {};
+};
+
 #endif /* RESULTS_H */
@@ -1,261 +1,378 @@
 #include <stream_insert_overloads.h>
 
-// Only acceptable escape sequences in JSON strings: '\b', '\f', '\n', '\r', '\t', '\"', '\\'
-bool is_valid_json_string_escape_sequence(char escaped_character)
+namespace
 {
-  if (escaped_character == 'b'  ||
-      escaped_character == 'f'  ||
-      escaped_character == 'n'  ||
-      escaped_character == 'r'  ||
-      escaped_character == 't'  ||
-      escaped_character == '"'  ||
-      escaped_character == '\\')
+  std::string_view algorithm_name(Algorithm algorithm)
   {
-    return true;
+    switch (algorithm)
+    {
+      case Algorithm::match:
+        return "match";
+      case Algorithm::search:
+        return "search";
+      case Algorithm::replace:
+        return "replace";
+      default:
+        return "";
+    }
   }
-  return false;
-}
 
-// Look through the input string and return a new string built by adding escapes (\)
-// to the text such that the result forms a valid string value in a JSON object.
-// Assume that all characters in the string are escaped as intended for the regex engine.
-std::string escape_for_json(std::string const& s)
-{
-  std::string res;
-  std::string::const_iterator it = s.begin();
-  while (it != s.end())
+  std::string_view grammar_name(Grammar grammar)
   {
-    char current = *it;
-    if (current == '\\' && it != s.end())
+    switch (grammar)
     {
-      ++it;
-      char next = *it;
-      if (is_valid_json_string_escape_sequence(next))
-      {
-        // Move along as-is since the sequence is valid.
-        res += current;
-      }
-      else
-      {
-        // Not valid, so escape the backslash so that the JSON is valid.
-        res += '\\';
-        res += current;
-      }
+      case Grammar::ecmascript:
+        return "ecmascript";
+      case Grammar::basic:
+        return "basic";
+      case Grammar::extended:
+        return "extended";
+      case Grammar::awk:
+        return "awk";
+      case Grammar::grep:
+        return "grep";
+      case Grammar::egrep:
+        return "egrep";
+      default:
+        return "";
     }
-    else if (current == '"' && it != s.end())
+  }
+
+  std::string_view engine_name(Engine engine)
+  {
+    switch (engine)
     {
-      res += '\\';
+      case Engine::std_regex:
+        return "std";
+      case Engine::dfa:
+        return "dfa";
+      default:
+        return "";
     }
-    res += *it;
-    ++it;
   }
-  return res;
-}
 
-std::ostream& operator<<(std::ostream& os, Algorithm algorithm)
-{
-  switch (algorithm)
+  // Write an array with each element written by the function.
+  template <typename Elements, typename Write_element>
+  void write_document_array(Document_writer& writer, Elements const& elements, Write_element write_element)
   {
-    case Algorithm::match:
-      os << "match";
-      break;
-    case Algorithm::search:
-      os << "search";
-      break;
-    case Algorithm::replace:
-      os << "replace";
-      break;
-    default:
-      break;
+    writer.begin_array(elements.size());
+    for (auto const& element : elements)
+      write_element(element);
+    writer.end_array();
   }
+}
 
-  return os;
+std::ostream& operator<<(std::ostream& os, Algorithm algorithm)
+{
+  return os << algorithm_name(algorithm);
 }
 
 std::ostream& operator<<(std::ostream& os, Grammar grammar)
 {
-  switch (grammar)
-  {
-    case Grammar::ecmascript:
-      os << "ecmascript";
-      break;
-    case Grammar::basic:
-      os << "basic";
-      break;
-    case Grammar::extended:
-      os << "extended";
-      break;
-    case Grammar::awk:
-      os << "awk";
-      break;
-    case Grammar::grep:
-      os << "grep";
-      break;
-    case Grammar::egrep:
-      os << "egrep";
-      break;
-    default:
-      break;
-  }
+  return os << grammar_name(grammar);
+}
 
-  return os;
+void write_document(Document_writer& writer, Result_options const& result_options)
+{
+  writer.begin_object(4);
+  writer.key("count");        writer.boolean(result_options.count());
+  writer.key("count_groups"); writer.boolean(result_options.count_groups());
+  writer.key("exists");       writer.boolean(result_options.exists());
+  writer.key("max_matches");  writer.number (result_options.max_matches());
+  writer.end_object();
 }
 
-std::ostream& operator<<(std::ostream& os, Regex_options const& regex_options)
+void write_document(Document_writer& writer, Regex_options const& regex_options)
 {
-  os << "{"                                                                   << "\n";
-  os << "\"algorithm\": "      << '"' << regex_options._algorithm      << '"' << ",\n";
-  os << "\"syntax_options\": "        << regex_options._syntax_options        << ",\n";
-  os << "\"match_options\": "         << regex_options._match_options         << "\n";
-  os << "}";
-  return os;
+  writer.begin_object(6);
+  writer.key("algorithm");      writer.string (algorithm_name(regex_options._algorithm));
+  writer.key("engine");         writer.string (engine_name(regex_options._engine));
+  writer.key("lines");          writer.boolean(regex_options._lines);
+  writer.key("match_options");  write_document(writer, regex_options._match_options);
+  writer.key("result_options"); write_document(writer, regex_options._result_options);
+  writer.key("syntax_options"); write_document(writer, regex_options._syntax_options);
+  writer.end_object();
 }
 
-std::ostream& operator<<(std::ostream& os, Syntax_options const& syntax_options)
+void write_document(Document_writer& writer, Syntax_options const& syntax_options)
 {
-  std::string const t = "true",
-                    f = "false";
-  os << "{"                                                                    << "\n";
-  os << "\"grammar\": "   << '"' << syntax_options._grammar             << '"' << ",\n";
-  os << "\"icase\": "            << (syntax_options._icase     ? t : f)        << ",\n";
-  os << "\"nosubs\": "           << (syntax_options._nosubs    ? t : f)        << ",\n";
-  os << "\"optimize\": "         << (syntax_options._optimize  ? t : f)        << ",\n";
-  os << "\"collate\": "          << (syntax_options._collate   ? t : f)        << ",\n";
-  os << "\"multiline\": "        << (syntax_options._multiline ? t : f)        << "\n";
-  os << "}";
-  return os;
+  writer.begin_object(6);
+  writer.key("collate");   writer.boolean(syntax_options._collate);
+  writer.key("grammar");   writer.string (grammar_name(syntax_options._grammar));
+  writer.key("icase");     writer.boolean(syntax_options._icase);
+  writer.key("multiline"); writer.boolean(syntax_options._multiline);
+  writer.key("nosubs");    writer.boolean(syntax_options._nosubs);
+  writer.key("optimize");  writer.boolean(syntax_options._optimize);
+  writer.end_object();
 }
 
-std::ostream& operator<<(std::ostream& os, Match_options const& match_options)
+void write_document(Document_writer& writer, Match_options const& match_options)
 {
-  std::string const t = "true",
-                    f = "false";
-  os << "{"                                                                                      << "\n";
-  os << "\"match_not_bol\": "            << (match_options._match_not_bol     ? t : f)           << ",\n";
-  os << "\"match_not_eol\": "            << (match_options._match_not_eol     ? t : f)           << ",\n";
-  os << "\"match_not_bow\": "            << (match_options._match_not_bow     ? t : f)           << ",\n";
-  os << "\"match_not_eow\": "            << (match_options._match_not_eow     ? t : f)           << ",\n";
-  os << "\"match_any\": "                << (match_options._match_any         ? t : f)           << ",\n";
-  os << "\"match_not_null\": "           << (match_options._match_not_null    ? t : f)           << ",\n";
-  os << "\"match_continuous\": "         << (match_options._match_continuous  ? t : f)           << ",\n";
-  os << "\"match_prev_avail\": "         << (match_options._match_prev_avail  ? t : f)           << ",\n";
-  os << "\"format_default\": "           << (match_options._format_default    ? t : f)           << ",\n";
-  os << "\"format_sed\": "               << (match_options._format_sed        ? t : f)           << ",\n";
-  os << "\"format_no_copy\": "           << (match_options._format_no_copy    ? t : f)           << ",\n";
-  os << "\"format_first_only\": "        << (match_options._format_first_only ? t : f)           << ",\n";
-  os << "\"format_string\": "     << '"' << escape_for_json(match_options._format_string) << '"' << "\n";
-  os << "}";
-  return os;
+  writer.begin_object(13);
+  writer.key("format_default");    writer.boolean(match_options._format_default);
+  writer.key("format_first_only"); writer.boolean(match_options._format_first_only);
+  writer.key("format_no_copy");    writer.boolean(match_options._format_no_copy);
+  writer.key("format_sed");        writer.boolean(match_options._format_sed);
+  writer.key("format_string");     writer.string (match_options._format_string);
+  writer.key("match_any");         writer.boolean(match_options._match_any);
+  writer.key("match_continuous");  writer.boolean(match_options._match_continuous);
+  writer.key("match_not_bol");     writer.boolean(match_options._match_not_bol);
+  writer.key("match_not_bow");     writer.boolean(match_options._match_not_bow);
+  writer.key("match_not_eol");     writer.boolean(match_options._match_not_eol);
+  writer.key("match_not_eow");     writer.boolean(match_options._match_not_eow);
+  writer.key("match_not_null");    writer.boolean(match_options._match_not_null);
+  writer.key("match_prev_avail");  writer.boolean(match_options._match_prev_avail);
+  writer.end_object();
 }
 
-std::ostream& operator<<(std::ostream& os, Submatch const& submatch)
+void write_document(Document_writer& writer, Submatch const& submatch)
 {
-  os << "{"                                                                 << "\n";
-  os << "\"length\": "            << submatch._length                       << ",\n";
-  os << "\"text\": "       << '"' << escape_for_json(submatch._text) << '"' << ",\n";
-  os << "\"position\": "          << submatch._position                     << "\n";
-  os << "}";
-  return os;
-};
+  writer.begin_object(3);
+  writer.key("length");   writer.number(submatch.length());
+  writer.key("position"); writer.position(submatch.position());
+  writer.key("text");     writer.string(submatch.text());
+  writer.end_object();
+}
 
-std::ostream& operator<<(std::ostream& os, Match const& match)
+// match_successful is written as a string, as it always has been.
+void write_document(Document_writer& writer, Match const& match)
 {
-  std::string match_successful_str = match._match_successful ? "true" : "false";
+  writer.begin_object(5);
+  writer.key("formatted_string");        writer.string(match.formatted_string());
+  writer.key("match_successful");        writer.string(match.match_successful() ? "true" : "false");
+  writer.key("max_possible_submatches"); writer.number(match.max_possible_submatches());
+  writer.key("submatch_count");          writer.number(match.submatch_count());
+  writer.key("submatches");
+  write_document_array(writer, match.submatches(), [&](Submatch const& submatch) { write_document(writer, submatch); });
+  writer.end_object();
+}
 
-  os << "{"                                                                                       << "\n";
-  os << "\"match_successful\": "        << '"' << match_successful_str                     << '"' << ",\n";
-  os << "\"max_possible_submatches\": "        << match._max_possible_submatches                  << ",\n";
-  os << "\"submatch_count\": "                 << match._submatch_count                           << ",\n";
-  os << "\"formatted_string\": "        << '"' << escape_for_json(match._formatted_string) << '"' << ",\n"; 
-  os << "\"submatches\": ["                                                                       << "\n";
-  for (size_t i = 0; i < match._submatch_count; ++i)
+void write_document(Document_writer& writer, Capture_spans const& match, std::string_view formatted_string, size_t position_offset)
+{
+  writer.begin_object(5);
+  writer.key("formatted_string");        writer.string(formatted_string);
+  writer.key("match_successful");        writer.string("true");
+  writer.key("max_possible_submatches"); writer.number(Capture_spans::max_size());
+  writer.key("submatch_count");          writer.number(match.size());
+  writer.key("submatches");
+  writer.begin_array(match.size());
+  for (size_t i = 0; i < match.size(); ++i)
   {
-    os << match._submatches.at(i);
-    if (i < match._submatch_count - 1)
-      os << ",";
-    os << "\n";
+    writer.begin_object(3);
+    writer.key("length");   writer.number(match.length(i));
+    writer.key("position"); writer.position(position_offset + match.position(i));
+    writer.key("text");     writer.string(match.text(i));
+    writer.end_object();
   }
-  os << "]\n";
-  os << "}";
-  return os;
-};
+  writer.end_array();
+  writer.end_object();
+}
+
+// Output the Result base class info into the open object, just properties.
+void write_document(Document_writer& writer, Results const& results)
+{
+  writer.key("algorithm");
+  writer.string(algorithm_name(results.algorithm()));
+}
+
+void write_document(Document_writer& writer, Match_results const& match_results)
+{
+  writer.begin_object(2);
+  write_document(writer, static_cast<Results const&>(match_results));
+  writer.key("match"); write_document(writer, match_results.match());
+  writer.end_object();
+}
 
-// Output the Result base class info, without any objects, just properties.
-std::ostream& operator<<(std::ostream& os, Results const& results)
+void write_document(Document_writer& writer, Search_results const& search_results)
 {
-  os << "\"algorithm\": \"" << results._algorithm << "\"";
-  return os;
+  writer.begin_object(3);
+  write_document(writer, static_cast<Results const&>(search_results));
+  writer.key("match_count"); writer.number(search_results.match_count());
+  writer.key("matches");
+  write_document_array(writer, search_results.matches(), [&](Match const& match) { write_document(writer, match); });
+  writer.end_object();
+}
+
+// Write each row of the Match_table as a Match would be written, reading the columns in place.
+void write_document(Document_writer& writer, Search_table_results const& search_table_results)
+{
+  auto const& table = search_table_results.match_table();
+
+  writer.begin_object(3);
+  write_document(writer, static_cast<Results const&>(search_table_results));
+  writer.key("match_count"); writer.number(table.match_count());
+  writer.key("matches");
+  writer.begin_array(table.match_count());
+  for (size_t row = 0; row < table.match_count(); ++row)
+  {
+    writer.begin_object(5);
+    writer.key("formatted_string");        writer.string(table.formatted_string(row));
+    writer.key("match_successful");        writer.string("true");
+    writer.key("max_possible_submatches"); writer.number(table.max_possible_submatches());
+    writer.key("submatch_count");          writer.number(table.group_count());
+    writer.key("submatches");
+    writer.begin_array(table.group_count());
+    for (size_t group = 0; group < table.group_count(); ++group)
+    {
+      writer.begin_object(3);
+      writer.key("length");   writer.number(table.length(row, group));
+      writer.key("position"); writer.position(table.position(row, group));
+      writer.key("text");     writer.string(table.text(row, group));
+      writer.end_object();
+    }
+    writer.end_array();
+    writer.end_object();
+  }
+  writer.end_array();
+  writer.end_object();
 }
 
-std::ostream& operator<<(std::ostream& os, Match_results const& match_results)
+void write_document(Document_writer& writer, Exists_results const& exists_results)
 {
-  os << "{"                                   << "\n";
-  os << static_cast<Results>(match_results)   << ",\n";
-  os << "\"match\": " << match_results._match << "\n";
-  os << "}";
-  return os;
-};
+  writer.begin_object(2);
+  write_document(writer, static_cast<Results const&>(exists_results));
+  writer.key("exists"); writer.boolean(exists_results.exists());
+  writer.end_object();
+}
 
-std::ostream& operator<<(std::ostream& os, Search_results const& search_results)
+// The group counts are written only when they were asked for.
+void write_document(Document_writer& writer, Count_results const& count_results)
 {
-  os << "{"                                                                  << "\n";
-  os << static_cast<Results>(search_results)                                 << ",\n";
-  os << "\"match_count\": "                  << search_results._match_count  << ",\n";
-  os << "\"matches\": ["                                                     << "\n";
-  for (size_t i = 0; i < search_results._matches.size(); ++i)
+  writer.begin_object(count_results.group_counts().empty() ? 2 : 3);
+  write_document(writer, static_cast<Results const&>(count_results));
+  if (!count_results.group_counts().empty())
   {
-    os << search_results._matches.at(i);
-    if (i < search_results._matches.size() - 1)
-      os << ",";
-    os << "\n";
+    writer.key("group_counts");
+    write_document_array(writer, count_results.group_counts(), [&](size_t group_count) { writer.number(group_count); });
   }
-  os << "]\n";
-  os << "}";
-  return os;
-};
+  writer.key("match_count"); writer.number(count_results.match_count());
+  writer.end_object();
+}
+
+void write_document(Document_writer& writer, Replace_results const& replace_results)
+{
+  writer.begin_object(2);
+  write_document(writer, static_cast<Results const&>(replace_results));
+  writer.key("replaced_text"); writer.string(replace_results.replaced_text());
+  writer.end_object();
+}
 
-std::ostream& operator<<(std::ostream& os, Replace_results const& replace_results)
+void write_document(Document_writer& writer, Line const& line)
 {
-  os << "{"                                                                                    << "\n";
-  os << static_cast<Results>(replace_results)                                                  << ",\n";
-  os << "\"replaced_text\": " << '"' << escape_for_json(replace_results._replaced_text) << '"' << "\n";
-  os << "}";
-  return os;
-};
+  writer.begin_object(4);
+  writer.key("length");      writer.number(line.length());
+  writer.key("line_number"); writer.number(line.line_number());
+  writer.key("matches");
+  write_document_array(writer, line.matches(), [&](Match const& match) { write_document(writer, match); });
+  writer.key("position");    writer.position(line.position());
+  writer.end_object();
+}
+
+void write_document(Document_writer& writer, Line_results const& line_results)
+{
+  writer.begin_object(4);
+  write_document(writer, static_cast<Results const&>(line_results));
+  writer.key("line_count");         writer.number(line_results.line_count());
+  writer.key("lines");
+  write_document_array(writer, line_results.lines(), [&](Line const& line) { write_document(writer, line); });
+  writer.key("matched_line_count"); writer.number(line_results.matched_line_count());
+  writer.end_object();
+}
 
-std::ostream& operator<<(std::ostream& os, Regex_helper const& regex_helper)
+void write_document(Document_writer& writer, std::shared_ptr<Results> const& results)
 {
-  os << "{"                                                                         << "\n";
-  os << "\"text\": "          << '"' << escape_for_json(regex_helper._text)  << '"' << ",\n";
-  os << "\"regex\": "         << '"' << escape_for_json(regex_helper._regex) << '"' << ",\n";
-  os << "\"regex_options\": "        << regex_helper._regex_options                 << ",\n";
-  os << "\"results\": ";
-  std::shared_ptr<Results> results = regex_helper._results;
-  if (results)
+  if (auto line_results = std::dynamic_pointer_cast<Line_results>(results))
+  {
+    write_document(writer, *line_results);
+  }
+  else if (auto count_results = std::dynamic_pointer_cast<Count_results>(results))
+  {
+    write_document(writer, *count_results);
+  }
+  else if (auto exists_results = std::dynamic_pointer_cast<Exists_results>(results))
+  {
+    write_document(writer, *exists_results);
+  }
+  else if (results)
   {
     switch (results->algorithm())
     {
       case Algorithm::match:
       {
-        os << *std::dynamic_pointer_cast<Match_results>(results);
+        write_document(writer, *std::dynamic_pointer_cast<Match_results>(results));
         break;
       }
       case Algorithm::search:
       {
-        os << *std::dynamic_pointer_cast<Search_results>(results);
+        if (auto search_table_results = std::dynamic_pointer_cast<Search_table_results>(results))
+          write_document(writer, *search_table_results);
+        else
+          write_document(writer, *std::dynamic_pointer_cast<Search_results>(results));
         break;
       }
       case Algorithm::replace:
       {
-        os << *std::dynamic_pointer_cast<Replace_results>(results);
+        write_document(writer, *std::dynamic_pointer_cast<Replace_results>(results));
         break;
       }
       default:
+        writer.null();
         break;
     }
   }
+  else
+  {
+    writer.null();
+  }
+}
+
+void write_document(Document_writer& writer, Regex_helper const& regex_helper)
+{
+  writer.begin_object(4);
+  writer.key("regex");         writer.string(regex_helper.regex());
+  writer.key("regex_options"); write_document(writer, regex_helper.regex_options());
+  writer.key("results");       write_document(writer, regex_helper.results());
+  writer.key("text");
+  if (!regex_helper.echo_text())
+    writer.null();
+  else
+    writer.string(regex_helper.text());
+  writer.end_object();
+}
+
+// Output the files in which the regex matched, with their Results, and the files that
+// were skipped, with the reason.
+void write_document(Document_writer& writer, Files_helper const& files_helper)
+{
+  std::vector<File_result const*> matched_files;
+  std::vector<File_result const*> skipped_files;
+  for (auto const& file_result : files_helper.file_results())
+  {
+    if (!file_result.results)
+      skipped_files.push_back(&file_result);
+    else if (results_have_match(*file_result.results))
+      matched_files.push_back(&file_result);
+  }
 
-  os << "\n";
-  os << "}";
-  return os;
+  writer.begin_object(5);
+  writer.key("file_count"); writer.number(files_helper.file_results().size());
+  writer.key("files");
+  write_document_array(writer, matched_files, [&](File_result const* file_result)
+  {
+    writer.begin_object(2);
+    writer.key("path");    writer.string(file_result->path);
+    writer.key("results"); write_document(writer, file_result->results);
+    writer.end_object();
+  });
+  writer.key("regex");         writer.string(files_helper.regex());
+  writer.key("regex_options"); write_document(writer, files_helper.regex_options());
+  writer.key("skipped_files");
+  write_document_array(writer, skipped_files, [&](File_result const* file_result)
+  {
+    writer.begin_object(2);
+    writer.key("path");   writer.string(file_result->path);
+    writer.key("reason"); writer.string(file_result->skipped_reason);
+    writer.end_object();
+  });
+  writer.end_object();
 }
@@ -1,10 +1,16 @@
 #ifndef STREAM_INSERT_OVERLOADS_H
 #define STREAM_INSERT_OVERLOADS_H
 
+#include <files_helper.h>
+#include <document_writer.h>
 #include <regex_helper.h>
 
-// This, operator<< overloads, write out program objects in a JSON format.
-// The format is defined as follows:
+// These, write_document overloads, write out program objects as a document through a
+// Document_writer: as JSON through a Json_writer, which does the indenting and escaping, or
+// as CBOR or MessagePack through a Binary_writer. The members of each object are written in
+// sorted order of their keys, and every "position" through Document_writer::position. The
+// format is defined as follows (a Files_helper holds a Results object like the ones below
+// for each file):
 
 /*
 Regex_helper:
@@ -24,6 +30,9 @@ Regex_helper:
     ]
   }
 
+  // -OR-, written in the same form as Search_results:
+  Search_table_results: {}
+
   // -OR-
   Match_results: {
     Match: {}
@@ -31,20 +40,50 @@ Regex_helper:
 
   // -OR-
   Replace_results: {}
+
+  // -OR-, when the matches are only counted:
+  Count_results: {}
+
+  // -OR-, when only the existence of a match is asked for:
+  Exists_results: {}
+
+  // -OR-, when the algorithm runs line by line:
+  Line_results: {
+    [
+      Line: {
+        [Match]
+      }
+    ]
+  }
 }
 */
 
-std::ostream& operator<<(std::ostream& os, Algorithm              algorithm);
-std::ostream& operator<<(std::ostream& os, Grammar                grammar);
-std::ostream& operator<<(std::ostream& os, Match           const& match);
-std::ostream& operator<<(std::ostream& os, Match_options   const& match_options);
-std::ostream& operator<<(std::ostream& os, Match_results   const& match_results);
-std::ostream& operator<<(std::ostream& os, Regex_helper    const& regex_helper);
-std::ostream& operator<<(std::ostream& os, Regex_options   const& regex_options);
-std::ostream& operator<<(std::ostream& os, Replace_results const& replace_results);
-std::ostream& operator<<(std::ostream& os, Results         const& results);
-std::ostream& operator<<(std::ostream& os, Search_results  const& search_results);
-std::ostream& operator<<(std::ostream& os, Submatch        const& submatch);
-std::ostream& operator<<(std::ostream& os, Syntax_options  const& syntax_options);
+std::ostream& operator<<(std::ostream& os, Algorithm algorithm);
+std::ostream& operator<<(std::ostream& os, Grammar   grammar);
+
+void write_document(Document_writer& writer, Count_results        const& count_results);
+void write_document(Document_writer& writer, Exists_results       const& exists_results);
+void write_document(Document_writer& writer, Files_helper         const& files_helper);
+void write_document(Document_writer& writer, Line                 const& line);
+void write_document(Document_writer& writer, Line_results         const& line_results);
+void write_document(Document_writer& writer, Match                const& match);
+void write_document(Document_writer& writer, Match_options        const& match_options);
+void write_document(Document_writer& writer, Match_results        const& match_results);
+void write_document(Document_writer& writer, Regex_helper         const& regex_helper);
+void write_document(Document_writer& writer, Regex_options        const& regex_options);
+void write_document(Document_writer& writer, Replace_results      const& replace_results);
+void write_document(Document_writer& writer, Result_options       const& result_options);
+void write_document(Document_writer& writer, Results              const& results);
+void write_document(Document_writer& writer, Search_results       const& search_results);
+void write_document(Document_writer& writer, Search_table_results const& search_table_results);
+void write_document(Document_writer& writer, Submatch             const& submatch);
+void write_document(Document_writer& writer, Syntax_options       const& syntax_options);
+
+// Write whichever kind of Results the pointer holds, or null if it is empty.
+void write_document(Document_writer& writer, std::shared_ptr<Results> const& results);
+
+// Write a match in the form of a Match, straight from its Capture_spans, with the given
+// formatted string. The position offset is added to the Submatch positions.
+void write_document(Document_writer& writer, Capture_spans const& match, std::string_view formatted_string, size_t position_offset);
 
 #endif /* STREAM_INSERT_OVERLOADS_H */
@@ -0,0 +1,117 @@
+#include <thread_pool.h>
+
+namespace
+{
+  // The pool and queue index of the calling thread, if it is a worker.
+  thread_local Thread_pool const* current_pool         {nullptr};
+  thread_local size_t             current_worker_index {0};
+}
+
+Thread_pool::Thread_pool(size_t thread_count)
+{
+  if (thread_count == 0)
+    thread_count = 1;
+
+  _queues.reserve(thread_count);
+  for (size_t i = 0; i < thread_count; ++i)
+    _queues.push_back(std::make_unique<Worker_queue>());
+
+  _workers.reserve(thread_count);
+  for (size_t i = 0; i < thread_count; ++i)
+    _workers.emplace_back([this, i] { _run_worker(i); });
+}
+
+Thread_pool::~Thread_pool()
+{
+  {
+    std::lock_guard<std::mutex> lock(_sleep_mutex);
+    _stopping = true;
+  }
+  _wake.notify_all();
+
+  for (auto& worker : _workers)
+    worker.join();
+}
+
+size_t Thread_pool::default_thread_count()
+{
+  size_t const hardware_threads = std::thread::hardware_concurrency();
+  return hardware_threads > 0 ? hardware_threads : 1;
+}
+
+bool Thread_pool::on_worker_thread()
+{
+  return current_pool != nullptr;
+}
+
+void Thread_pool::_enqueue(std::function<void()>&& task)
+{
+  size_t const queue_index = current_pool == this
+                           ? current_worker_index
+                           : _next_queue.fetch_add(1, std::memory_order_relaxed) % _queues.size();
+
+  {
+    // Count the task before it can be taken, and take the sleep mutex to do so, so that
+    // a worker cannot miss the wake-up between checking _pending and going to sleep.
+    std::lock_guard<std::mutex> lock(_sleep_mutex);
+    _pending.fetch_add(1);
+  }
+
+  {
+    Worker_queue& queue = *_queues[queue_index];
+    std::lock_guard<std::mutex> lock(queue.mutex);
+    queue.tasks.push_back(std::move(task));
+  }
+  _wake.notify_one();
+}
+
+// Take a task from the front of the worker's own queue, or else from the back of the
+// first other queue that has one.
+bool Thread_pool::_take_task(size_t worker_index, std::function<void()>& task)
+{
+  for (size_t offset = 0; offset < _queues.size(); ++offset)
+  {
+    bool const   own_queue = offset == 0;
+    Worker_queue& queue    = *_queues[(worker_index + offset) % _queues.size()];
+
+    std::lock_guard<std::mutex> lock(queue.mutex);
+    if (queue.tasks.empty())
+      continue;
+
+    if (own_queue)
+    {
+      task = std::move(queue.tasks.front());
+      queue.tasks.pop_front();
+    }
+    else
+    {
+      task = std::move(queue.tasks.back());
+      queue.tasks.pop_back();
+    }
+    _pending.fetch_sub(1);
+    return true;
+  }
+  return false;
+}
+
+// Run tasks until the pool is stopping and no tasks are left anywhere.
+void Thread_pool::_run_worker(size_t worker_index)
+{
+  current_pool         = this;
+  current_worker_index = worker_index;
+
+  while (true)
+  {
+    std::function<void()> task;
+    if (_take_task(worker_index, task))
+    {
+      task();
+      continue;
+    }
+
+    std::unique_lock<std::mutex> lock(_sleep_mutex);
+    _wake.wait(lock, [this] { return _stopping || _pending.load() > 0; });
+    if (_stopping && _pending.load() == 0)
+      return;
+  }
+}
@@ -0,0 +1,72 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+// A Thread_pool runs submitted tasks on a fixed set of worker threads. submit() returns a
+// std::future for the task's result, so a caller that needs results in a particular order
+// simply waits on the futures in that order. Destroying the pool finishes the queued tasks
+// and joins the workers.
+//
+// Each worker has its own queue. Tasks submitted from outside the pool are dealt out to the
+// queues in turn, and tasks submitted by a worker go on that worker's own queue. A worker
+// takes tasks from the front of its own queue, and once that is empty it steals from the
+// back of another worker's queue, so that a few long tasks do not leave the other workers
+// idle while short tasks wait behind them.
+class Thread_pool
+{
+  struct Worker_queue
+  {
+    std::mutex                        mutex {};
+    std::deque<std::function<void()>> tasks {};
+  };
+
+  std::vector<std::unique_ptr<Worker_queue>> _queues     {};
+  std::vector<std::thread>                   _workers    {};
+  std::atomic<size_t>                        _pending    {0};
+  std::atomic<size_t>                        _next_queue {0};
+  std::mutex                                 _sleep_mutex{};
+  std::condition_variable                    _wake       {};
+  bool                                       _stopping   {false};
+
+public:
+  explicit Thread_pool(size_t thread_count = default_thread_count());
+  Thread_pool(Thread_pool const&) = delete;
+  Thread_pool& operator=(Thread_pool const&) = delete;
+  ~Thread_pool();
+
+  size_t thread_count() const { return _workers.size(); }
+
+  template <typename Function>
+  std::future<std::invoke_result_t<std::decay_t<Function>>> submit(Function&& function)
+  {
+    using Result = std::invoke_result_t<std::decay_t<Function>>;
+    auto task   = std::make_shared<std::packaged_task<Result()>>(std::forward<Function>(function));
+    auto result = task->get_future();
+    _enqueue([task] { (*task)(); });
+    return result;
+  }
+
+  // The number of hardware threads, or 1 if that cannot be determined.
+  static size_t default_thread_count();
+
+  // Whether the calling thread is a worker of some Thread_pool. Work that would wait on
+  // tasks of its own should run them inline instead when this is true.
+  static bool on_worker_thread();
+
+private:
+  void _enqueue(std::function<void()>&& task);
+  bool _take_task(size_t worker_index, std::function<void()>& task);
+  void _run_worker(size_t worker_index);
+};
+
+#endif /* THREAD_POOL_H */